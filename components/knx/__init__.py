@@ -1,38 +1,308 @@
 import esphome.codegen as cg
 import esphome.config_validation as cv
+from esphome import automation
 from esphome.components import uart
-from esphome.const import CONF_ID, CONF_UART_ID, CONF_USE_ADDRESS, CONF_LAMBDA
+from esphome.core import CORE
+from esphome.const import (
+    CONF_HOST,
+    CONF_ID,
+    CONF_LAMBDA,
+    CONF_PORT,
+    CONF_TRIGGER_ID,
+    CONF_UART_ID,
+    CONF_USE_ADDRESS,
+)
 
 
 CODEOWNERS = ["@fxmike@gmail.com"]
-DEPENDENCIES = ["uart"]
+
+
+def AUTO_LOAD():
+    """Sockets only for KNXnet/IP, a TPUART line does without them."""
+    conf = (CORE.raw_config or {}).get("knx")
+    if isinstance(conf, dict) and (CONF_TUNNEL in conf or CONF_ROUTING in conf):
+        return ["socket"]
+    return []
+
 
 knx_ns = cg.esphome_ns.namespace("knx")
-knx_component = knx_ns.class_("KnxComponent", cg.Component, uart.UARTDevice)
+knx_component = knx_ns.class_("KnxComponent", cg.Component)
+KnxTpuartTransport = knx_ns.class_("KnxTpuartTransport", uart.UARTDevice)
+KnxIpTunnelTransport = knx_ns.class_("KnxIpTunnelTransport")
+KnxIpRouter = knx_ns.class_("KnxIpRouter")
+KnxGroupAddress = cg.global_ns.class_("KnxGroupAddress")
+KnxTelegram = cg.global_ns.class_("KnxTelegram")
+KnxCommandType = cg.global_ns.enum("KnxCommandType")
+KnxPriorityType = cg.global_ns.enum("KnxPriorityType")
+KnxTransceiverType = knx_ns.enum("KnxTransceiverType")
+KnxGroupTrigger = knx_ns.class_(
+    "KnxGroupTrigger", automation.Trigger.template(KnxTelegram.operator("ptr"))
+)
+KnxDumpCaptureAction = knx_ns.class_("KnxDumpCaptureAction", automation.Action)
 
+CONF_KNX_ID = "knx_id"
+CONF_TRANSPORT_ID = "transport_id"
+CONF_TUNNEL = "tunnel"
+CONF_ROUTING = "routing"
+CONF_MULTICAST_ADDRESS = "multicast_address"
+CONF_TRANSCEIVER = "transceiver"
+CONF_UART_CRC = "uart_crc"
+CONF_RX_TASK = "rx_task"
+CONF_CORE = "core"
 CONF_LISTENING_ADDRESSES = "listen_group_address"
 CONF_SERIAL_TIMEOUT = "serial_timeout"
+CONF_RECEIVE_BUDGET = "receive_budget"
+CONF_GROUP_ADDRESS = "group_address"
+CONF_ON_GROUP_WRITE = "on_group_write"
+CONF_ON_GROUP_READ = "on_group_read"
+CONF_ON_GROUP_RESPONSE = "on_group_response"
+CONF_GROUP_OBJECTS = "group_objects"
+CONF_DPT = "dpt"
+CONF_MIN_INTERVAL = "min_interval"
+CONF_SEND_ON_DELTA = "send_on_delta"
+CONF_PRIORITY = "priority"
+CONF_BUS_MONITOR = "bus_monitor"
+CONF_INTERVAL = "interval"
+CONF_TOP = "top"
+CONF_CAPTURE = "capture"
+CONF_SIZE = "size"
+CONF_TRACE = "trace"
+
+PRIORITIES = {
+    "system": KnxPriorityType.KNX_PRIORITY_SYSTEM,
+    "alarm": KnxPriorityType.KNX_PRIORITY_ALARM,
+    "high": KnxPriorityType.KNX_PRIORITY_HIGH,
+    "normal": KnxPriorityType.KNX_PRIORITY_NORMAL,
+}
+
+TRANSCEIVERS = {
+    "auto": KnxTransceiverType.KNX_TRANSCEIVER_AUTO,
+    "tpuart": KnxTransceiverType.KNX_TRANSCEIVER_TPUART,
+    "tpuart2": KnxTransceiverType.KNX_TRANSCEIVER_TPUART2,
+    "ncn5120": KnxTransceiverType.KNX_TRANSCEIVER_NCN5120,
+}
+
+# Octets after the APCI octet for each main DPT number, see knx_dpt.h
+DPT_LENGTHS = {
+    1: 0, 2: 0, 3: 0, 5: 1, 6: 1, 7: 2, 8: 2, 9: 2, 10: 3, 11: 3,
+    12: 4, 13: 4, 14: 4, 16: 14, 17: 1, 18: 1, 20: 1, 232: 3,
+}
+
+GROUP_TRIGGERS = {
+    CONF_ON_GROUP_WRITE: KnxCommandType.KNX_COMMAND_WRITE,
+    CONF_ON_GROUP_READ: KnxCommandType.KNX_COMMAND_READ,
+    CONF_ON_GROUP_RESPONSE: KnxCommandType.KNX_COMMAND_ANSWER,
+}
+
+
+
+def _parse_address(value, separator, limits, name):
+    value = cv.string_strict(value)
+    parts = value.split(separator)
+    if len(parts) != len(limits):
+        raise cv.Invalid(
+            f"{name} '{value}' must have the form "
+            + separator.join(["x"] * len(limits))
+        )
+    try:
+        parts = [int(part) for part in parts]
+    except ValueError as err:
+        raise cv.Invalid(f"{name} '{value}' must only contain numbers") from err
+    for part, limit in zip(parts, limits):
+        if not 0 <= part <= limit:
+            raise cv.Invalid(
+                f"{name} '{value}' is out of range, limits are "
+                + separator.join(str(limit) for limit in limits)
+            )
+    return parts
 
-CONFIG_SCHEMA = (
+
+def validate_group_address(value):
+    """Three level group address main/middle/sub."""
+    parts = _parse_address(value, "/", (31, 7, 255), "Group address")
+    return "/".join(str(part) for part in parts)
+
+
+def validate_individual_address(value):
+    """Individual address area.line.member."""
+    parts = _parse_address(value, ".", (15, 15, 255), "Individual address")
+    return ".".join(str(part) for part in parts)
+
+
+def validate_dpt(value):
+    """Datapoint type as main number or main.sub, e.g. 9 or 9.001."""
+    value = cv.string_strict(str(value))
+    try:
+        main = int(value.split(".")[0])
+    except ValueError as err:
+        raise cv.Invalid(f"DPT '{value}' must have the form x or x.yyy") from err
+    if main not in DPT_LENGTHS:
+        raise cv.Invalid(
+            f"DPT {main} is not supported, supported are "
+            + ", ".join(str(dpt) for dpt in DPT_LENGTHS)
+        )
+    return main
+
+
+def validate_tpuart_options(config):
+    """Routing and the transceiver options need the TPUART line, a tunnel has no line of its own."""
+    if CONF_TUNNEL not in config:
+        return config
+    for key in (CONF_ROUTING, CONF_TRANSCEIVER, CONF_UART_CRC, CONF_RX_TASK):
+        if key in config:
+            raise cv.Invalid(
+                f"'{key}' requires '{CONF_UART_ID}' and cannot be used with '{CONF_TUNNEL}'"
+            )
+    return config
+
+
+def group_address(value):
+    """Expression for a validated group address, packed by the KnxGroupAddress constructor."""
+    return KnxGroupAddress(*(int(part) for part in value.split("/")))
+
+
+CONFIG_SCHEMA = cv.All(
     cv.Schema(
         {
             cv.GenerateID(): cv.declare_id(knx_component),
-            cv.Required(CONF_USE_ADDRESS): cv.string,
-            cv.Required(CONF_LAMBDA): cv.returning_lambda,
+            cv.GenerateID(CONF_TRANSPORT_ID): cv.declare_id(KnxTpuartTransport),
+            cv.Optional(CONF_UART_ID): cv.All(
+                cv.requires_component("uart"), cv.use_id(uart.UARTComponent)
+            ),
+            cv.Optional(CONF_TRANSCEIVER): cv.enum(TRANSCEIVERS, lower=True),
+            cv.Optional(CONF_UART_CRC): cv.boolean,
+            cv.Optional(CONF_RX_TASK): cv.All(
+                cv.only_on_esp32,
+                cv.Schema(
+                    {
+                        cv.Optional(CONF_CORE, default=1): cv.int_range(min=0, max=1),
+                        cv.Optional(CONF_PRIORITY, default=5): cv.int_range(
+                            min=1, max=24
+                        ),
+                    }
+                ),
+            ),
+            cv.Optional(CONF_TUNNEL): cv.Schema(
+                {
+                    cv.GenerateID(): cv.declare_id(KnxIpTunnelTransport),
+                    cv.Required(CONF_HOST): cv.ipv4,
+                    cv.Optional(CONF_PORT, default=3671): cv.port,
+                }
+            ),
+            cv.Optional(CONF_ROUTING): cv.Schema(
+                {
+                    cv.GenerateID(): cv.declare_id(KnxIpRouter),
+                    cv.Optional(CONF_MULTICAST_ADDRESS, default="224.0.23.12"): cv.ipv4,
+                    cv.Optional(CONF_PORT, default=3671): cv.port,
+                }
+            ),
+            cv.Required(CONF_USE_ADDRESS): validate_individual_address,
+            cv.Optional(CONF_LAMBDA): cv.returning_lambda,
             cv.Optional(CONF_LISTENING_ADDRESSES, default=[]): cv.ensure_list(
-                cv.string_strict
+                validate_group_address
             ),
             cv.Optional(CONF_SERIAL_TIMEOUT, default=1000): cv.uint32_t,
+            cv.Optional(
+                CONF_RECEIVE_BUDGET, default="2ms"
+            ): cv.positive_time_period_microseconds,
+            cv.Optional(CONF_TRACE, default=False): cv.boolean,
+            cv.Optional(CONF_GROUP_OBJECTS, default=[]): cv.ensure_list(
+                cv.Schema(
+                    {
+                        cv.Required(CONF_GROUP_ADDRESS): validate_group_address,
+                        cv.Required(CONF_DPT): validate_dpt,
+                        cv.Optional(CONF_MIN_INTERVAL): cv.positive_time_period_milliseconds,
+                        cv.Optional(CONF_SEND_ON_DELTA): cv.positive_float,
+                        cv.Optional(CONF_PRIORITY, default="normal"): cv.enum(
+                            PRIORITIES, lower=True
+                        ),
+                    }
+                )
+            ),
+            cv.Optional(CONF_BUS_MONITOR): cv.Schema(
+                {
+                    cv.Optional(
+                        CONF_INTERVAL, default="60s"
+                    ): cv.positive_time_period_milliseconds,
+                    cv.Optional(CONF_TOP, default=5): cv.int_range(min=1, max=16),
+                }
+            ),
+            cv.Optional(CONF_CAPTURE): cv.Schema(
+                {
+                    cv.Optional(CONF_SIZE, default=64): cv.int_range(min=1, max=1024),
+                }
+            ),
+            **{
+                cv.Optional(trigger): automation.validate_automation(
+                    {
+                        cv.GenerateID(CONF_TRIGGER_ID): cv.declare_id(KnxGroupTrigger),
+                        cv.Required(CONF_GROUP_ADDRESS): validate_group_address,
+                    }
+                )
+                for trigger in GROUP_TRIGGERS
+            },
         }
     )
-    .extend(cv.COMPONENT_SCHEMA)
-    .extend(uart.UART_DEVICE_SCHEMA)
+    .extend(cv.COMPONENT_SCHEMA),
+    cv.has_exactly_one_key(CONF_UART_ID, CONF_TUNNEL),
+    validate_tpuart_options,
 )
 
+TPUART_UART_SCHEMA = uart.final_validate_device_schema(
+    "knx",
+    baud_rate=19200,
+    require_tx=True,
+    require_rx=True,
+    data_bits=8,
+    parity="EVEN",
+    stop_bits=1,
+)
+
+
+def FINAL_VALIDATE_SCHEMA(config):
+    """The TPUART talks 19200 baud 8E1, a tunnel has no UART to check."""
+    if CONF_UART_ID in config:
+        TPUART_UART_SCHEMA(config)
+    return config
+
 
 async def to_code(config):
-    uart_component = await cg.get_variable(config[CONF_UART_ID])
-    var = cg.new_Pvariable(config[CONF_ID], uart_component)
+    var = cg.new_Pvariable(config[CONF_ID])
+
+    if CONF_TUNNEL in config:
+        conf = config[CONF_TUNNEL]
+        cg.add_define("USE_KNX_TUNNEL")
+        transport = cg.new_Pvariable(conf[CONF_ID])
+        cg.add(transport.set_gateway(str(conf[CONF_HOST]), conf[CONF_PORT]))
+    else:
+        cg.add_define("USE_KNX_TPUART")
+        transport = cg.new_Pvariable(config[CONF_TRANSPORT_ID])
+        await uart.register_uart_device(transport, config)
+        if CONF_TRANSCEIVER in config:
+            cg.add(transport.set_transceiver(config[CONF_TRANSCEIVER]))
+        if config.get(CONF_UART_CRC, False):
+            cg.add(transport.set_uart_crc(True))
+        if CONF_RX_TASK in config:
+            conf = config[CONF_RX_TASK]
+            cg.add_define("USE_KNX_RX_TASK")
+            cg.add(transport.set_rx_task(conf[CONF_CORE], conf[CONF_PRIORITY]))
+            if CORE.using_esp_idf:
+                from esphome.components.esp32 import add_idf_sdkconfig_option
+
+                # The idle task sleeps one tick, Arduino already runs FreeRTOS at 1000 Hz
+                add_idf_sdkconfig_option("CONFIG_FREERTOS_HZ", 1000)
+    cg.add(var.set_transport(transport))
+
+    if CONF_ROUTING in config:
+        conf = config[CONF_ROUTING]
+        cg.add_define("USE_KNX_ROUTING")
+        router = cg.new_Pvariable(conf[CONF_ID])
+        cg.add(
+            router.set_multicast_address(
+                str(conf[CONF_MULTICAST_ADDRESS]), conf[CONF_PORT]
+            )
+        )
+        cg.add(var.set_router(router))
 
     if CONF_LAMBDA in config:
         lambda_ = await cg.process_lambda(
@@ -40,11 +310,69 @@ async def to_code(config):
         )
         cg.add(var.set_lambda_writer(lambda_))
 
-    cg.add(var.set_use_address(config[CONF_USE_ADDRESS]))
+    cg.add(
+        var.set_individual_address(
+            *(int(part) for part in config[CONF_USE_ADDRESS].split("."))
+        )
+    )
     cg.add(var.set_serial_timeout(config[CONF_SERIAL_TIMEOUT]))
+    cg.add(var.set_receive_budget(config[CONF_RECEIVE_BUDGET].total_microseconds))
+    if config[CONF_TRACE]:
+        cg.add_define("USE_KNX_TRACE")
+
+    for address in config[CONF_LISTENING_ADDRESSES]:
+        cg.add(var.add_listen_group_address(group_address(address)))
+
+    for conf in config[CONF_GROUP_OBJECTS]:
+        cg.add(
+            var.add_group_object(
+                group_address(conf[CONF_GROUP_ADDRESS]),
+                conf[CONF_DPT],
+                DPT_LENGTHS[conf[CONF_DPT]],
+                conf[CONF_PRIORITY],
+            )
+        )
+        if CONF_MIN_INTERVAL in conf or CONF_SEND_ON_DELTA in conf:
+            min_interval = conf.get(CONF_MIN_INTERVAL)
+            cg.add(
+                var.set_send_policy(
+                    group_address(conf[CONF_GROUP_ADDRESS]),
+                    min_interval.total_milliseconds if min_interval else 0,
+                    conf.get(CONF_SEND_ON_DELTA, 0.0),
+                )
+            )
 
-    for addreses in config[CONF_LISTENING_ADDRESSES]:
-        cg.add(var.add_listen_group_address(addreses))
+    if CONF_BUS_MONITOR in config:
+        conf = config[CONF_BUS_MONITOR]
+        cg.add(
+            var.enable_bus_monitor(
+                conf[CONF_INTERVAL].total_milliseconds, conf[CONF_TOP]
+            )
+        )
+
+    if CONF_CAPTURE in config:
+        cg.add(var.enable_capture(config[CONF_CAPTURE][CONF_SIZE]))
+
+    for trigger, command in GROUP_TRIGGERS.items():
+        for conf in config.get(trigger, []):
+            trig = cg.new_Pvariable(
+                conf[CONF_TRIGGER_ID],
+                var,
+                group_address(conf[CONF_GROUP_ADDRESS]),
+                command,
+            )
+            await automation.build_automation(
+                trig, [(KnxTelegram.operator("ptr"), "telegram")], conf
+            )
 
     await cg.register_component(var, config)
-    await uart.register_uart_device(var, config)
+
+
+@automation.register_action(
+    "knx.dump_capture",
+    KnxDumpCaptureAction,
+    cv.Schema({cv.GenerateID(): cv.use_id(knx_component)}),
+)
+async def knx_dump_capture_to_code(config, action_id, template_arg, args):
+    parent = await cg.get_variable(config[CONF_ID])
+    return cg.new_Pvariable(action_id, template_arg, parent)
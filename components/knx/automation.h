@@ -0,0 +1,28 @@
+#pragma once
+
+#include "esphome/core/automation.h"
+#include "knx_component.h"
+
+namespace esphome {
+namespace knx {
+
+// Fires for telegrams with the given command sent to one group address
+class KnxGroupTrigger : public Trigger<KnxTelegram *> {
+  public:
+    KnxGroupTrigger(KnxComponent *parent, KnxGroupAddress address, KnxCommandType command) {
+      parent->add_group_handler(address, command, this);
+    }
+};
+
+// Logs the bus capture, see KnxComponent::dump_capture()
+template<typename... Ts> class KnxDumpCaptureAction : public Action<Ts...> {
+  public:
+    KnxDumpCaptureAction(KnxComponent *parent) : parent_(parent) {}
+    void play(Ts... x) override { this->parent_->dump_capture(); }
+
+  protected:
+    KnxComponent *parent_;
+};
+
+}  // namespace knx
+}  // namespace esphome
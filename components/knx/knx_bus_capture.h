@@ -0,0 +1,139 @@
+// Author: Dulgheru Mihaita (Since 2022)
+
+#pragma once
+
+#include <atomic>
+#include <cinttypes>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include "knx_telegram.h"
+#include "knx_cemi.h"
+
+namespace esphome {
+namespace knx {
+
+// What happened to a captured frame
+enum KnxCaptureResult : uint8_t {
+  KNX_CAPTURE_RX_ACK,             // Received, acknowledged by us
+  KNX_CAPTURE_RX_NOT_ADDRESSED,   // Received, not for us
+  KNX_CAPTURE_RX_CHECKSUM_ERROR,  // Received, dropped without ACK
+  KNX_CAPTURE_TX_CONFIRMED,       // Sent, positive L_DATA.con
+  KNX_CAPTURE_TX_NACKED,          // Sent, negative L_DATA.con
+  KNX_CAPTURE_TX_TIMED_OUT        // Sent, no L_DATA.con
+};
+
+// One line of the ETS trace: a Telegram element with the cEMI frame of a record in hex, or a comment
+inline constexpr int KNX_CAPTURE_LINE_SIZE = 160;
+
+// One captured TP1 frame. Extended frames longer than a standard one are cut, length keeps the real size.
+struct KnxCaptureRecord {
+  uint32_t timestamp_us;
+  uint16_t length;
+  KnxCaptureResult result;
+  uint8_t frame[MAX_KNX_TELEGRAM_SIZE];
+
+  bool is_transmit() const { return this->result >= KNX_CAPTURE_TX_CONFIRMED; }
+  bool is_truncated() const { return this->length > MAX_KNX_TELEGRAM_SIZE; }
+
+  // Builds the cEMI L_Data.ind (received) or L_Data.con (sent) frame, returns its length or 0 if the
+  // record is truncated. The confirm bit flags a failed send.
+  int to_cemi(uint8_t *out) const {
+    if (this->is_truncated()) {
+      return 0;
+    }
+    int length = knx_tp_to_cemi(this->is_transmit() ? KNX_CEMI_L_DATA_CON : KNX_CEMI_L_DATA_IND, this->frame, this->length, out);
+    if (length > 0 && (this->result == KNX_CAPTURE_TX_NACKED || this->result == KNX_CAPTURE_TX_TIMED_OUT)) {
+      out[2] |= 0b00000001;
+    }
+    return length;
+  }
+
+  // The record as a line of an ETS bus monitor trace. The timestamp counts from boot, a truncated frame
+  // becomes an XML comment, so tools that import the trace skip it.
+  void to_ets_line(char *out, size_t size) const {
+    uint32_t seconds = this->timestamp_us / 1000000;
+    char timestamp[40];
+    snprintf(timestamp, sizeof(timestamp), "1970-01-01T%02" PRIu32 ":%02" PRIu32 ":%02" PRIu32 ".%06" PRIu32 "Z",
+             seconds / 3600, seconds / 60 % 60, seconds % 60, this->timestamp_us % 1000000);
+    uint8_t cemi[MAX_KNX_TELEGRAM_SIZE + 2];
+    int length = this->to_cemi(cemi);
+    if (length == 0) {
+      snprintf(out, size, "<!-- %s %s frame of %u bytes, truncated in the capture -->", timestamp,
+               this->is_transmit() ? "sent" : "received", this->length);
+      return;
+    }
+    int used = snprintf(out, size, "<Telegram Timestamp=\"%s\" Service=\"%s\" FrameFormat=\"CommonEmi\" RawData=\"",
+                        timestamp, this->is_transmit() ? "L_Data.con" : "L_Data.ind");
+    for (int i = 0; i < length && used + 2 < (int) size; i++) {
+      used += snprintf(out + used, size - used, "%02X", cemi[i]);
+    }
+    snprintf(out + used, size - used, "\" />");
+  }
+};
+
+// Fixed size ring of the last frames seen on the receive and transmit paths. There is a single writer;
+// readers never block it: a record overwritten while it was being copied is detected by re-reading the head.
+class KnxBusCapture {
+  public:
+    explicit KnxBusCapture(uint16_t size) : records_(new KnxCaptureRecord[size]), size_(size) {}
+
+    void record(const uint8_t *frame, int length, uint32_t timestamp_us, KnxCaptureResult result) {
+      uint32_t head = this->head_.load(std::memory_order_relaxed);
+      KnxCaptureRecord &record = this->records_[head % this->size_];
+      // Invalidates the slot for readers before it is overwritten
+      this->head_.store(head + 1, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_release);
+      record.timestamp_us = timestamp_us;
+      record.length = length;
+      record.result = result;
+      memcpy(record.frame, frame, length > MAX_KNX_TELEGRAM_SIZE ? MAX_KNX_TELEGRAM_SIZE : length);
+      this->written_.store(head + 1, std::memory_order_release);
+      if (length > MAX_KNX_TELEGRAM_SIZE) {
+        this->truncated_.fetch_add(1, std::memory_order_relaxed);
+      }
+    }
+
+    // Calls f(record) for the captured frames, oldest first. Frames recorded meanwhile are not reported.
+    template<typename F> void for_each(F f) const {
+      uint32_t end = this->written_.load(std::memory_order_acquire);
+      uint32_t start = end > this->size_ ? end - this->size_ : 0;
+      for (uint32_t i = start; i < end; i++) {
+        KnxCaptureRecord copy = this->records_[i % this->size_];
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (this->head_.load(std::memory_order_relaxed) - i > this->size_) {
+          continue;  // Overwritten while copying
+        }
+        f(copy);
+      }
+    }
+
+    // The captured frames as an ETS bus monitor trace (CommunicationLog XML), calls line(const char *) for
+    // each line. ETS and other KNX tools import it as a group monitor recording.
+    template<typename F> void write_ets_trace(F line) const {
+      char text[KNX_CAPTURE_LINE_SIZE];
+      line("<?xml version=\"1.0\" encoding=\"utf-8\"?>");
+      line("<CommunicationLog xmlns=\"http://knx.org/xml/telegrams/01\">");
+      this->for_each([&line, &text](const KnxCaptureRecord &record) {
+        record.to_ets_line(text, sizeof(text));
+        line(text);
+      });
+      line("</CommunicationLog>");
+    }
+
+    uint16_t get_size() const { return this->size_; }
+    uint32_t get_recorded() const { return this->written_.load(std::memory_order_relaxed); }
+    // Extended frames too long for a record, only their length is kept
+    uint32_t get_truncated() const { return this->truncated_.load(std::memory_order_relaxed); }
+    size_t memory_usage() const { return this->size_ * sizeof(KnxCaptureRecord); }
+
+  protected:
+    KnxCaptureRecord *records_;
+    uint16_t size_;
+    std::atomic<uint32_t> head_{0};     // Slots up to here may be being written
+    std::atomic<uint32_t> written_{0};  // Slots up to here are complete
+    std::atomic<uint32_t> truncated_{0};
+};
+
+}  // namespace knx
+}  // namespace esphome
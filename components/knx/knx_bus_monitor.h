@@ -0,0 +1,119 @@
+// Author: Dulgheru Mihaita (Since 2022)
+
+#pragma once
+
+#include <cstdint>
+#include "knx_telegram.h"
+
+namespace esphome {
+namespace knx {
+
+// Top-N counter with fixed memory (space-saving sketch). Keys that are not tracked replace the
+// smallest entry and inherit its count as error bound, so every key seen more than
+// total / N times is guaranteed to be in the table.
+template<int N> class KnxHeavyHitters {
+  public:
+    void add(uint16_t key) {
+      int smallest = 0;
+      for (int i = 0; i < this->used_; i++) {
+        if (this->entries_[i].key == key) {
+          this->entries_[i].count++;
+          return;
+        }
+        if (this->entries_[i].count < this->entries_[smallest].count) {
+          smallest = i;
+        }
+      }
+      if (this->used_ < N) {
+        this->entries_[this->used_++] = {key, 1, 0};
+        return;
+      }
+      Entry &entry = this->entries_[smallest];
+      entry = {key, entry.count + 1, entry.count};
+    }
+
+    // Calls f(key, count, error) for the n largest counts, largest first
+    template<typename F> void for_each_top(int n, F f) const {
+      bool reported[N] = {};
+      for (int k = 0; k < n && k < this->used_; k++) {
+        int best = -1;
+        for (int i = 0; i < this->used_; i++) {
+          if (!reported[i] && (best < 0 || this->entries_[i].count > this->entries_[best].count)) {
+            best = i;
+          }
+        }
+        reported[best] = true;
+        f(this->entries_[best].key, this->entries_[best].count, this->entries_[best].error);
+      }
+    }
+
+    void clear() { this->used_ = 0; }
+
+  protected:
+    struct Entry {
+      uint16_t key;
+      uint32_t count;
+      uint32_t error;  // count may overestimate the key by this much
+    };
+    Entry entries_[N];
+    int used_{0};
+};
+
+// Entries tracked per sketch, the reported top list is at most this long
+static const int KNX_BUS_MONITOR_SLOTS = 16;
+// TP1 character: start, 8 data, parity, stop bit and 2 bit times of idle
+inline constexpr uint32_t KNX_TP1_CHAR_BITS = 13;
+// Per frame overhead: 50 bit times of bus idle before the frame, 15 before the ACK character, the ACK itself
+inline constexpr uint32_t KNX_TP1_FRAME_OVERHEAD_BITS = 50 + 15 + 11;
+
+// Bus load and traffic breakdown over every frame seen on the line, addressed to us or not
+class KnxBusMonitor {
+  public:
+    void record(KnxTelegram *telegram, bool valid) {
+      this->frames_++;
+      this->bits_ += telegram->get_total_length() * KNX_TP1_CHAR_BITS + KNX_TP1_FRAME_OVERHEAD_BITS;
+      if (!valid) {
+        return;
+      }
+      this->sources_.add((telegram->get_source_area() << 12) | (telegram->get_source_line() << 8) | telegram->get_source_member());
+      if (telegram->is_target_group()) {
+        this->groups_.add(telegram->get_target_group_address().raw());
+      }
+    }
+
+    // Turns the counts since the previous call into rates, the top lists are reset by clear()
+    void update_rates(uint32_t now_ms) {
+      uint32_t elapsed = now_ms - this->window_start_ms_;
+      if (elapsed > 0) {
+        this->frames_per_second_ = this->frames_ * 1000.0f / elapsed;
+        this->bits_per_second_ = this->bits_ * 1000.0f / elapsed;
+      }
+      this->frames_ = 0;
+      this->bits_ = 0;
+      this->window_start_ms_ = now_ms;
+    }
+
+    void clear() {
+      this->sources_.clear();
+      this->groups_.clear();
+    }
+
+    float get_frames_per_second() const { return this->frames_per_second_; }
+    float get_bits_per_second() const { return this->bits_per_second_; }
+    // Share of the 9600 bit/s line in percent
+    float get_bus_load() const { return this->bits_per_second_ * 100.0f / 9600.0f; }
+    const KnxHeavyHitters<KNX_BUS_MONITOR_SLOTS> &get_sources() const { return this->sources_; }
+    const KnxHeavyHitters<KNX_BUS_MONITOR_SLOTS> &get_groups() const { return this->groups_; }
+
+  protected:
+    uint32_t frames_{0};
+    uint32_t bits_{0};
+    uint32_t window_start_ms_{0};
+    float frames_per_second_{0};
+    float bits_per_second_{0};
+    KnxHeavyHitters<KNX_BUS_MONITOR_SLOTS> sources_;
+    KnxHeavyHitters<KNX_BUS_MONITOR_SLOTS> groups_;
+};
+
+}  // namespace knx
+}  // namespace esphome
@@ -0,0 +1,75 @@
+// Author: Dulgheru Mihaita (Since 2022)
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include "knx_telegram.h"
+
+namespace esphome {
+namespace knx {
+
+// cEMI message codes of the L_Data service
+inline constexpr uint8_t KNX_CEMI_L_DATA_REQ = 0x11;
+inline constexpr uint8_t KNX_CEMI_L_DATA_IND = 0x29;
+inline constexpr uint8_t KNX_CEMI_L_DATA_CON = 0x2E;
+// Message code, additional info length, 2 control fields, 2 addresses and the NPDU length
+inline constexpr int KNX_CEMI_HEADER_SIZE = 9;
+inline constexpr int KNX_CEMI_MAX_SIZE = KNX_CEMI_HEADER_SIZE + MAX_KNX_EXTENDED_PAYLOAD_SIZE + 1;
+
+// Builds a cEMI L_Data frame from a TP1 frame, standard or extended. The TP1 control field is the cEMI
+// control field 1. Returns the cEMI length, or 0 if frame holds less than the frame it announces.
+inline int knx_tp_to_cemi(uint8_t message_code, const uint8_t *frame, int length, uint8_t *out) {
+  if (length < KNX_TELEGRAM_HEADER_SIZE + 2) {
+    return 0;
+  }
+  bool extended = !(frame[0] & 0b10000000);
+  int header = extended ? KNX_EXTENDED_TELEGRAM_HEADER_SIZE : KNX_TELEGRAM_HEADER_SIZE;
+  int npdu_length = extended ? frame[6] : (frame[5] & 0b00001111);
+  if (header + npdu_length + 2 > length) {
+    return 0;
+  }
+  out[0] = message_code;
+  out[1] = 0;  // No additional info
+  out[2] = frame[0] & 0b10111100;
+  out[3] = extended ? frame[1] : (frame[5] & 0b11110000);
+  memcpy(&out[4], &frame[header - 5], 4);  // Source and target address
+  out[8] = npdu_length;
+  memcpy(&out[KNX_CEMI_HEADER_SIZE], &frame[header], npdu_length + 1);
+  return KNX_CEMI_HEADER_SIZE + npdu_length + 1;
+}
+
+// Builds the TP1 frame for a cEMI L_Data frame, without the checksum (see KnxTelegram::create_checksum()).
+// Payloads longer than a standard frame allows become an extended frame. Returns the TP1 length including
+// the checksum, or 0 if the cEMI frame is malformed or does not fit capacity.
+inline int knx_cemi_to_tp(const uint8_t *cemi, int length, uint8_t *frame, int capacity) {
+  int info_length = length >= 2 ? cemi[1] : 0;
+  if (length < KNX_CEMI_HEADER_SIZE + info_length) {
+    return 0;
+  }
+  const uint8_t *ldata = &cemi[2 + info_length];  // Control field 1 onwards
+  int npdu_length = ldata[6];
+  if (length < KNX_CEMI_HEADER_SIZE + info_length + npdu_length + 1) {
+    return 0;
+  }
+  bool extended = !(ldata[0] & 0b10000000) || npdu_length > 15;
+  int header = extended ? KNX_EXTENDED_TELEGRAM_HEADER_SIZE : KNX_TELEGRAM_HEADER_SIZE;
+  if (header + npdu_length + 2 > capacity) {
+    return 0;
+  }
+  if (extended) {
+    frame[0] = (ldata[0] & 0b00101100) | 0b00010000;
+    frame[1] = ldata[1];
+    frame[6] = npdu_length;
+  }
+  else {
+    frame[0] = (ldata[0] & 0b00101100) | 0b10010000;
+    frame[5] = (ldata[1] & 0b11110000) | npdu_length;
+  }
+  memcpy(&frame[header - 5], &ldata[2], 4);
+  memcpy(&frame[header], &ldata[7], npdu_length + 1);
+  return header + npdu_length + 2;
+}
+
+}  // namespace knx
+}  // namespace esphome
@@ -2,64 +2,111 @@
 // Last modified: 05.05.2022
 
 #include "knx_component.h"
+#include "knx_ip_router.h"
 #include "esphome/core/util.h"
 #include "esphome/core/log.h"
-#include "esphome/components/uart/uart_component.h"
 
 namespace esphome {
 namespace knx {
 
-  int buffer[MAX_KNX_TELEGRAM_SIZE];
+  // Scheduling level of a priority, 0 is served first
+  static int tx_priority_level(KnxPriorityType priority) {
+    switch (priority) {
+      case KNX_PRIORITY_SYSTEM: return 0;
+      case KNX_PRIORITY_ALARM: return 1;
+      case KNX_PRIORITY_HIGH: return 2;
+      default: return 3;
+    }
+  }
+
   void KnxComponent::loop() {
-    KnxComponentserial_eventType eType = this->serial_event();
-    //Evaluation of the received telegram -> only KNX telegrams are accepted
-    if (eType == KNX_TELEGRAM) {
-      KnxTelegram* telegram = this->get_received_telegram();
-        ESP_LOGD(TAG, "Received event for group %s.", telegram->get_target_group().c_str());
-        if (this->lambda_writer_.has_value())  // insert Labda function if available
-          (*this->lambda_writer_)(*this);
+    uint32_t start = micros();
+    // A burst is drained in one go, until the transport has nothing left or the budget is spent
+    KnxComponentserial_eventType eType;
+    do {
+      eType = this->serial_event();
+      //Evaluation of the received telegram -> only KNX telegrams are accepted
+      // Also reads already answered from the group object cache, on_group_read and the lambda still see them
+      if (eType == KNX_TELEGRAM) {
+        this->dispatch_received_telegram();
+      }
+    } while (eType != UNKNOWN && micros() - start < this->receive_budget_us_);
+    // Stopped by the budget with more waiting, not right after the last frame of a burst
+    if (eType != UNKNOWN && this->transport_->input_pending()) {
+      this->metrics_.rx_budget_exhausted++;
+    }
+#ifdef USE_KNX_ROUTING
+    if (this->router_ != nullptr) {
+      this->router_->loop();
+    }
+#endif
+    this->flush_deferred_writes();
+    this->process_tx_queue();
+    uint32_t elapsed = micros() - start;
+    if (elapsed > this->metrics_.max_loop_time_us) {
+      this->metrics_.max_loop_time_us = elapsed;
     }
   }
 
   void KnxComponent::setup() {
-    this->_source_area = String(this->use_address_.substr(0, this->use_address_.find('.')).c_str()).toInt();
-    this->_source_line = String(this->use_address_.substr(this->use_address_.find('.') + 1, this->use_address_.length()).substr(0, this->use_address_.substr(this->use_address_.find('.') + 1, this->use_address_.length()).find('.')).c_str()).toInt();
-    this->_source_member = String(this->use_address_.substr(this->use_address_.find_last_of('.') + 1, this->use_address_.length()).c_str()).toInt();
-    this->_tg = new KnxTelegram();
-    this->_tg_ptp = new KnxTelegram();
     this->_listen_to_broadcasts = false;
-    
-    this->uart_reset();
+    if (this->bus_monitor_ != nullptr) {
+      this->bus_monitor_->update_rates(millis());
+      this->set_interval("bus_monitor", this->bus_monitor_interval_, [this]() { this->report_bus_monitor(); });
+    }
+
+    this->transport_->setup();
   }
 
   void KnxComponent::dump_config(){ 
-    ESP_LOGCONFIG(TAG, " Knx use_address: %s", this->use_address_.c_str());
-    for(int i = 0 ; i < this->_listen_group_address_count; i++){
+    this->transport_->dump_config();
+#ifdef USE_KNX_ROUTING
+    if (this->router_ != nullptr) {
+      this->router_->dump_config();
+    }
+#endif
+    ESP_LOGCONFIG(TAG, " Knx use_address: %d.%d.%d", this->_source_area, this->_source_line, this->_source_member);
+    this->_listen_group_addresses.for_each([](uint16_t address) {
       ESP_LOGCONFIG(TAG, " Knx is listening for group address: %d/%d/%d ",
-        this->_listen_group_addresses[i][0], this->_listen_group_addresses[i][1], this->_listen_group_addresses[i][2]
+        (address >> 11) & 0b00011111, (address >> 8) & 0b00000111, address & 0xFF
       );
+    });
+    ESP_LOGCONFIG(TAG, " Knx listen filter: %u addresses, %u bytes",
+      (unsigned) this->_listen_group_addresses.size(), (unsigned) this->_listen_group_addresses.memory_usage());
+    for (auto &it : this->group_objects_) {
+      ESP_LOGCONFIG(TAG, " Knx group object: %d/%d/%d DPT %u, min interval %u ms, send on delta %.2f, %u writes suppressed",
+        (it.first >> 11) & 0b00011111, (it.first >> 8) & 0b00000111, it.first & 0xFF, it.second.dpt,
+        it.second.min_interval_ms, it.second.send_on_delta, it.second.suppressed);
+    }
+    if (this->bus_monitor_ != nullptr) {
+      ESP_LOGCONFIG(TAG, " Knx bus monitor: every %u ms, top %d, %u bytes",
+        (unsigned) this->bus_monitor_interval_, this->bus_monitor_top_, (unsigned) sizeof(KnxBusMonitor));
+    }
+    if (this->capture_ != nullptr) {
+      ESP_LOGCONFIG(TAG, " Knx bus capture: %u frames, %u bytes",
+        this->capture_->get_size(), (unsigned) this->capture_->memory_usage());
     }
   }
 
-  void KnxComponent::set_use_address(const std::string &use_address) { this->use_address_ = use_address; }
-
   void KnxComponent::set_serial_timeout(const uint32_t &serial_timeout) {
     this->serial_timeout_ = serial_timeout;
   }
-  /* ============== ADAPTED ======================= */
 
-  void KnxComponent::set_listen_to_broadcasts(bool listen) {
-    this->_listen_to_broadcasts = listen;
+  void KnxComponent::set_transport(KnxTransport *transport) {
+    this->transport_ = transport;
+    transport->set_parent(this, &this->metrics_);
   }
 
-  void KnxComponent::uart_reset() {
-    uint8_t sendByte = 0x01;
-    this->write(sendByte);
+#ifdef USE_KNX_ROUTING
+  void KnxComponent::set_router(KnxIpRouter *router) {
+    this->router_ = router;
+    router->set_parent(this, &this->metrics_);
   }
+#endif
+  /* ============== ADAPTED ======================= */
 
-  void KnxComponent::uart_state_request() {
-    uint8_t sendByte = 0x02;
-    this->write(sendByte);
+  void KnxComponent::set_listen_to_broadcasts(bool listen) {
+    this->_listen_to_broadcasts = listen;
   }
 
   void KnxComponent::set_individual_address(int area, int line, int member) {
@@ -69,283 +116,337 @@ namespace knx {
   }
 
   KnxComponentserial_eventType KnxComponent::serial_event() {
-    while (this->available() > 0) {
-      this->check_errors();
-      int incomingByte = this->peek();
-      print_byte(incomingByte);
-
-      if (this->is_knx_control_byte(incomingByte)) {
-        ESP_LOGD(TAG, "We have KNX CONTROL BYTE");
-        bool interested = this->read_knx_telegram();
-        if (interested) {
-          ESP_LOGD(TAG, "Event KNX_TELEGRAM");
-          return KNX_TELEGRAM;
-        }
-        else {
-          ESP_LOGD(TAG, "Event IRRELEVANT_KNX_TELEGRAM");
-          return IRRELEVANT_KNX_TELEGRAM;
-        }
-      }
-      else if (incomingByte == TPUART_RESET_INDICATION_BYTE) {
-        this->serial_read();
-        ESP_LOGD(TAG, "Event TPUART_RESET_INDICATION");
-        return TPUART_RESET_INDICATION;
-      }
-      else {
-        this->serial_read();
-        ESP_LOGV(TAG, "UNKNOWN");
-        return UNKNOWN;
-      }
-    }
-    return UNKNOWN;
-  }
-
-
-  bool KnxComponent::is_knx_control_byte(int b) {
-    return ( (b | 0b00101100) == 0b10111100 ); // Ignore repeat flag and priority flag
+    return this->transport_->poll();
   }
 
-  void KnxComponent::check_errors() {
-    this->check_uart_settings(19200, 1, esphome::uart::UARTParityOptions::UART_CONFIG_PARITY_EVEN, 8);
+  // Whether to acknowledge a frame, from its first 6 bytes: control fields and both addresses
+  bool KnxComponent::accepts_frame(const uint8_t *header) {
+    bool extended = !(header[0] & 0b10000000);
+    bool group = (extended ? header[1] : header[5]) & 0b10000000;
+    uint16_t target = (header[extended ? 4 : 3] << 8) | header[extended ? 5 : 4];
+    if (group) {
+      // Broadcast (Programming Mode)
+      return this->_listen_group_addresses.contains(target) || (this->_listen_to_broadcasts && target == 0);
+    }
+    return target == this->get_individual_address();
+  }
+
+  KnxComponentserial_eventType KnxComponent::receive_frame(const uint8_t *frame, int length, bool interested, uint32_t timestamp_us) {
+    // Only frames that do not fit standard storage take the extended telegram
+    this->_rx_tg = length > MAX_KNX_TELEGRAM_SIZE ? static_cast<KnxTelegram *>(&this->rx_extended_) : &this->rx_standard_;
+    memcpy(this->_rx_tg->data(), frame, length);
+    this->rx_interested_ = interested;
+    this->rx_timestamp_us_ = timestamp_us;
+    this->metrics_.rx_frames++;
+    KnxComponentserial_eventType event = IRRELEVANT_KNX_TELEGRAM;
+    bool valid = this->_rx_tg->verify_checksum();
+    if (!valid) {
+      // Not acknowledged on the bus, the sender repeats it
+      ESP_LOGW(TAG, "Telegram with invalid checksum, discarding.");
+      this->metrics_.rx_checksum_errors++;
+      this->capture_frame(this->_rx_tg, timestamp_us, KNX_CAPTURE_RX_CHECKSUM_ERROR);
+    }
+    else if (this->read_knx_telegram()) {
+      event = KNX_TELEGRAM;
+    }
+    KNX_TRACE("rx %s %s", valid ? (event == KNX_TELEGRAM ? "accepted" : "ignored") : "bad checksum",
+      format_hex(this->_rx_tg->data(), this->_rx_tg->get_total_length()).c_str());
+    // Only after the ACK has been written, so monitoring never delays it
+    if (this->bus_monitor_ != nullptr) {
+      this->bus_monitor_->record(this->_rx_tg, valid);
+    }
+#ifdef USE_KNX_ROUTING
+    // Accepted and not a repetition, so the filter table of the router is the listen filter
+    if (event == KNX_TELEGRAM && this->router_ != nullptr) {
+      this->router_->route_to_ip(this->_rx_tg);
+    }
+#endif
+    return event;
+  }
+
+#ifdef USE_KNX_ROUTING
+  // An indication from KNXnet/IP for an address in the listen filter, on its way to the line: the group object
+  // cache, the triggers and the lambda see it as if it had been received here
+  void KnxComponent::receive_routed(KnxTelegram *telegram) {
+    int length = telegram->get_total_length();
+    this->_rx_tg = length > MAX_KNX_TELEGRAM_SIZE ? static_cast<KnxTelegram *>(&this->rx_extended_) : &this->rx_standard_;
+    memcpy(this->_rx_tg->data(), telegram->data(), length);
+    this->rx_interested_ = true;
+    this->rx_timestamp_us_ = micros();
+    if (this->read_knx_telegram()) {
+      this->dispatch_received_telegram();
+    }
   }
+#endif
 
-  void KnxComponent::print_byte(int incomingByte) {
-    ESP_LOGV(TAG,"Incoming Byte: ");
-    ESP_LOGV(TAG, "int: %i ", incomingByte);
-    ESP_LOGV(TAG, " - ");
-    ESP_LOGV(TAG, "hex: %x", incomingByte);
+  // Handlers of the target group first, the lambda for telegrams none of them took
+  void KnxComponent::dispatch_received_telegram() {
+    KnxTelegram* telegram = this->get_received_telegram();
+    bool handled = telegram->is_target_group() && this->dispatch_group_telegram(telegram);
+    if (!handled && this->lambda_writer_.has_value())  // insert Labda function if available
+      (*this->lambda_writer_)(*this);
   }
 
+  // Evaluates the complete telegram handed over by the transport
   bool KnxComponent::read_knx_telegram() {
-    // Receive header
-    for (int i = 0; i < 6; i++) {
-      this->_tg->set_buffer_byte(i, this->serial_read());
+    // Acknowledged by the transport while the frame was still on the bus
+    bool interested = this->rx_interested_;
+    if (!interested) {
+      this->metrics_.rx_filtered++;
     }
-    ESP_LOGV(TAG,"Payload Length: %d", this->_tg->get_payload_length());
+    this->capture_frame(this->_rx_tg, this->rx_timestamp_us_, interested ? KNX_CAPTURE_RX_ACK : KNX_CAPTURE_RX_NOT_ADDRESSED);
 
-    int bufpos = 6;
-    for (int i = 0; i < this->_tg->get_payload_length(); i++) {
-      _tg->set_buffer_byte(bufpos, this->serial_read());
-      bufpos++;
+    if (interested && this->_rx_tg->get_communication_type() == KNX_COMM_NCD) {
+      this->send_ncd_pos_confirm(this->_rx_tg->get_sequence_number(), this->_rx_tg->get_source_area(), this->_rx_tg->get_source_line(), this->_rx_tg->get_source_member());
     }
 
-    // Checksum
-    this->_tg->set_buffer_byte(bufpos, this->serial_read());
-
-    // Verify if we are interested in this message - GroupAddress
-    bool interested = this->_tg->is_target_group() && this->is_listening_to_group_address(this->_tg->get_target_main_group(), this->_tg->get_target_middle_group(), this->_tg->get_target_sub_group());
-
-    // Physical address
-    interested = interested || ((!this->_tg->is_target_group()) && this->_tg->get_target_area() == _source_area && this->_tg->get_target_line() == _source_line && this->_tg->get_target_member() == _source_member);
-
-    // Broadcast (Programming Mode)
-    interested = interested || (this->_listen_to_broadcasts && this->_tg->is_target_group() && this->_tg->get_target_main_group() == 0 && this->_tg->get_target_middle_group() == 0 && this->_tg->get_target_sub_group() == 0);
+    // Still acknowledged above, the sender repeats until it sees our ACK
+    if (interested && this->is_duplicate_telegram(this->_rx_tg)) {
+      this->metrics_.rx_duplicates++;
+      return false;
+    }
 
     if (interested) {
-      this->send_ack();
+      this->metrics_.rx_accepted++;
     }
-    else {
-      this->send_not_addressed();
+    if (interested && this->_rx_tg->is_target_group()) {
+      this->update_group_object(this->_rx_tg);
     }
 
-    if (this->_tg->get_communication_type() == KNX_COMM_UCD) {
-      ESP_LOGV(TAG,"UCD Telegram received");
+    // Returns if we are interested in this diagram
+    return interested;
+  }
+
+  void KnxComponent::enable_bus_monitor(uint32_t interval_ms, int top) {
+    if (this->bus_monitor_ == nullptr) {
+      this->bus_monitor_ = new KnxBusMonitor();
     }
-    else if (_tg->get_communication_type() == KNX_COMM_NCD) {
-      ESP_LOGV(TAG,"NCD Telegram %d received", this->_tg->get_sequence_number());
+    this->bus_monitor_interval_ = interval_ms;
+    this->bus_monitor_top_ = top;
+  }
+
+  void KnxComponent::report_bus_monitor() {
+    this->bus_monitor_->update_rates(millis());
+    ESP_LOGI(TAG, "Bus load %.1f %%, %.0f bit/s, %.1f frames/s", this->bus_monitor_->get_bus_load(),
+      this->bus_monitor_->get_bits_per_second(), this->bus_monitor_->get_frames_per_second());
+    this->bus_monitor_->get_sources().for_each_top(this->bus_monitor_top_, [](uint16_t source, uint32_t count, uint32_t error) {
+      ESP_LOGI(TAG, "  source %d.%d.%d: %u frames (+/- %u)", source >> 12, (source >> 8) & 0b00001111, source & 0xFF,
+        (unsigned) count, (unsigned) error);
+    });
+    this->bus_monitor_->get_groups().for_each_top(this->bus_monitor_top_, [](uint16_t group, uint32_t count, uint32_t error) {
+      ESP_LOGI(TAG, "  group %d/%d/%d: %u frames (+/- %u)", (group >> 11) & 0b00011111, (group >> 8) & 0b00000111, group & 0xFF,
+        (unsigned) count, (unsigned) error);
+    });
+    this->bus_monitor_->clear();
+  }
+
+  void KnxComponent::enable_capture(uint16_t size) {
+    if (this->capture_ == nullptr) {
+      this->capture_ = new KnxBusCapture(size);
+    }
+  }
 
-      if (interested) {
-        this->send_ncd_pos_confirm(this->_tg->get_sequence_number(), this->_tg->get_source_area(), this->_tg->get_source_line(), this->_tg->get_source_member());
+  void KnxComponent::dump_capture() {
+    if (this->capture_ == nullptr) {
+      ESP_LOGW(TAG, "Bus capture is not enabled.");
+      return;
+    }
+    ESP_LOGI(TAG, "Bus capture, %u frames recorded, %u truncated, as ETS trace:",
+      (unsigned) this->capture_->get_recorded(), (unsigned) this->capture_->get_truncated());
+    this->capture_->write_ets_trace([](const char *line) { ESP_LOGI(TAG, "%s", line); });
+  }
+
+  // Remembers the telegram and reports whether it repeats one delivered shortly before
+  bool KnxComponent::is_duplicate_telegram(KnxTelegram* telegram) {
+    uint32_t hash = telegram->get_content_hash();
+    uint32_t now = millis();
+    uint32_t window = telegram->is_repeated() ? KNX_RX_REPEAT_WINDOW_MS : KNX_RX_DUPLICATE_WINDOW_MS;
+    for (auto &recent : this->rx_recent_) {
+      if (recent.hash == hash && recent.received_ms != 0 && now - recent.received_ms < window) {
+        return true;
       }
     }
-
-    // Returns if we are interested in this diagram
-    return interested;
+    KnxRxRecent &slot = this->rx_recent_[this->rx_recent_next_];
+    slot.hash = hash;
+    slot.received_ms = now == 0 ? 1 : now;
+    this->rx_recent_next_ = (this->rx_recent_next_ + 1) % KNX_RX_DEDUP_SIZE;
+    return false;
   }
 
   KnxTelegram* KnxComponent::get_received_telegram() {
-    return this->_tg;
+    return this->_rx_tg;
   }
 
-  // Command Write
+  // Legacy datapoint helpers, see group_write<D>() / group_answer<D>() for the generic versions
 
-  bool KnxComponent::group_write_bool(String address, bool value) {
-    int valueAsInt = 0;
-    if (value) {
-      valueAsInt = 0b00000001;
-    }
+  KnxTxHandle KnxComponent::group_write_bool(KnxGroupAddress address, bool value) {
+    return this->group_write<Dpt<1>>(address, value);
+  }
 
-    this->create_knx_message_frame(2, KNX_COMMAND_WRITE, address, valueAsInt);
-    return this->send_message();
+  KnxTxHandle KnxComponent::group_write_4bit_int(KnxGroupAddress address, int value) {
+    return this->group_write<Dpt<3>>(address, {(value & 0b00001000) != 0, (uint8_t) (value & 0b00000111)});
   }
 
-  bool KnxComponent::group_write_4bit_int(String address, int value) {
-    int out_value = 0;
-    if (value) {
-      out_value = value & 0b00001111;
-    }
+  KnxTxHandle KnxComponent::group_write_4Bit_dim(KnxGroupAddress address, bool direction, uint8_t steps) {
+    return this->group_write<Dpt<3>>(address, {direction, steps});
+  }
 
-    this->create_knx_message_frame(2, KNX_COMMAND_WRITE, address, out_value);
-    return this->send_message();
+  KnxTxHandle KnxComponent::group_write_1byte_int(KnxGroupAddress address, int value) {
+    return this->group_write<Dpt<5>>(address, value);
   }
 
-  bool KnxComponent::group_write_4Bit_dim(String address, bool direction, uint8_t steps) {
-    int value = 0;
-    if (direction || steps) {
-      value = (direction << 3) + (steps & 0b00000111);
-    }
+  KnxTxHandle KnxComponent::group_write_2byte_int(KnxGroupAddress address, int value) {
+    return this->group_write<Dpt<7>>(address, value);
+  }
 
-    this->create_knx_message_frame(2, KNX_COMMAND_WRITE, address, value);
-    return this->send_message();
+  KnxTxHandle KnxComponent::group_write_2byte_float(KnxGroupAddress address, float value) {
+    return this->group_write<Dpt<9>>(address, value);
   }
 
-  bool KnxComponent::group_write_1byte_int(String address, int value) {
-    this->create_knx_message_frame(2, KNX_COMMAND_WRITE, address, 0);
-    this->_tg->set_1byte_int_value(value);
-    this->_tg->create_checksum();
-    return this->send_message();
+  KnxTxHandle KnxComponent::group_write_3byte_time(KnxGroupAddress address, int weekday, int hour, int minute, int second) {
+    return this->group_write<Dpt<10>>(address, {(uint8_t) weekday, (uint8_t) hour, (uint8_t) minute, (uint8_t) second});
   }
 
-  bool KnxComponent::group_write_2byte_int(String address, int value) {
-    this->create_knx_message_frame(2, KNX_COMMAND_WRITE, address, 0);
-    this->_tg->set_2byte_int_value(value);
-    this->_tg->create_checksum();
-    return this->send_message();
+  KnxTxHandle KnxComponent::group_write_3byte_date(KnxGroupAddress address, int day, int month, int year) {
+    return this->group_write<Dpt<11>>(address, {(uint8_t) day, (uint8_t) month, (uint16_t) year});
   }
 
-  bool KnxComponent::group_write_2byte_float(String address, float value) {
-    this->create_knx_message_frame(2, KNX_COMMAND_WRITE, address, 0);
-    this->_tg->set_2byte_float_value(value);
-    this->_tg->create_checksum();
-    return this->send_message();
+  KnxTxHandle KnxComponent::group_write_4byte_float(KnxGroupAddress address, float value) {
+    return this->group_write<Dpt<14>>(address, value);
   }
 
-  bool KnxComponent::group_write_3byte_time(String address, int weekday, int hour, int minute, int second) {
-    this->create_knx_message_frame(2, KNX_COMMAND_WRITE, address, 0);
-    this->_tg->set_3byte_time(weekday, hour, minute, second);
-    this->_tg->create_checksum();
-    return this->send_message();
+  KnxTxHandle KnxComponent::group_write_14byte_text(KnxGroupAddress address, KnxText value) {
+    return this->group_write<Dpt<16>>(address, value.c_str());
   }
 
-  bool KnxComponent::group_write_3byte_date(String address, int day, int month, int year) {
-    this->create_knx_message_frame(2, KNX_COMMAND_WRITE, address, 0);
-    this->_tg->set_3byte_date(day, month, year);
-    this->_tg->create_checksum();
-    return this->send_message();
+  KnxTxHandle KnxComponent::group_answer_bool(KnxGroupAddress address, bool value) {
+    return this->group_answer<Dpt<1>>(address, value);
   }
 
-  bool KnxComponent::group_write_4byte_float(String address, float value) {
-    this->create_knx_message_frame(2, KNX_COMMAND_WRITE, address, 0);
-    this->_tg->set_4byte_float_value(value);
-    this->_tg->create_checksum();
-    return this->send_message();
+  KnxTxHandle KnxComponent::group_answer_1byte_int(KnxGroupAddress address, int value) {
+    return this->group_answer<Dpt<5>>(address, value);
   }
 
-  bool KnxComponent::group_write_14byte_text(String address, String value) {
-    this->create_knx_message_frame(2, KNX_COMMAND_WRITE, address, 0);
-    this->_tg->set_14byte_value(value);
-    this->_tg->create_checksum();
-    return this->send_message();
+  KnxTxHandle KnxComponent::group_answer_2byte_int(KnxGroupAddress address, int value) {
+    return this->group_answer<Dpt<7>>(address, value);
   }
 
-  // Command Answer
+  KnxTxHandle KnxComponent::group_answer_2byte_float(KnxGroupAddress address, float value) {
+    return this->group_answer<Dpt<9>>(address, value);
+  }
 
-  bool KnxComponent::group_answer_bool(String address, bool value) {
-    int valueAsInt = 0;
-    if (value) {
-      valueAsInt = 0b00000001;
-    }
+  KnxTxHandle KnxComponent::group_answer_3byte_time(KnxGroupAddress address, int weekday, int hour, int minute, int second) {
+    return this->group_answer<Dpt<10>>(address, {(uint8_t) weekday, (uint8_t) hour, (uint8_t) minute, (uint8_t) second});
+  }
 
-    create_knx_message_frame(2, KNX_COMMAND_ANSWER, address, valueAsInt);
-    return this->send_message();
+  KnxTxHandle KnxComponent::group_answer_3byte_date(KnxGroupAddress address, int day, int month, int year) {
+    return this->group_answer<Dpt<11>>(address, {(uint8_t) day, (uint8_t) month, (uint16_t) year});
   }
 
-  /*
-    bool KnxComponent::groupAnswerBitInt(String address, int value) {
-    int out_value = 0;
-    if (value) {
-      out_value = value & 0b00001111;
-    }
+  KnxTxHandle KnxComponent::group_answer_4byte_float(KnxGroupAddress address, float value) {
+    return this->group_answer<Dpt<14>>(address, value);
+  }
 
-    this->create_knx_message_frame(2, KNX_COMMAND_ANSWER, address, out_value);
-    return this->send_message();
-    }
+  KnxTxHandle KnxComponent::group_answer_14byte_text(KnxGroupAddress address, KnxText value) {
+    return this->group_answer<Dpt<16>>(address, value.c_str());
+  }
 
-    bool KnxComponent::group_answer_4bit_dim(String address, bool direction, byte steps) {
-    int value = 0;
-    if (direction || steps) {
-      value = (direction << 3) + (steps & 0b00000111);
-    }
+  KnxTxHandle KnxComponent::group_write_bool(KnxText address, bool value) {
+    return this->group_write<Dpt<1>>(address, value);
+  }
 
-    this->create_knx_message_frame(2, KNX_COMMAND_ANSWER, address, value);
-    return this->send_message();
-    }
-  */
+  KnxTxHandle KnxComponent::group_write_4bit_int(KnxText address, int value) {
+    return this->group_write<Dpt<3>>(address, {(value & 0b00001000) != 0, (uint8_t) (value & 0b00000111)});
+  }
 
-  bool KnxComponent::group_answer_1byte_int(String address, int value) {
-    this->create_knx_message_frame(2, KNX_COMMAND_ANSWER, address, 0);
-    this->_tg->set_1byte_int_value(value);
-    this->_tg->create_checksum();
-    return this->send_message();
+  KnxTxHandle KnxComponent::group_write_4Bit_dim(KnxText address, bool direction, uint8_t steps) {
+    return this->group_write<Dpt<3>>(address, {direction, steps});
   }
 
-  bool KnxComponent::group_answer_2byte_int(String address, int value) {
-    this->create_knx_message_frame(2, KNX_COMMAND_ANSWER, address, 0);
-    this->_tg->set_2byte_int_value(value);
-    this->_tg->create_checksum();
-    return this->send_message();
+  KnxTxHandle KnxComponent::group_write_1byte_int(KnxText address, int value) {
+    return this->group_write<Dpt<5>>(address, value);
   }
 
-  bool KnxComponent::group_answer_2byte_float(String address, float value) {
-    this->create_knx_message_frame(2, KNX_COMMAND_ANSWER, address, 0);
-    this->_tg->set_2byte_float_value(value);
-    this->_tg->create_checksum();
-    return this->send_message();
+  KnxTxHandle KnxComponent::group_write_2byte_int(KnxText address, int value) {
+    return this->group_write<Dpt<7>>(address, value);
   }
 
-  bool KnxComponent::group_answer_3byte_time(String address, int weekday, int hour, int minute, int second) {
-    this->create_knx_message_frame(2, KNX_COMMAND_ANSWER, address, 0);
-    this->_tg->set_3byte_time(weekday, hour, minute, second);
-    this->_tg->create_checksum();
-    return this->send_message();
+  KnxTxHandle KnxComponent::group_write_2byte_float(KnxText address, float value) {
+    return this->group_write<Dpt<9>>(address, value);
   }
 
-  bool KnxComponent::group_answer_3byte_date(String address, int day, int month, int year) {
-    this->create_knx_message_frame(2, KNX_COMMAND_ANSWER, address, 0);
-    this->_tg->set_3byte_date(day, month, year);
-    this->_tg->create_checksum();
-    return this->send_message();
+  KnxTxHandle KnxComponent::group_write_3byte_time(KnxText address, int weekday, int hour, int minute, int second) {
+    return this->group_write<Dpt<10>>(address, {(uint8_t) weekday, (uint8_t) hour, (uint8_t) minute, (uint8_t) second});
   }
-  bool KnxComponent::group_answer_4byte_float(String address, float value) {
-    this->create_knx_message_frame(2, KNX_COMMAND_ANSWER, address, 0);
-    this->_tg->set_4byte_float_value(value);
-    this->_tg->create_checksum();
-    return this->send_message();
+
+  KnxTxHandle KnxComponent::group_write_3byte_date(KnxText address, int day, int month, int year) {
+    return this->group_write<Dpt<11>>(address, {(uint8_t) day, (uint8_t) month, (uint16_t) year});
   }
 
-  bool KnxComponent::group_answer_14byte_text(String address, String value) {
-    this->create_knx_message_frame(2, KNX_COMMAND_ANSWER, address, 0);
-    this->_tg->set_14byte_value(value);
-    this->_tg->create_checksum();
-    return this->send_message();
+  KnxTxHandle KnxComponent::group_write_4byte_float(KnxText address, float value) {
+    return this->group_write<Dpt<14>>(address, value);
+  }
+
+  KnxTxHandle KnxComponent::group_write_14byte_text(KnxText address, KnxText value) {
+    return this->group_write<Dpt<16>>(address, value.c_str());
+  }
+
+  KnxTxHandle KnxComponent::group_answer_bool(KnxText address, bool value) {
+    return this->group_answer<Dpt<1>>(address, value);
+  }
+
+  KnxTxHandle KnxComponent::group_answer_1byte_int(KnxText address, int value) {
+    return this->group_answer<Dpt<5>>(address, value);
+  }
+
+  KnxTxHandle KnxComponent::group_answer_2byte_int(KnxText address, int value) {
+    return this->group_answer<Dpt<7>>(address, value);
+  }
+
+  KnxTxHandle KnxComponent::group_answer_2byte_float(KnxText address, float value) {
+    return this->group_answer<Dpt<9>>(address, value);
+  }
+
+  KnxTxHandle KnxComponent::group_answer_3byte_time(KnxText address, int weekday, int hour, int minute, int second) {
+    return this->group_answer<Dpt<10>>(address, {(uint8_t) weekday, (uint8_t) hour, (uint8_t) minute, (uint8_t) second});
+  }
+
+  KnxTxHandle KnxComponent::group_answer_3byte_date(KnxText address, int day, int month, int year) {
+    return this->group_answer<Dpt<11>>(address, {(uint8_t) day, (uint8_t) month, (uint16_t) year});
+  }
+
+  KnxTxHandle KnxComponent::group_answer_4byte_float(KnxText address, float value) {
+    return this->group_answer<Dpt<14>>(address, value);
+  }
+
+  KnxTxHandle KnxComponent::group_answer_14byte_text(KnxText address, KnxText value) {
+    return this->group_answer<Dpt<16>>(address, value.c_str());
   }
 
   // Command Read
 
-  bool KnxComponent::group_read(String address) {
+  KnxTxHandle KnxComponent::group_read(KnxGroupAddress address) {
     this->create_knx_message_frame(2, KNX_COMMAND_READ, address, 0);
     this->_tg->create_checksum();
     return this->send_message();
   }
 
-  bool KnxComponent::individual_answer_address() {
-    this->create_knx_message_frame(2, KNX_COMMAND_INDIVIDUAL_ADDR_RESPONSE, "0/0/0", 0);
+  KnxTxHandle KnxComponent::group_read(KnxText address) {
+    KnxGroupAddress groupAddress;
+    if (!this->parse_group_address(address, &groupAddress)) {
+      return KNX_TX_INVALID_HANDLE;
+    }
+    return this->group_read(groupAddress);
+  }
+
+  KnxTxHandle KnxComponent::individual_answer_address() {
+    this->create_knx_message_frame(2, KNX_COMMAND_INDIVIDUAL_ADDR_RESPONSE, KnxGroupAddress(0, 0, 0), 0);
     this->_tg->create_checksum();
     return this->send_message();
   }
 
-  bool KnxComponent::individual_answer_mask_version(int area, int line, int member) {
-    this->create_knx_message_frame_individual(4, KNX_COMMAND_MASK_VERSION_RESPONSE, String(area) + "/" + String(line) + "/" + String(member), 0);
+  KnxTxHandle KnxComponent::individual_answer_mask_version(int area, int line, int member) {
+    this->create_knx_message_frame_individual(4, KNX_COMMAND_MASK_VERSION_RESPONSE, area, line, member, 0);
     this->_tg->set_communication_type(KNX_COMM_NDP);
     this->_tg->set_buffer_byte(8, 0x07); // Mask version part 1 for BIM M 112
     this->_tg->set_buffer_byte(9, 0x01); // Mask version part 2 for BIM M 112
@@ -353,8 +454,8 @@ namespace knx {
     return this->send_message();
   }
 
-  bool KnxComponent::individual_answer_auth(int accessLevel, int sequenceNo, int area, int line, int member) {
-    this->create_knx_message_frame_individual(3, KNX_COMMAND_ESCAPE, String(area) + "/" + String(line) + "/" + String(member), KNX_EXT_COMMAND_AUTH_RESPONSE);
+  KnxTxHandle KnxComponent::individual_answer_auth(int accessLevel, int sequenceNo, int area, int line, int member) {
+    this->create_knx_message_frame_individual(3, KNX_COMMAND_ESCAPE, area, line, member, KNX_EXT_COMMAND_AUTH_RESPONSE);
     this->_tg->set_communication_type(KNX_COMM_NDP);
     this->_tg->set_sequence_number(sequenceNo);
     this->_tg->set_buffer_byte(8, accessLevel);
@@ -362,23 +463,17 @@ namespace knx {
     return this->send_message();
   }
 
-  void KnxComponent::create_knx_message_frame(int payloadlength, KnxCommandType command, String address, int firstDataByte) {
-    int mainGroup = address.substring(0, address.indexOf('/')).toInt();
-    int middleGroup = address.substring(address.indexOf('/') + 1, address.length()).substring(0, address.substring(address.indexOf('/') + 1, address.length()).indexOf('/')).toInt();
-    int subGroup = address.substring(address.lastIndexOf('/') + 1, address.length()).toInt();
+  void KnxComponent::create_knx_message_frame(int payloadlength, KnxCommandType command, KnxGroupAddress address, int firstDataByte) {
     this->_tg->clear();
     this->_tg->set_source_address(_source_area, _source_line, _source_member);
-    this->_tg->set_target_group_address(mainGroup, middleGroup, subGroup);
+    this->_tg->set_target_group_address(address);
     this->_tg->set_first_data_byte(firstDataByte);
     this->_tg->set_command(command);
     this->_tg->set_payload_length(payloadlength);
     this->_tg->create_checksum();
   }
 
-  void KnxComponent::create_knx_message_frame_individual(int payloadlength, KnxCommandType command, String address, int firstDataByte) {
-    int area = address.substring(0, address.indexOf('/')).toInt();
-    int line = address.substring(address.indexOf('/') + 1, address.length()).substring(0, address.substring(address.indexOf('/') + 1, address.length()).indexOf('/')).toInt();
-    int member = address.substring(address.lastIndexOf('/') + 1, address.length()).toInt();
+  void KnxComponent::create_knx_message_frame_individual(int payloadlength, KnxCommandType command, int area, int line, int member, int firstDataByte) {
     this->_tg->clear();
     this->_tg->set_source_address(_source_area, _source_line, _source_member);
     this->_tg->set_target_individual_address(area, line, member);
@@ -388,7 +483,15 @@ namespace knx {
     this->_tg->create_checksum();
   }
 
-  bool KnxComponent::send_ncd_pos_confirm(int sequenceNo, int area, int line, int member) {
+  bool KnxComponent::parse_group_address(KnxText address, KnxGroupAddress *groupAddress) {
+    if (!KnxGroupAddress::parse(address.c_str(), groupAddress)) {
+      ESP_LOGW(TAG, "Invalid group address '%s', expected main/middle/sub.", address.c_str());
+      return false;
+    }
+    return true;
+  }
+
+  KnxTxHandle KnxComponent::send_ncd_pos_confirm(int sequenceNo, int area, int line, int member) {
     this->_tg_ptp->clear();
     this->_tg_ptp->set_source_address(_source_area, _source_line, _source_member);
     this->_tg_ptp->set_target_individual_address(area, line, member);
@@ -398,140 +501,399 @@ namespace knx {
     this->_tg_ptp->set_payload_length(1);
     this->_tg_ptp->create_checksum();
 
+    return this->send_telegram(this->_tg_ptp);
+  }
+
+  KnxTxHandle KnxComponent::send_message() {
+    return this->send_telegram(this->_tg);
+  }
 
-    int messageSize = this->_tg_ptp->get_total_length();
+  KnxTxHandle KnxComponent::send_telegram(KnxTelegram* telegram) {
+    return this->queue_telegram(telegram, KNX_TX_INVALID_HANDLE);
+  }
 
-    uint8_t sendbuf[2];
-    for (int i = 0; i < messageSize; i++) {
-      if (i == (messageSize - 1)) {
-        sendbuf[0] = TPUART_DATA_END;
+  KnxTxHandle KnxComponent::next_tx_handle() {
+    KnxTxHandle handle = this->tx_next_handle_++;
+    if (this->tx_next_handle_ == KNX_TX_INVALID_HANDLE) {
+      this->tx_next_handle_++;
+    }
+    return handle;
+  }
+
+  // handle is given for writes that were already handed out a handle while held back, otherwise a new one is taken
+  KnxTxHandle KnxComponent::queue_telegram(KnxTelegram* telegram, KnxTxHandle handle) {
+    if (this->tx_count_ >= KNX_TX_QUEUE_SIZE) {
+      ESP_LOGW(TAG, "Transmit queue full (%d telegrams), dropping telegram.", KNX_TX_QUEUE_SIZE);
+      return KNX_TX_INVALID_HANDLE;
+    }
+    // Long extended frames do not fit a queue slot, they wait in the single extended transmit buffer
+    bool extended = telegram->get_total_length() > MAX_KNX_TELEGRAM_SIZE;
+    if (extended) {
+      if (this->tx_extended_busy_) {
+        ESP_LOGW(TAG, "An extended telegram is already queued, dropping telegram.");
+        return KNX_TX_INVALID_HANDLE;
       }
-      else {
-        sendbuf[0] = TPUART_DATA_START_CONTINUE;
+      if (telegram != &this->tx_extended_) {
+        this->tx_extended_ = *telegram;
       }
+      this->tx_extended_busy_ = true;
+    }
+    // Free slots keep their final state for get_tx_state() until they are reused
+    int slot = 0;
+    while (this->tx_queue_[slot].state == KNX_TX_QUEUED || this->tx_queue_[slot].state == KNX_TX_SENT) {
+      slot++;
+    }
+    KnxTxEntry &entry = this->tx_queue_[slot];
+    if (!extended) {
+      entry.telegram = *telegram;
+    }
+    entry.extended = extended;
+    entry.handle = handle != KNX_TX_INVALID_HANDLE ? handle : this->next_tx_handle();
+    entry.state = KNX_TX_QUEUED;
+    int level = tx_priority_level(telegram->get_priority());
+    this->tx_level_slots_[level][(this->tx_level_head_[level] + this->tx_level_count_[level]) % KNX_TX_QUEUE_SIZE] = slot;
+    this->tx_level_count_[level]++;
+    this->tx_count_++;
+    // Our own writes and answers update the cache too, our own reads must not be answered
+    if (telegram->is_target_group() && telegram->get_command() != KNX_COMMAND_READ) {
+      this->update_group_object(telegram);
+    }
+    return entry.handle;
+  }
 
-      sendbuf[0] |= i;
-      sendbuf[1] = this->_tg_ptp->get_buffer_byte(i);
-
-      this->write_array(sendbuf, 2);
+  void KnxComponent::add_group_object(KnxGroupAddress address, uint16_t dpt, uint8_t length, KnxPriorityType priority) {
+    if (length > MAX_KNX_GROUP_OBJECT_LENGTH) {
+      ESP_LOGW(TAG, "DPT %u is too long for the group object cache.", dpt);
+      return;
     }
+    KnxGroupObject &object = this->group_objects_[address.raw()];
+    object.dpt = dpt;
+    object.length = length;
+    object.priority = priority;
+    object.valid = false;
+    this->_listen_group_addresses.add(address.raw());
+  }
+
+  void KnxComponent::set_send_policy(KnxGroupAddress address, uint32_t min_interval_ms, float send_on_delta) {
+    KnxGroupObject *object = this->find_group_object(address);
+    if (object == nullptr) {
+      ESP_LOGW(TAG, "Send policy for %d/%d/%d ignored, it is not a group object.", address.main(), address.middle(), address.sub());
+      return;
+    }
+    object->min_interval_ms = min_interval_ms;
+    object->send_on_delta = send_on_delta;
+  }
 
+  KnxGroupObject *KnxComponent::find_group_object(KnxGroupAddress address) {
+    auto it = this->group_objects_.find(address.raw());
+    return it == this->group_objects_.end() ? nullptr : &it->second;
+  }
+
+  KnxTxHandle KnxComponent::send_group_object_write(KnxGroupObject *object, KnxTelegram *telegram) {
+    uint8_t value[1 + MAX_KNX_GROUP_OBJECT_LENGTH];
+    if (!telegram->get_value(value, object->length)) {
+      // Not the configured datapoint type, no policy applies
+      return this->send_telegram(telegram);
+    }
 
-    int confirmation;
-    while (true) {
-      confirmation = serial_read();
-      if (confirmation == 0b10001011) {
-        return true; // Sent successfully
+    // Last value wins while the previous write still waits in the queue
+    KnxTxEntry *entry = this->find_tx_entry(object->pending_handle);
+    if (entry != nullptr && entry->state == KNX_TX_QUEUED && !entry->extended) {
+      int from = tx_priority_level(entry->telegram.get_priority());
+      int to = tx_priority_level(telegram->get_priority());
+      if (from != to) {
+        // Taken out of the FIFO of its old priority and queued again at the end of the new one
+        this->tx_level_remove(from, entry - this->tx_queue_);
+        this->tx_level_slots_[to][(this->tx_level_head_[to] + this->tx_level_count_[to]) % KNX_TX_QUEUE_SIZE] = entry - this->tx_queue_;
+        this->tx_level_count_[to]++;
       }
-      else if (confirmation == 0b00001011) {
-        return false;
+      entry->telegram = *telegram;
+      memcpy(object->sent_value, value, sizeof(value));
+      this->update_group_object(telegram);
+      object->suppressed++;
+      this->metrics_.tx_suppressed++;
+      return object->pending_handle;
+    }
+    object->pending_handle = KNX_TX_INVALID_HANDLE;
+
+    // Held back, the handle stays queued until the interval has passed and it is sent with the latest value
+    if (object->sent && millis() - object->sent_ms < object->min_interval_ms) {
+      if (object->deferred) {
+        object->suppressed++;
+        this->metrics_.tx_suppressed++;
       }
-      else if (confirmation == -1) {
-        // Read timeout
-        return false;
+      else {
+        object->deferred = true;
+        object->deferred_handle = this->next_tx_handle();
+        this->deferred_count_++;
       }
+      memcpy(object->deferred_value, value, sizeof(value));
+      object->deferred_priority = telegram->get_priority();
+      return object->deferred_handle;
     }
-
-    return false;
+    return this->enqueue_group_object_write(object, telegram, KNX_TX_INVALID_HANDLE);
   }
 
-  bool KnxComponent::send_message() {
-    int messageSize = this->_tg->get_total_length();
+  KnxTxHandle KnxComponent::enqueue_group_object_write(KnxGroupObject *object, KnxTelegram *telegram, KnxTxHandle handle) {
+    handle = this->queue_telegram(telegram, handle);
+    if (handle != KNX_TX_INVALID_HANDLE) {
+      object->pending_handle = handle;
+      object->sent = true;
+      object->sent_ms = millis();
+      telegram->get_value(object->sent_value, object->length);
+    }
+    return handle;
+  }
 
-    uint8_t sendbuf[2];
-    for (int i = 0; i < messageSize; i++) {
-      if (i == (messageSize - 1)) {
-        sendbuf[0] = TPUART_DATA_END;
+  // Sends the writes held back by min_interval once their interval has passed
+  void KnxComponent::flush_deferred_writes() {
+    if (this->deferred_count_ == 0) {
+      return;
+    }
+    uint32_t now = millis();
+    for (auto &it : this->group_objects_) {
+      KnxGroupObject &object = it.second;
+      if (!object.deferred || now - object.sent_ms < object.min_interval_ms) {
+        continue;
       }
-      else {
-        sendbuf[0] = TPUART_DATA_START_CONTINUE;
+      KnxStandardTelegram telegram;
+      telegram.set_source_address(_source_area, _source_line, _source_member);
+      telegram.set_target_group_address(KnxGroupAddress(it.first));
+      telegram.set_command(KNX_COMMAND_WRITE);
+      telegram.set_priority(object.deferred_priority);
+      telegram.set_value(object.deferred_value, object.length);
+      telegram.create_checksum();
+      if (this->enqueue_group_object_write(&object, &telegram, object.deferred_handle) == KNX_TX_INVALID_HANDLE) {
+        // Queue full, try again on the next loop
+        continue;
       }
+      object.deferred = false;
+      object.deferred_handle = KNX_TX_INVALID_HANDLE;
+      this->deferred_count_--;
+    }
+  }
 
-      sendbuf[0] |= i;
-      sendbuf[1] = this->_tg->get_buffer_byte(i);
+  // Keeps the cache in step with writes and answers, and answers reads from it
+  void KnxComponent::update_group_object(KnxTelegram* telegram) {
+    auto it = this->group_objects_.find(telegram->get_target_group_address().raw());
+    if (it == this->group_objects_.end()) {
+      return;
+    }
+    KnxGroupObject &object = it->second;
+    KnxCommandType command = telegram->get_command();
+    if (command == KNX_COMMAND_WRITE || command == KNX_COMMAND_ANSWER) {
+      if (telegram->get_value(object.value, object.length)) {
+        object.valid = true;
+      }
+    }
+    else if (command == KNX_COMMAND_READ && object.valid) {
+      KnxStandardTelegram answer;
+      answer.set_source_address(_source_area, _source_line, _source_member);
+      answer.set_target_group_address(telegram->get_target_group_address());
+      answer.set_command(KNX_COMMAND_ANSWER);
+      answer.set_priority(object.priority);
+      answer.set_value(object.value, object.length);
+      answer.create_checksum();
+      this->send_telegram(&answer);
+    }
+  }
 
-      this->write_array(sendbuf, 2);
+  KnxTxHandle KnxComponent::group_write_data(KnxGroupAddress address, const uint8_t *data, int length) {
+    if (length + 2 <= this->_tg->get_max_payload_length()) {
+      this->create_knx_message_frame(2, KNX_COMMAND_WRITE, address, 0);
+      this->_tg->set_data(data, length);
+      this->_tg->create_checksum();
+      return this->send_message();
+    }
+    if (this->tx_extended_busy_) {
+      ESP_LOGW(TAG, "An extended telegram is already queued, dropping telegram.");
+      return KNX_TX_INVALID_HANDLE;
     }
+    this->tx_extended_.clear(true);
+    this->tx_extended_.set_source_address(_source_area, _source_line, _source_member);
+    this->tx_extended_.set_target_group_address(address);
+    this->tx_extended_.set_command(KNX_COMMAND_WRITE);
+    if (!this->tx_extended_.set_data(data, length)) {
+      ESP_LOGW(TAG, "%d data bytes do not fit an extended telegram.", length);
+      return KNX_TX_INVALID_HANDLE;
+    }
+    this->tx_extended_.create_checksum();
+    return this->send_telegram(&this->tx_extended_);
+  }
 
+  void KnxComponent::process_tx_queue() {
+    if (this->tx_current_ >= 0) {
+      // Never shorter than the transport needs, or its late confirmation would be taken for the next telegram
+      uint32_t timeout = std::max(this->serial_timeout_, this->transport_->confirm_timeout_ms());
+      if (millis() - this->tx_sent_ms_ > timeout) {
+        ESP_LOGW(TAG, "No confirmation within %u ms !", (unsigned) timeout);
+        this->tx_complete(KNX_TX_TIMED_OUT);
+      }
+      return;
+    }
+    if (this->tx_count_ == 0) {
+      return;
+    }
+    if (!this->transport_->ready_to_send()) {
+      return;
+    }
+    int level = this->next_tx_level();
+    this->tx_current_ = this->tx_level_slots_[level][this->tx_level_head_[level]];
+    this->tx_level_head_[level] = (this->tx_level_head_[level] + 1) % KNX_TX_QUEUE_SIZE;
+    this->tx_level_count_[level]--;
+
+    KnxTxEntry &entry = this->tx_queue_[this->tx_current_];
+    KnxTelegram *telegram = entry.extended ? static_cast<KnxTelegram *>(&this->tx_extended_) : &entry.telegram;
+    KNX_TRACE("tx %s", format_hex(telegram->data(), telegram->get_total_length()).c_str());
+    entry.state = KNX_TX_SENT;
+    this->tx_sent_ms_ = millis();
+    this->tx_sent_us_ = micros();
+    // May complete right away if the transport cannot take the telegram
+    this->transport_->send(telegram);
+  }
+
+  // Takes a queued slot out of the FIFO of level, the slots behind it move up
+  void KnxComponent::tx_level_remove(int level, int slot) {
+    int count = this->tx_level_count_[level];
+    int position = 0;
+    while (position < count && this->tx_level_slots_[level][(this->tx_level_head_[level] + position) % KNX_TX_QUEUE_SIZE] != slot) {
+      position++;
+    }
+    if (position == count) {
+      return;
+    }
+    for (; position < count - 1; position++) {
+      this->tx_level_slots_[level][(this->tx_level_head_[level] + position) % KNX_TX_QUEUE_SIZE] =
+        this->tx_level_slots_[level][(this->tx_level_head_[level] + position + 1) % KNX_TX_QUEUE_SIZE];
+    }
+    this->tx_level_count_[level]--;
+  }
 
-    int confirmation;
-    while (true) {
-      confirmation = this->serial_read();
-      if (confirmation == 0b10001011) {
-        delay (SERIAL_WRITE_DELAY_MS);
-        return true; // Sent successfully
+  // Highest waiting priority, unless a lower one has been passed over too often
+  int KnxComponent::next_tx_level() {
+    int level = -1;
+    for (int i = 0; i < KNX_TX_PRIORITY_LEVELS; i++) {
+      if (this->tx_level_count_[i] == 0) {
+        this->tx_level_skipped_[i] = 0;
+        continue;
       }
-      else if (confirmation == 0b00001011) {
-        delay (SERIAL_WRITE_DELAY_MS);
-        return false;
+      if (level < 0) {
+        level = i;
       }
-      else if (confirmation == -1) {
-        // Read timeout
-        ESP_LOGD(TAG, "Serial read timeout !");
-        delay (SERIAL_WRITE_DELAY_MS);
-        return false;
+      else if (this->tx_level_skipped_[i] >= KNX_TX_STARVATION_LIMIT) {
+        level = i;
+        break;
       }
     }
-
-    return false;
+    for (int i = level + 1; i < KNX_TX_PRIORITY_LEVELS; i++) {
+      if (this->tx_level_count_[i] > 0) {
+        this->tx_level_skipped_[i]++;
+      }
+    }
+    this->tx_level_skipped_[level] = 0;
+    return level;
   }
 
-  void KnxComponent::send_ack() {
-    uint8_t sendByte = 0b00010001;
-    this->write(sendByte);
-    delay(SERIAL_WRITE_DELAY_MS);
+  void KnxComponent::tx_complete(KnxTxState state) {
+    if (this->tx_current_ < 0) {
+      ESP_LOGV(TAG, "Unexpected confirmation");
+      return;
+    }
+    KnxTxEntry &entry = this->tx_queue_[this->tx_current_];
+    entry.state = state;
+    KnxCaptureResult result;
+    if (state == KNX_TX_CONFIRMED) {
+      this->metrics_.tx_confirmed++;
+      result = KNX_CAPTURE_TX_CONFIRMED;
+    }
+    else if (state == KNX_TX_NACKED) {
+      this->metrics_.tx_failed++;
+      result = KNX_CAPTURE_TX_NACKED;
+    }
+    else {
+      this->metrics_.tx_timed_out++;
+      result = KNX_CAPTURE_TX_TIMED_OUT;
+    }
+    this->capture_frame(entry.extended ? static_cast<KnxTelegram *>(&this->tx_extended_) : &entry.telegram, this->tx_sent_us_, result);
+#ifdef USE_KNX_ROUTING
+    // Our own frames are on the line too, frames that came from IP are skipped by the router
+    if (state == KNX_TX_CONFIRMED && this->router_ != nullptr) {
+      this->router_->route_to_ip(entry.extended ? static_cast<KnxTelegram *>(&this->tx_extended_) : &entry.telegram, entry.handle);
+    }
+#endif
+    if (entry.extended) {
+      this->tx_extended_busy_ = false;
+    }
+    KnxTxHandle handle = entry.handle;
+    this->tx_current_ = -1;
+    this->tx_count_--;
+    // The callback may queue new telegrams into the slot we just released
+    this->tx_complete_callback_.call(handle, state);
   }
 
-  void KnxComponent::send_not_addressed() {
-    uint8_t sendByte = 0b00010000;
-    this->write(sendByte);
-    delay(SERIAL_WRITE_DELAY_MS);
+  KnxTxState KnxComponent::get_tx_state(KnxTxHandle handle) {
+    KnxTxEntry *entry = this->find_tx_entry(handle);
+    if (entry != nullptr) {
+      return entry->state;
+    }
+    // Writes held back by min_interval count as queued
+    if (this->deferred_count_ > 0 && handle != KNX_TX_INVALID_HANDLE) {
+      for (auto &it : this->group_objects_) {
+        if (it.second.deferred && it.second.deferred_handle == handle) {
+          return KNX_TX_QUEUED;
+        }
+      }
+    }
+    return KNX_TX_UNKNOWN;
   }
 
-  int KnxComponent::serial_read() {
-    unsigned long startTime = millis();
-    bool isSerialAvailable = true;
-    while (! ( this->available() > 0)) {
-      delay(1);
-      if(millis() - startTime > this->serial_timeout_){
-        ESP_LOGW(TAG, "Serial timeout reached (%d ms) ! Unable to read from serial ! Aborting.", this->serial_timeout_);
-        isSerialAvailable = false;
-        break;
+  KnxTxEntry *KnxComponent::find_tx_entry(KnxTxHandle handle) {
+    if (handle == KNX_TX_INVALID_HANDLE) {
+      return nullptr;
+    }
+    for (int i = 0; i < KNX_TX_QUEUE_SIZE; i++) {
+      if (this->tx_queue_[i].handle == handle) {
+        return &this->tx_queue_[i];
       }
     }
-    int inByte = -1;
-    if (isSerialAvailable){
-      inByte = this->read();
-      this->check_errors();
-      this->print_byte(inByte);
-    } 
+    return nullptr;
+  }
 
-    return inByte;
+  void KnxComponent::add_group_handler(KnxGroupAddress address, KnxCommandType command, Trigger<KnxTelegram *> *trigger) {
+    this->group_handlers_[address.raw()].push_back({command, trigger});
+    // A handler is useless if the telegrams never get past the filter
+    this->add_listen_group_address(address);
   }
 
-  void KnxComponent::add_listen_group_address(String address) {
-    if (_listen_group_address_count >= MAX_LISTEN_GROUP_ADDRESSES) {
-      ESP_LOGW(TAG, "Already listening to MAX_LISTEN_GROUP_ADDRESSES, cannot listen to another.");
-      return;
+  bool KnxComponent::dispatch_group_telegram(KnxTelegram* telegram) {
+    auto it = this->group_handlers_.find(telegram->get_target_group_address().raw());
+    if (it == this->group_handlers_.end()) {
+      return false;
     }
-    this->_listen_group_addresses[this->_listen_group_address_count][0] = address.substring(0, address.indexOf('/')).toInt();
-    ;
-    this->_listen_group_addresses[this->_listen_group_address_count][1] = address.substring(address.indexOf('/') + 1, address.length()).substring(0, address.substring(address.indexOf('/') + 1, address.length()).indexOf('/')).toInt();
-    this->_listen_group_addresses[this->_listen_group_address_count][2] = address.substring(address.lastIndexOf('/') + 1, address.length()).toInt();
+    KnxCommandType command = telegram->get_command();
+    bool handled = false;
+    for (auto &handler : it->second) {
+      if (handler.command == command) {
+        handler.trigger->trigger(telegram);
+        handled = true;
+      }
+    }
+    return handled;
+  }
 
-    this->_listen_group_address_count++;
+  void KnxComponent::add_listen_group_address(KnxGroupAddress address) {
+    this->_listen_group_addresses.add(address.raw());
   }
 
-  bool KnxComponent::is_listening_to_group_address(int main, int middle, int sub) {
-    for (int i = 0; i < this->_listen_group_address_count; i++) {
-      if ( (_listen_group_addresses[i][0] == main)
-          && (_listen_group_addresses[i][1] == middle)
-          && (_listen_group_addresses[i][2] == sub)) {
-        return true;
-      }
+  void KnxComponent::add_listen_group_address(KnxText address) {
+    KnxGroupAddress groupAddress;
+    if (this->parse_group_address(address, &groupAddress)) {
+      this->add_listen_group_address(groupAddress);
     }
+  }
 
-    return false;
+  bool KnxComponent::is_listening_to_group_address(int main, int middle, int sub) {
+    return this->is_listening_to_group_address(KnxGroupAddress(main, middle, sub));
   }
 
 }  // namespace knx
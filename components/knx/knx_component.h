@@ -4,118 +4,422 @@
 #pragma once
 
 #include "esphome.h"
+#include "esphome/core/defines.h"
 #include "esphome/core/component.h"
-#include "esphome/components/uart/uart.h"
+#include "esphome/core/helpers.h"
+#include "esphome/core/automation.h"
 #include "knx_telegram.h"
+#include "knx_dpt.h"
+#include "knx_group_filter.h"
+#include "knx_bus_monitor.h"
+#include "knx_bus_capture.h"
+#include "knx_transport.h"
+#include <cmath>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
 
 using namespace std;
 static const char *const TAG = "knx"; 
 
+// One line per frame on the receive and transmit paths, only compiled in with `trace: true` (USE_KNX_TRACE).
+// When disabled the arguments are not evaluated, so they may format freely.
+#ifdef USE_KNX_TRACE
+#define KNX_TRACE(format, ...) ESP_LOGD(TAG, format, ##__VA_ARGS__)
+#else
+#define KNX_TRACE(format, ...)
+#endif
+
 namespace esphome {
 namespace knx {
 
-static const int MAX_LISTEN_GROUP_ADDRESSES = 15;
-static const int SERIAL_WRITE_DELAY_MS = 100;
-inline constexpr uint8_t TPUART_DATA_START_CONTINUE = 0b10000000;
-inline constexpr uint8_t TPUART_DATA_END = 0b01000000;
-// Services from TPUART
-inline constexpr uint8_t TPUART_RESET_INDICATION_BYTE = 0b11;
-
-enum KnxComponentserial_eventType {
-  TPUART_RESET_INDICATION,
-  KNX_TELEGRAM,
-  IRRELEVANT_KNX_TELEGRAM,
-  UNKNOWN
+static const int KNX_TX_QUEUE_SIZE = 16;
+// One transmit FIFO per KnxPriorityType, served system > alarm > high > normal
+static const int KNX_TX_PRIORITY_LEVELS = 4;
+// A waiting level is served after it has been passed over this many times
+static const int KNX_TX_STARVATION_LIMIT = 8;
+// Receive dedup: a repeated frame (repeat flag cleared) matching one of the last KNX_RX_DEDUP_SIZE frames
+// within KNX_RX_REPEAT_WINDOW_MS is dropped, an identical frame without the flag only within KNX_RX_DUPLICATE_WINDOW_MS
+static const int KNX_RX_DEDUP_SIZE = 8;
+static const uint32_t KNX_RX_REPEAT_WINDOW_MS = 1000;
+static const uint32_t KNX_RX_DUPLICATE_WINDOW_MS = 100;
+// Longest datapoint kept in the group object cache (DPT 16, 14 characters)
+inline constexpr uint8_t MAX_KNX_GROUP_OBJECT_LENGTH = 14;
+// Lifecycle of a telegram handed to send_message()
+enum KnxTxState {
+  KNX_TX_UNKNOWN,     // Handle is invalid or its slot has been reused
+  KNX_TX_QUEUED,
+  KNX_TX_SENT,        // Handed to the transport, waiting for L_DATA.con
+  KNX_TX_CONFIRMED,
+  KNX_TX_NACKED,
+  KNX_TX_TIMED_OUT
+};
+
+using KnxTxHandle = uint16_t;
+inline constexpr KnxTxHandle KNX_TX_INVALID_HANDLE = 0;
+
+struct KnxTxEntry {
+  KnxStandardTelegram telegram;
+  bool extended{false};  // Frame is held in KnxComponent::tx_extended_
+  KnxTxHandle handle{KNX_TX_INVALID_HANDLE};
+  KnxTxState state{KNX_TX_UNKNOWN};
+};
+
+// Last value seen on the bus (or sent by us) for a configured group address
+struct KnxGroupObject {
+  uint16_t dpt;        // Main DPT number, informational
+  uint8_t length;      // Octets after the APCI octet, as Dpt<>::length
+  bool valid{false};   // A value has been written or answered since boot
+  uint8_t value[1 + MAX_KNX_GROUP_OBJECT_LENGTH];
+
+  // Send policy for our own writes to this address
+  KnxPriorityType priority{KNX_PRIORITY_NORMAL};
+  uint32_t min_interval_ms{0};
+  float send_on_delta{0};
+  KnxTxHandle pending_handle{KNX_TX_INVALID_HANDLE};  // Queued write that newer values replace
+  bool sent{false};
+  uint32_t sent_ms{0};
+  uint8_t sent_value[1 + MAX_KNX_GROUP_OBJECT_LENGTH];
+  bool deferred{false};                                // Held back by min_interval, sent from loop()
+  uint8_t deferred_value[1 + MAX_KNX_GROUP_OBJECT_LENGTH];
+  KnxPriorityType deferred_priority{KNX_PRIORITY_NORMAL};  // As requested by the latest held back write
+  KnxTxHandle deferred_handle{KNX_TX_INVALID_HANDLE};  // Handle the held back write is queued with
+  uint32_t suppressed{0};
+};
+
+// Counters kept while running, read by the knx sensor platform
+struct KnxMetrics {
+  uint32_t rx_frames{0};            // Complete frames received
+  uint32_t rx_accepted{0};          // Addressed to us and dispatched
+  uint32_t rx_filtered{0};          // Not addressed to us
+  uint32_t rx_duplicates{0};        // Repeated copies, acknowledged but not dispatched
+  uint32_t rx_checksum_errors{0};   // Also frames with an impossible length
+  uint32_t rx_timeouts{0};          // Incomplete frames discarded after a gap on the bus
+  uint32_t acks_sent{0};
+  uint32_t not_addressed_sent{0};
+  uint32_t bus_acks{0};             // Acknowledge frames of other devices seen on the bus
+  uint32_t bus_nacks{0};
+  uint32_t bus_busy{0};
+  uint32_t tx_confirmed{0};
+  uint32_t tx_failed{0};            // L_DATA.con negative
+  uint32_t tx_timed_out{0};
+  uint32_t tx_suppressed{0};        // Writes dropped by the group object send policy
+  uint32_t tpuart_resets{0};
+  uint32_t rx_overflows{0};         // UART receive buffer or receive ring full, telegrams lost
+  uint32_t rx_budget_exhausted{0};  // loop() ran out of receive budget before the transport was drained
+  uint32_t routed_to_ip{0};         // ROUTING_INDICATIONs sent for frames on the line
+  uint32_t routed_to_tp{0};         // ROUTING_INDICATIONs queued for the line
+  uint32_t routing_lost{0};         // Dropped because a routing queue was full
+  uint32_t max_loop_time_us{0};     // Since the last take_max_loop_time_us()
+};
+
+struct KnxRxRecent {
+  uint32_t hash;
+  uint32_t received_ms;
+};
+
+struct KnxGroupHandler {
+  KnxCommandType command;
+  Trigger<KnxTelegram *> *trigger;
+};
+
+// Text argument that binds to string literals, String and std::string without copying or allocating
+class KnxText {
+  public:
+    KnxText(const char *text) : text_(text) {}
+    KnxText(const String &text) : text_(text.c_str()) {}
+    KnxText(const std::string &text) : text_(text.c_str()) {}
+    const char *c_str() const { return this->text_; }
+
+  protected:
+    const char *text_;
 };
 
 // Needed for lambda expression
 class KnxComponent;
+class KnxIpRouter;
 using lambda_writer_t = std::function<void(KnxComponent &)>;
 
-class KnxComponent : public Component, public uart::UARTDevice {
+class KnxComponent : public Component {
   
   public:
-    KnxComponent(uart::UARTComponent *uart) : uart::UARTDevice(uart) {
-      _listen_group_address_count = 0;
-    };
     void loop() override;
     void setup() override;
     void dump_config() override;
-    void set_use_address(const std::string &use_address);
+    void on_shutdown() override { this->transport_->on_shutdown(); }
     void set_serial_timeout(const uint32_t &serial_timeout);
+    // Time loop() may spend receiving and dispatching frames before it leaves the rest for the next iteration
+    void set_receive_budget(uint32_t budget_us) { this->receive_budget_us_ = budget_us; }
+    // TPUART or KNXnet/IP tunnel, set once before setup()
+    void set_transport(KnxTransport *transport);
+#ifdef USE_KNX_ROUTING
+    // Bridges the line to KNXnet/IP routing multicast, set once before setup()
+    void set_router(KnxIpRouter *router);
+#endif
 
-    // KNXTpUART - adapted
-    void uart_reset();
-    void uart_state_request();
     KnxComponentserial_eventType serial_event();
     KnxTelegram* get_received_telegram();
 
     void set_individual_address(int, int, int);
+    uint16_t get_individual_address() { return (this->_source_area << 12) | (this->_source_line << 8) | this->_source_member; }
+
+    // Called by the transport: whether a frame with this header (control fields and both addresses) is for us,
+    // each complete frame, and the outcome of the telegram passed to KnxTransport::send()
+    bool accepts_frame(const uint8_t *header);
+    KnxComponentserial_eventType receive_frame(const uint8_t *frame, int length, bool interested, uint32_t timestamp_us);
+    void tx_complete(KnxTxState);
+#ifdef USE_KNX_ROUTING
+    // Called by the router for each indication it takes from IP
+    void receive_routed(KnxTelegram *telegram);
+#endif
 
-    void send_ack();
-    void send_not_addressed();
-
-    bool group_write_bool(String, bool);
-    bool group_write_4bit_int(String, int);
-    bool group_write_4Bit_dim(String, bool, uint8_t);
-    bool group_write_1byte_int(String, int);
-    bool group_write_2byte_int(String, int);
-    bool group_write_2byte_float(String, float);
-    bool group_write_3byte_time(String, int, int, int, int);
-    bool group_write_3byte_date(String, int, int, int);
-    bool group_write_4byte_float(String, float);
-    bool group_write_14byte_text(String, String);
-
-    bool group_answer_bool(String, bool);
+    KnxTxHandle group_write_bool(KnxGroupAddress, bool);
+    KnxTxHandle group_write_bool(KnxText, bool);
+    KnxTxHandle group_write_4bit_int(KnxGroupAddress, int);
+    KnxTxHandle group_write_4bit_int(KnxText, int);
+    KnxTxHandle group_write_4Bit_dim(KnxGroupAddress, bool, uint8_t);
+    KnxTxHandle group_write_4Bit_dim(KnxText, bool, uint8_t);
+    KnxTxHandle group_write_1byte_int(KnxGroupAddress, int);
+    KnxTxHandle group_write_1byte_int(KnxText, int);
+    KnxTxHandle group_write_2byte_int(KnxGroupAddress, int);
+    KnxTxHandle group_write_2byte_int(KnxText, int);
+    KnxTxHandle group_write_2byte_float(KnxGroupAddress, float);
+    KnxTxHandle group_write_2byte_float(KnxText, float);
+    KnxTxHandle group_write_3byte_time(KnxGroupAddress, int, int, int, int);
+    KnxTxHandle group_write_3byte_time(KnxText, int, int, int, int);
+    KnxTxHandle group_write_3byte_date(KnxGroupAddress, int, int, int);
+    KnxTxHandle group_write_3byte_date(KnxText, int, int, int);
+    KnxTxHandle group_write_4byte_float(KnxGroupAddress, float);
+    KnxTxHandle group_write_4byte_float(KnxText, float);
+    KnxTxHandle group_write_14byte_text(KnxGroupAddress, KnxText);
+    KnxTxHandle group_write_14byte_text(KnxText, KnxText);
+
+    KnxTxHandle group_answer_bool(KnxGroupAddress, bool);
+    KnxTxHandle group_answer_bool(KnxText, bool);
     /*
-      bool group_answer_4bit_int(String, int);
-      bool group_answer_4bit_dim(String, bool, uint8_t);
+      KnxTxHandle group_answer_4bit_int(KnxText, int);
+      KnxTxHandle group_answer_4bit_dim(KnxText, bool, uint8_t);
     */
-    bool group_answer_1byte_int(String, int);
-    bool group_answer_2byte_int(String, int);
-    bool group_answer_2byte_float(String, float);
-    bool group_answer_3byte_time(String, int, int, int, int);
-    bool group_answer_3byte_date(String, int, int, int);
-    bool group_answer_4byte_float(String, float);
-    bool group_answer_14byte_text(String, String);
+    KnxTxHandle group_answer_1byte_int(KnxGroupAddress, int);
+    KnxTxHandle group_answer_1byte_int(KnxText, int);
+    KnxTxHandle group_answer_2byte_int(KnxGroupAddress, int);
+    KnxTxHandle group_answer_2byte_int(KnxText, int);
+    KnxTxHandle group_answer_2byte_float(KnxGroupAddress, float);
+    KnxTxHandle group_answer_2byte_float(KnxText, float);
+    KnxTxHandle group_answer_3byte_time(KnxGroupAddress, int, int, int, int);
+    KnxTxHandle group_answer_3byte_time(KnxText, int, int, int, int);
+    KnxTxHandle group_answer_3byte_date(KnxGroupAddress, int, int, int);
+    KnxTxHandle group_answer_3byte_date(KnxText, int, int, int);
+    KnxTxHandle group_answer_4byte_float(KnxGroupAddress, float);
+    KnxTxHandle group_answer_4byte_float(KnxText, float);
+    KnxTxHandle group_answer_14byte_text(KnxGroupAddress, KnxText);
+    KnxTxHandle group_answer_14byte_text(KnxText, KnxText);
+
+    // Generic datapoint access, e.g. group_write<knx::Dpt<9>>("1/2/3", 21.5f).
+    // Telegrams sent with a higher priority are written to the bus before queued normal ones;
+    // without a priority the one configured for the group object is used, KNX_PRIORITY_NORMAL for other addresses.
+    template<typename D> KnxTxHandle group_write(KnxGroupAddress address, const typename D::value_type &value,
+                                                 optional<KnxPriorityType> priority = {}) {
+      return this->group_send<D>(KNX_COMMAND_WRITE, address, value, priority);
+    }
+    template<typename D> KnxTxHandle group_write(KnxText address, const typename D::value_type &value,
+                                                 optional<KnxPriorityType> priority = {}) {
+      KnxGroupAddress groupAddress;
+      if (!this->parse_group_address(address, &groupAddress)) {
+        return KNX_TX_INVALID_HANDLE;
+      }
+      return this->group_write<D>(groupAddress, value, priority);
+    }
+    template<typename D> KnxTxHandle group_answer(KnxGroupAddress address, const typename D::value_type &value,
+                                                  optional<KnxPriorityType> priority = {}) {
+      return this->group_send<D>(KNX_COMMAND_ANSWER, address, value, priority);
+    }
+    template<typename D> KnxTxHandle group_answer(KnxText address, const typename D::value_type &value,
+                                                  optional<KnxPriorityType> priority = {}) {
+      KnxGroupAddress groupAddress;
+      if (!this->parse_group_address(address, &groupAddress)) {
+        return KNX_TX_INVALID_HANDLE;
+      }
+      return this->group_answer<D>(groupAddress, value, priority);
+    }
 
-    bool group_read(String);
+    // Raw data after the APCI, sent as an extended frame when it does not fit a standard one
+    KnxTxHandle group_write_data(KnxGroupAddress, const uint8_t *, int);
+    // Queues a fully built telegram, standard or extended
+    KnxTxHandle send_telegram(KnxTelegram*);
 
-    void add_listen_group_address(String);
+    KnxTxHandle group_read(KnxGroupAddress);
+    KnxTxHandle group_read(KnxText);
+
+    void add_listen_group_address(KnxGroupAddress);
+    void add_listen_group_address(KnxText);
     bool is_listening_to_group_address(int, int, int);
+    bool is_listening_to_group_address(KnxGroupAddress address) { return this->_listen_group_addresses.contains(address.raw()); }
 
-    bool individual_answer_address();
-    bool individual_answer_mask_version(int, int, int);
-    bool individual_answer_auth(int, int, int, int, int);
+    KnxTxHandle individual_answer_address();
+    KnxTxHandle individual_answer_mask_version(int, int, int);
+    KnxTxHandle individual_answer_auth(int, int, int, int, int);
 
     void set_listen_to_broadcasts(bool);
+
+    // Repeated or duplicated frames that were acknowledged but not dispatched
+    uint32_t get_duplicate_count() { return this->metrics_.rx_duplicates; }
+    const KnxMetrics &get_metrics() { return this->metrics_; }
+    uint32_t take_max_loop_time_us() {
+      uint32_t max = this->metrics_.max_loop_time_us;
+      this->metrics_.max_loop_time_us = 0;
+      return max;
+    }
+
+    // Bus monitor: load and top talkers over all frames on the line, logged every interval_ms
+    void enable_bus_monitor(uint32_t interval_ms, int top);
+    KnxBusMonitor *get_bus_monitor() { return this->bus_monitor_; }
+    // Bus capture: the last size frames received or sent, with timestamp and ACK result
+    void enable_capture(uint16_t size);
+    KnxBusCapture *get_capture() { return this->capture_; }
+    // Logs the captured frames as an ETS bus monitor trace, one line per frame
+    void dump_capture();
+
+    // Transmit queue
+    KnxTxState get_tx_state(KnxTxHandle);
+    uint8_t get_tx_queue_depth() { return this->tx_count_; }
+    void add_on_tx_complete_callback(std::function<void(KnxTxHandle, KnxTxState)> &&callback) {
+      this->tx_complete_callback_.add(std::move(callback));
+    }
+    // Per group address dispatch, the lambda only runs for telegrams no handler took
+    void add_group_handler(KnxGroupAddress, KnxCommandType, Trigger<KnxTelegram *> *);
+    // Group object cache: READs for these addresses are answered from the last known value
+    void add_group_object(KnxGroupAddress, uint16_t dpt, uint8_t length, KnxPriorityType priority = KNX_PRIORITY_NORMAL);
+    // Writes to a group object are coalesced while queued, spaced by min_interval_ms and,
+    // for numeric datapoints, skipped when they differ less than send_on_delta from the last one sent
+    void set_send_policy(KnxGroupAddress, uint32_t min_interval_ms, float send_on_delta);
+    uint32_t get_suppressed_count() { return this->metrics_.tx_suppressed; }
+    template<typename D> optional<typename D::value_type> get_cached(KnxGroupAddress address) {
+      auto it = this->group_objects_.find(address.raw());
+      if (it == this->group_objects_.end() || !it->second.valid || it->second.length != D::length) {
+        return {};
+      }
+      return D::decode(it->second.value);
+    }
+    template<typename D> optional<typename D::value_type> get_cached(KnxText address) {
+      KnxGroupAddress groupAddress;
+      if (!this->parse_group_address(address, &groupAddress)) {
+        return {};
+      }
+      return this->get_cached<D>(groupAddress);
+    }
     // Needed for lambda expression
     void set_lambda_writer(lambda_writer_t &&writer) { this->lambda_writer_ = writer; };
 
 
   protected:
-    std::string use_address_;
     uint32_t serial_timeout_;
+    uint32_t receive_budget_us_{2000};
     // KNXTpUART - adapted
-    KnxTelegram* _tg;       // for normal communication
-    KnxTelegram* _tg_ptp;   // for PTP sequence confirmation
+    // Telegrams are built in place and copied into a transmit slot, received ones have their own storage,
+    // so sending from a handler does not overwrite the telegram it is handling
+    KnxStandardTelegram tx_build_;
+    KnxStandardTelegram tx_build_ptp_;
+    KnxTelegram* _tg{&tx_build_};         // for normal communication
+    KnxTelegram* _tg_ptp{&tx_build_ptp_}; // for PTP sequence confirmation
     int _source_area;
     int _source_line;
     int _source_member;
-    int _listen_group_addresses[MAX_LISTEN_GROUP_ADDRESSES][3];
-    int _listen_group_address_count;
+    KnxGroupFilter _listen_group_addresses;
     bool _listen_to_broadcasts;
 
-    bool is_knx_control_byte(int);
-    void check_errors();
-    void print_byte(int);
+    KnxTransport *transport_{nullptr};
+    KnxIpRouter *router_{nullptr};
+
+    KnxStandardTelegram rx_standard_;
+    KnxExtendedTelegram rx_extended_;
+    KnxTelegram* _rx_tg{&rx_standard_};  // last received telegram, rx_standard_ or rx_extended_
+    bool rx_interested_{false};         // Accepted by accepts_frame() and acknowledged
+    uint32_t rx_timestamp_us_{0};
+    KnxRxRecent rx_recent_[KNX_RX_DEDUP_SIZE]{};
+    uint8_t rx_recent_next_{0};
+
+    // Transmit slots, drained from loop() one telegram at a time through the per priority FIFOs
+    KnxTxEntry tx_queue_[KNX_TX_QUEUE_SIZE];
+    uint8_t tx_level_slots_[KNX_TX_PRIORITY_LEVELS][KNX_TX_QUEUE_SIZE];
+    uint8_t tx_level_head_[KNX_TX_PRIORITY_LEVELS]{};
+    uint8_t tx_level_count_[KNX_TX_PRIORITY_LEVELS]{};
+    uint8_t tx_level_skipped_[KNX_TX_PRIORITY_LEVELS]{};
+    uint8_t tx_count_{0};         // Slots queued or sent
+    int8_t tx_current_{-1};       // Slot handed to the transport, waiting for L_DATA.con
+    KnxTxHandle tx_next_handle_{1};
+    KnxExtendedTelegram tx_extended_;
+    bool tx_extended_busy_{false};
+    uint32_t tx_sent_ms_{0};
+    uint32_t tx_sent_us_{0};
+    CallbackManager<void(KnxTxHandle, KnxTxState)> tx_complete_callback_;
+
     bool read_knx_telegram();
-    void create_knx_message_frame(int, KnxCommandType, String, int);
-    void create_knx_message_frame_individual(int, KnxCommandType, String, int);
-    bool send_message();
-    bool send_ncd_pos_confirm(int, int, int, int);
-    int serial_read();
+    bool is_duplicate_telegram(KnxTelegram*);
+    void create_knx_message_frame(int, KnxCommandType, KnxGroupAddress, int);
+    void create_knx_message_frame_individual(int, KnxCommandType, int, int, int, int);
+    bool parse_group_address(KnxText, KnxGroupAddress *);
+    template<typename D> KnxTxHandle group_send(KnxCommandType command, KnxGroupAddress address, const typename D::value_type &value,
+                                                optional<KnxPriorityType> priority) {
+      KnxGroupObject *found = this->find_group_object(address);
+      if (!priority.has_value()) {
+        priority = found != nullptr ? found->priority : KNX_PRIORITY_NORMAL;
+      }
+      // The send policy only applies to writes
+      KnxGroupObject *object = command == KNX_COMMAND_WRITE ? found : nullptr;
+      using T = typename D::value_type;
+      if constexpr (std::is_arithmetic<T>::value && !std::is_same<T, bool>::value) {
+        if (object != nullptr && object->send_on_delta > 0 && object->sent && object->length == D::length) {
+          // Compared with the value that goes out next, a held back one if there is one
+          auto last = D::decode(object->deferred ? object->deferred_value : object->sent_value);
+          if (last.has_value() && fabsf((float) value - (float) *last) < object->send_on_delta) {
+            object->suppressed++;
+            this->metrics_.tx_suppressed++;
+            return KNX_TX_INVALID_HANDLE;
+          }
+        }
+      }
+      this->create_knx_message_frame(2, command, address, 0);
+      this->_tg->set<D>(value);
+      this->_tg->set_priority(*priority);
+      this->_tg->create_checksum();
+      if (object != nullptr) {
+        return this->send_group_object_write(object, this->_tg);
+      }
+      return this->send_message();
+    }
+    KnxTxHandle send_message();
+    KnxTxHandle queue_telegram(KnxTelegram*, KnxTxHandle);
+    KnxTxHandle next_tx_handle();
+    KnxTxHandle send_ncd_pos_confirm(int, int, int, int);
+    void process_tx_queue();
+    int next_tx_level();
+    void tx_level_remove(int, int);
     optional<lambda_writer_t> lambda_writer_{};
+    std::unordered_map<uint16_t, std::vector<KnxGroupHandler>> group_handlers_;
+
+    std::unordered_map<uint16_t, KnxGroupObject> group_objects_;
+
+    bool dispatch_group_telegram(KnxTelegram*);
+    void dispatch_received_telegram();
+    void update_group_object(KnxTelegram*);
+    KnxGroupObject *find_group_object(KnxGroupAddress);
+    KnxTxHandle send_group_object_write(KnxGroupObject*, KnxTelegram*);
+    KnxTxHandle enqueue_group_object_write(KnxGroupObject*, KnxTelegram*, KnxTxHandle);
+    void flush_deferred_writes();
+    KnxTxEntry *find_tx_entry(KnxTxHandle);
+    uint16_t deferred_count_{0};
+    KnxMetrics metrics_;
+    KnxBusMonitor *bus_monitor_{nullptr};
+    uint32_t bus_monitor_interval_{0};
+    int bus_monitor_top_{0};
+    void report_bus_monitor();
+    KnxBusCapture *capture_{nullptr};
+    void capture_frame(KnxTelegram *telegram, uint32_t timestamp_us, KnxCaptureResult result) {
+      if (this->capture_ != nullptr) {
+        this->capture_->record(telegram->data(), telegram->get_total_length(), timestamp_us, result);
+      }
+    }
 
 };
 }  // namespace knx
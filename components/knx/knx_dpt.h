@@ -0,0 +1,322 @@
+// File: knx_dpt.h
+// Author: Dulgheru Mihaita (Since 2022)
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <string>
+
+namespace esphome {
+namespace knx {
+
+// Datapoint type codecs.
+//
+// Every Dpt<Major, Minor> specialisation provides
+//   value_type                       C++ type of the datapoint
+//   length                           octets following the APCI octet, 0 if the value fits in its 6 low bits
+//   encode(value, data)              writes data[0] (low 6 bits only) and data[1..length]
+//   decode(data) -> optional<value>  reads the same layout, empty if the octets are not a valid value
+// data[0] is the APCI octet, the caller takes care of the APCI bits and of the payload length.
+// A sub-type without a specialisation of its own (9.001, 5.010, ...) uses the codec of its main type.
+
+template<int Major, int Minor = 0> struct Dpt : Dpt<Major, 0> {};
+
+struct KnxControlled {
+  bool control;  // false = no control, the device decides
+  bool value;
+};
+
+struct KnxDimStep {
+  bool increase;
+  uint8_t steps;  // 0 = stop, 1..7 = step code
+};
+
+struct KnxTimeOfDay {
+  uint8_t weekday;  // 0 = no day, 1 = Monday .. 7 = Sunday
+  uint8_t hour;
+  uint8_t minute;
+  uint8_t second;
+};
+
+struct KnxDate {
+  uint8_t day;
+  uint8_t month;
+  uint16_t year;  // 1990 .. 2089
+};
+
+struct KnxSceneControl {
+  bool learn;
+  uint8_t scene;  // 0 .. 63
+};
+
+struct KnxRgb {
+  uint8_t red;
+  uint8_t green;
+  uint8_t blue;
+};
+
+// DPT 1.xxx - 1 bit (switch, bool, ...)
+template<> struct Dpt<1> {
+  using value_type = bool;
+  static constexpr uint8_t length = 0;
+  static constexpr void encode(value_type value, uint8_t *data) { data[0] = value ? 1 : 0; }
+  static constexpr std::optional<value_type> decode(const uint8_t *data) { return (data[0] & 0b00000001) != 0; }
+};
+
+// DPT 2.xxx - 1 bit controlled (priority switching)
+template<> struct Dpt<2> {
+  using value_type = KnxControlled;
+  static constexpr uint8_t length = 0;
+  static constexpr void encode(value_type value, uint8_t *data) {
+    data[0] = (value.control ? 0b00000010 : 0) | (value.value ? 0b00000001 : 0);
+  }
+  static constexpr std::optional<value_type> decode(const uint8_t *data) {
+    return KnxControlled{(data[0] & 0b00000010) != 0, (data[0] & 0b00000001) != 0};
+  }
+};
+
+// DPT 3.xxx - 3 bit controlled (dimming, blinds)
+template<> struct Dpt<3> {
+  using value_type = KnxDimStep;
+  static constexpr uint8_t length = 0;
+  static constexpr void encode(value_type value, uint8_t *data) {
+    data[0] = (value.increase ? 0b00001000 : 0) | (value.steps & 0b00000111);
+  }
+  static constexpr std::optional<value_type> decode(const uint8_t *data) {
+    return KnxDimStep{(data[0] & 0b00001000) != 0, (uint8_t) (data[0] & 0b00000111)};
+  }
+};
+
+// DPT 5.xxx - 8 bit unsigned
+template<> struct Dpt<5> {
+  using value_type = uint8_t;
+  static constexpr uint8_t length = 1;
+  static constexpr void encode(value_type value, uint8_t *data) { data[1] = value; }
+  static constexpr std::optional<value_type> decode(const uint8_t *data) { return data[1]; }
+};
+
+// DPT 5.001 - percentage 0..100 % scaled to 0..255
+template<> struct Dpt<5, 1> {
+  using value_type = float;
+  static constexpr uint8_t length = 1;
+  static constexpr void encode(value_type value, uint8_t *data) {
+    float scaled = value * 255.0f / 100.0f + 0.5f;
+    data[1] = scaled <= 0.0f ? 0 : (scaled >= 255.0f ? 255 : (uint8_t) scaled);
+  }
+  static constexpr std::optional<value_type> decode(const uint8_t *data) { return data[1] * 100.0f / 255.0f; }
+};
+
+// DPT 6.xxx - 8 bit signed
+template<> struct Dpt<6> {
+  using value_type = int8_t;
+  static constexpr uint8_t length = 1;
+  static constexpr void encode(value_type value, uint8_t *data) { data[1] = (uint8_t) value; }
+  static constexpr std::optional<value_type> decode(const uint8_t *data) { return (int8_t) data[1]; }
+};
+
+// DPT 7.xxx - 16 bit unsigned
+template<> struct Dpt<7> {
+  using value_type = uint16_t;
+  static constexpr uint8_t length = 2;
+  static constexpr void encode(value_type value, uint8_t *data) {
+    data[1] = value >> 8;
+    data[2] = value & 0xFF;
+  }
+  static constexpr std::optional<value_type> decode(const uint8_t *data) {
+    return (uint16_t) ((data[1] << 8) | data[2]);
+  }
+};
+
+// DPT 8.xxx - 16 bit signed
+template<> struct Dpt<8> {
+  using value_type = int16_t;
+  static constexpr uint8_t length = 2;
+  static constexpr void encode(value_type value, uint8_t *data) { Dpt<7>::encode((uint16_t) value, data); }
+  static constexpr std::optional<value_type> decode(const uint8_t *data) {
+    return (int16_t) ((data[1] << 8) | data[2]);
+  }
+};
+
+// DPT 9.xxx - 16 bit float: sign, 4 bit exponent, 11 bit mantissa, resolution 0.01
+template<> struct Dpt<9> {
+  using value_type = float;
+  static constexpr uint8_t length = 2;
+  static constexpr void encode(value_type value, uint8_t *data) {
+    float v = value * 100.0f;
+    int exponent = 0;
+    int mantissa = (int) (v < 0.0f ? v - 0.5f : v + 0.5f);
+    while ((mantissa < -2048 || mantissa > 2047) && exponent < 15) {
+      exponent++;
+      v /= 2.0f;
+      mantissa = (int) (v < 0.0f ? v - 0.5f : v + 0.5f);
+    }
+    // Out of range, saturate. 0x7FFF is reserved for invalid data
+    if (exponent == 15) {
+      if (mantissa > 2046) {
+        mantissa = 2046;
+      }
+      if (mantissa < -2048) {
+        mantissa = -2048;
+      }
+    }
+    data[1] = (mantissa < 0 ? 0b10000000 : 0) | (exponent << 3) | ((mantissa >> 8) & 0b00000111);
+    data[2] = mantissa & 0xFF;
+  }
+  static constexpr std::optional<value_type> decode(const uint8_t *data) {
+    if (data[1] == 0x7F && data[2] == 0xFF) {
+      // Invalid data
+      return {};
+    }
+    int exponent = (data[1] & 0b01111000) >> 3;
+    int mantissa = ((data[1] & 0b00000111) << 8) | data[2];
+    if (data[1] & 0b10000000) {
+      mantissa -= 2048;
+    }
+    return mantissa * 0.01f * (float) (1 << exponent);
+  }
+};
+
+// DPT 10.001 - time of day
+template<> struct Dpt<10> {
+  using value_type = KnxTimeOfDay;
+  static constexpr uint8_t length = 3;
+  static constexpr void encode(value_type value, uint8_t *data) {
+    data[1] = ((value.weekday << 5) & 0b11100000) | (value.hour & 0b00011111);
+    data[2] = value.minute & 0b00111111;
+    data[3] = value.second & 0b00111111;
+  }
+  static constexpr std::optional<value_type> decode(const uint8_t *data) {
+    KnxTimeOfDay time{(uint8_t) (data[1] >> 5), (uint8_t) (data[1] & 0b00011111), (uint8_t) (data[2] & 0b00111111),
+                      (uint8_t) (data[3] & 0b00111111)};
+    if (time.hour > 23 || time.minute > 59 || time.second > 59) {
+      return {};
+    }
+    return time;
+  }
+};
+
+// DPT 11.001 - date, the year travels as 0..99 (>= 90 is 19xx)
+template<> struct Dpt<11> {
+  using value_type = KnxDate;
+  static constexpr uint8_t length = 3;
+  static constexpr void encode(value_type value, uint8_t *data) {
+    data[1] = value.day & 0b00011111;
+    data[2] = value.month & 0b00001111;
+    data[3] = (value.year >= 2000 ? value.year - 2000 : (value.year >= 1900 ? value.year - 1900 : value.year)) & 0b01111111;
+  }
+  static constexpr std::optional<value_type> decode(const uint8_t *data) {
+    uint8_t year = data[3] & 0b01111111;
+    KnxDate date{(uint8_t) (data[1] & 0b00011111), (uint8_t) (data[2] & 0b00001111),
+                 (uint16_t) (year >= 90 ? 1900 + year : 2000 + year)};
+    if (date.day == 0 || date.month == 0 || date.month > 12 || year > 99) {
+      return {};
+    }
+    return date;
+  }
+};
+
+// DPT 12.xxx - 32 bit unsigned
+template<> struct Dpt<12> {
+  using value_type = uint32_t;
+  static constexpr uint8_t length = 4;
+  static constexpr void encode(value_type value, uint8_t *data) {
+    data[1] = value >> 24;
+    data[2] = (value >> 16) & 0xFF;
+    data[3] = (value >> 8) & 0xFF;
+    data[4] = value & 0xFF;
+  }
+  static constexpr std::optional<value_type> decode(const uint8_t *data) {
+    return ((uint32_t) data[1] << 24) | ((uint32_t) data[2] << 16) | ((uint32_t) data[3] << 8) | data[4];
+  }
+};
+
+// DPT 13.xxx - 32 bit signed
+template<> struct Dpt<13> {
+  using value_type = int32_t;
+  static constexpr uint8_t length = 4;
+  static constexpr void encode(value_type value, uint8_t *data) { Dpt<12>::encode((uint32_t) value, data); }
+  static constexpr std::optional<value_type> decode(const uint8_t *data) {
+    return (int32_t) *Dpt<12>::decode(data);
+  }
+};
+
+// DPT 14.xxx - 32 bit IEEE 754 float, big endian (not constexpr, needs a bit cast)
+template<> struct Dpt<14> {
+  using value_type = float;
+  static constexpr uint8_t length = 4;
+  static void encode(value_type value, uint8_t *data) {
+    uint32_t raw = 0;
+    memcpy(&raw, &value, sizeof(raw));
+    Dpt<12>::encode(raw, data);
+  }
+  static std::optional<value_type> decode(const uint8_t *data) {
+    uint32_t raw = *Dpt<12>::decode(data);
+    float value = 0;
+    memcpy(&value, &raw, sizeof(value));
+    return value;
+  }
+};
+
+// DPT 16.xxx - 14 character string, padded with NUL (not constexpr, uses std::string)
+template<> struct Dpt<16> {
+  using value_type = std::string;
+  static constexpr uint8_t length = 14;
+  static void encode(const value_type &value, uint8_t *data) {
+    for (int i = 0; i < length; i++) {
+      data[1 + i] = i < (int) value.size() ? value[i] : 0;
+    }
+  }
+  static std::optional<value_type> decode(const uint8_t *data) {
+    const char *text = (const char *) data + 1;
+    return std::string(text, strnlen(text, length));
+  }
+};
+
+// DPT 17.001 - scene number 0..63
+template<> struct Dpt<17> {
+  using value_type = uint8_t;
+  static constexpr uint8_t length = 1;
+  static constexpr void encode(value_type value, uint8_t *data) { data[1] = value & 0b00111111; }
+  static constexpr std::optional<value_type> decode(const uint8_t *data) {
+    return (uint8_t) (data[1] & 0b00111111);
+  }
+};
+
+// DPT 18.001 - scene control, activate or learn a scene
+template<> struct Dpt<18> {
+  using value_type = KnxSceneControl;
+  static constexpr uint8_t length = 1;
+  static constexpr void encode(value_type value, uint8_t *data) {
+    data[1] = (value.learn ? 0b10000000 : 0) | (value.scene & 0b00111111);
+  }
+  static constexpr std::optional<value_type> decode(const uint8_t *data) {
+    return KnxSceneControl{(data[1] & 0b10000000) != 0, (uint8_t) (data[1] & 0b00111111)};
+  }
+};
+
+// DPT 20.xxx - 8 bit enumeration (HVAC mode, ...), the meaning depends on the minor number
+template<> struct Dpt<20> {
+  using value_type = uint8_t;
+  static constexpr uint8_t length = 1;
+  static constexpr void encode(value_type value, uint8_t *data) { data[1] = value; }
+  static constexpr std::optional<value_type> decode(const uint8_t *data) { return data[1]; }
+};
+
+// DPT 232.600 - RGB colour
+template<> struct Dpt<232> {
+  using value_type = KnxRgb;
+  static constexpr uint8_t length = 3;
+  static constexpr void encode(value_type value, uint8_t *data) {
+    data[1] = value.red;
+    data[2] = value.green;
+    data[3] = value.blue;
+  }
+  static constexpr std::optional<value_type> decode(const uint8_t *data) {
+    return KnxRgb{data[1], data[2], data[3]};
+  }
+};
+
+}  // namespace knx
+}  // namespace esphome
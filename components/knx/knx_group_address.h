@@ -0,0 +1,64 @@
+// File: knx_group_address.h
+// Author: Dulgheru Mihaita (Since 2022)
+
+#ifndef KnxGroupAddress_h
+#define KnxGroupAddress_h
+
+#include <stdint.h>
+
+// Three level group address (main/middle/sub) packed the way it travels on the bus:
+// 5 bits main group, 3 bits middle group, 8 bits sub group.
+class KnxGroupAddress {
+  public:
+    constexpr KnxGroupAddress() : raw_(0) {}
+    constexpr explicit KnxGroupAddress(uint16_t raw) : raw_(raw) {}
+    constexpr KnxGroupAddress(int main, int middle, int sub)
+        : raw_(((main & 0b00011111) << 11) | ((middle & 0b00000111) << 8) | (sub & 0xFF)) {}
+
+    constexpr uint16_t raw() const { return raw_; }
+    constexpr int main() const { return (raw_ >> 11) & 0b00011111; }
+    constexpr int middle() const { return (raw_ >> 8) & 0b00000111; }
+    constexpr int sub() const { return raw_ & 0xFF; }
+
+    constexpr bool operator==(const KnxGroupAddress &other) const { return raw_ == other.raw_; }
+    constexpr bool operator!=(const KnxGroupAddress &other) const { return raw_ != other.raw_; }
+
+    // Parses "main/middle/sub" without allocating. Returns false if the text is not a valid address.
+    static constexpr bool parse(const char *text, KnxGroupAddress *address) {
+      int parts[3] = {0, 0, 0};
+      int count = 0;
+      bool digits = false;
+      for (const char *c = text; ; c++) {
+        if (*c >= '0' && *c <= '9') {
+          parts[count] = parts[count] * 10 + (*c - '0');
+          if (parts[count] > 255) {
+            return false;
+          }
+          digits = true;
+        }
+        else if ((*c == '/' || *c == '\0') && digits) {
+          count++;
+          digits = false;
+          if (*c == '\0' || count == 3) {
+            if (*c != '\0' || count != 3) {
+              return false;
+            }
+            break;
+          }
+        }
+        else {
+          return false;
+        }
+      }
+      if (parts[0] > 31 || parts[1] > 7) {
+        return false;
+      }
+      *address = KnxGroupAddress(parts[0], parts[1], parts[2]);
+      return true;
+    }
+
+  private:
+    uint16_t raw_;
+};
+
+#endif
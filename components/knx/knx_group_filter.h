@@ -0,0 +1,69 @@
+// Author: Dulgheru Mihaita (Since 2022)
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace esphome {
+namespace knx {
+
+// Set of raw 16-bit group addresses with constant time lookup.
+// The address space is split by its high byte (main/middle group) into pages of 256 bits,
+// a page is only allocated once an address inside it is added.
+class KnxGroupFilter {
+  public:
+    void add(uint16_t address) {
+      uint8_t page = address >> 8;
+      if (this->page_index_[page] == 0) {
+        this->pages_.push_back({});
+        this->page_index_[page] = this->pages_.size();
+      }
+      uint32_t &word = this->pages_[this->page_index_[page] - 1].bits[(address & 0xFF) >> 5];
+      uint32_t mask = 1UL << (address & 0x1F);
+      if (!(word & mask)) {
+        word |= mask;
+        this->count_++;
+      }
+    }
+
+    bool contains(uint16_t address) const {
+      uint16_t page = this->page_index_[address >> 8];
+      if (page == 0) {
+        return false;
+      }
+      return this->pages_[page - 1].bits[(address & 0xFF) >> 5] & (1UL << (address & 0x1F));
+    }
+
+    size_t size() const { return this->count_; }
+
+    size_t memory_usage() const { return sizeof(this->page_index_) + this->pages_.size() * sizeof(Page); }
+
+    // Calls f(address) for every address in the filter, in ascending order
+    template<typename F> void for_each(F f) const {
+      for (int page = 0; page < 256; page++) {
+        if (this->page_index_[page] == 0) {
+          continue;
+        }
+        const Page &p = this->pages_[this->page_index_[page] - 1];
+        for (int bit = 0; bit < 256; bit++) {
+          if (p.bits[bit >> 5] & (1UL << (bit & 0x1F))) {
+            f((uint16_t) ((page << 8) | bit));
+          }
+        }
+      }
+    }
+
+  protected:
+    struct Page {
+      uint32_t bits[8];
+    };
+    // 1-based index into pages_, 0 = no address with this high byte
+    uint16_t page_index_[256]{};
+    std::vector<Page> pages_;
+    size_t count_{0};
+};
+
+}  // namespace knx
+}  // namespace esphome
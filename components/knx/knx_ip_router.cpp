@@ -0,0 +1,303 @@
+// Author: Dulgheru Mihaita (Since 2022)
+
+#include "knx_ip_router.h"
+#ifdef USE_KNX_ROUTING
+
+#include "esphome/core/log.h"
+#include "esphome/components/network/util.h"
+
+namespace esphome {
+namespace knx {
+
+  // Routing counter 7 is never decremented, 0 is not routed any further
+  static const int KNX_ROUTING_COUNTER_UNLIMITED = 7;
+
+  void KnxIpRouter::dump_config() {
+    ESP_LOGCONFIG(TAG, " Knx KNXnet/IP routing: %s:%u", this->address_.c_str(), this->port_);
+  }
+
+  bool KnxIpRouter::open_socket() {
+    // Multicast membership is IPv4 only
+    this->socket_ = socket::socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (this->socket_ == nullptr) {
+      ESP_LOGW(TAG, "Could not create the KNXnet/IP routing socket.");
+      return false;
+    }
+    this->socket_->setblocking(false);
+    int enable = 1;
+    this->socket_->setsockopt(SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+
+    memset(&this->group_, 0, sizeof(this->group_));
+    this->group_.sin_family = AF_INET;
+    this->group_.sin_port = htons(this->port_);
+    this->group_.sin_addr.s_addr = inet_addr(this->address_.c_str());
+    struct sockaddr_in local = this->group_;
+    local.sin_addr.s_addr = htonl(INADDR_ANY);
+    struct ip_mreq membership;
+    membership.imr_multiaddr.s_addr = this->group_.sin_addr.s_addr;
+    membership.imr_interface.s_addr = htonl(INADDR_ANY);
+    if (this->socket_->bind((struct sockaddr *) &local, sizeof(local)) != 0 ||
+        this->socket_->setsockopt(IPPROTO_IP, IP_ADD_MEMBERSHIP, &membership, sizeof(membership)) != 0) {
+      ESP_LOGW(TAG, "Could not join the KNXnet/IP routing group %s.", this->address_.c_str());
+      this->socket_ = nullptr;
+      return false;
+    }
+
+    // Multicast loop stays on for other KNXnet/IP devices on the same host, our own indications are
+    // recognised by the source port instead
+    this->tx_socket_ = socket::socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    local.sin_port = 0;
+    socklen_t length = sizeof(local);
+    if (this->tx_socket_ == nullptr || this->tx_socket_->bind((struct sockaddr *) &local, sizeof(local)) != 0 ||
+        this->tx_socket_->getsockname((struct sockaddr *) &local, &length) != 0) {
+      ESP_LOGW(TAG, "Could not create the KNXnet/IP routing socket.");
+      this->socket_ = nullptr;
+      this->tx_socket_ = nullptr;
+      return false;
+    }
+    this->tx_socket_->setblocking(false);
+    this->tx_port_ = ntohs(local.sin_port);
+    return true;
+  }
+
+  void KnxIpRouter::loop() {
+    if (this->socket_ == nullptr && (!network::is_connected() || !this->open_socket())) {
+      return;
+    }
+
+    uint8_t buffer[KNXNETIP_ROUTING_FRAME_SIZE];
+    struct sockaddr_in source;
+    socklen_t source_length = sizeof(source);
+    ssize_t length;
+    while ((length = this->socket_->recvfrom(buffer, sizeof(buffer), (struct sockaddr *) &source, &source_length)) > 0) {
+      if (ntohs(source.sin_port) != this->tx_port_) {
+        this->handle_datagram(buffer, length);
+      }
+      source_length = sizeof(source);
+    }
+
+    uint32_t now = millis();
+    if (this->busy_ && (int32_t) (now - this->busy_until_ms_) >= 0) {
+      this->busy_ = false;
+    }
+    if (!this->busy_) {
+      this->flush_ip_queue();
+    }
+    this->flush_tp_queue();
+    if (this->lost_ > 0 && now - this->lost_sent_ms_ >= KNX_ROUTER_LOST_INTERVAL_MS) {
+      this->send_lost();
+    }
+  }
+
+  void KnxIpRouter::route_to_ip(KnxTelegram *telegram, KnxTxHandle handle) {
+    if (this->socket_ == nullptr || !telegram->is_target_group() || !this->parent_->accepts_frame(telegram->data())) {
+      return;
+    }
+    if (this->is_pending(handle) || telegram->get_routing_counter() == 0) {
+      // Came from IP, or may not leave the line
+      return;
+    }
+    if (!this->busy_ && this->ip_count_ == 0) {
+      this->send_indication(telegram);
+      return;
+    }
+    // Held back in order until the busy wait time has passed, an extended frame in its own buffer
+    bool extended = telegram->get_total_length() > MAX_KNX_TELEGRAM_SIZE;
+    if (this->ip_count_ == KNX_ROUTER_IP_QUEUE_SIZE || (extended && this->ip_extended_slot_ >= 0)) {
+      this->metrics_->routing_lost++;
+      return;
+    }
+    int slot = (this->ip_head_ + this->ip_count_) % KNX_ROUTER_IP_QUEUE_SIZE;
+    if (extended) {
+      this->ip_extended_ = *telegram;
+      this->ip_extended_slot_ = slot;
+    }
+    else {
+      this->ip_queue_[slot] = *telegram;
+    }
+    this->ip_count_++;
+  }
+
+  void KnxIpRouter::flush_ip_queue() {
+    while (this->ip_count_ > 0) {
+      if (this->ip_head_ == this->ip_extended_slot_) {
+        this->send_indication(&this->ip_extended_);
+        this->ip_extended_slot_ = -1;
+      }
+      else {
+        this->send_indication(&this->ip_queue_[this->ip_head_]);
+      }
+      this->ip_head_ = (this->ip_head_ + 1) % KNX_ROUTER_IP_QUEUE_SIZE;
+      this->ip_count_--;
+    }
+  }
+
+  // Converted straight into the datagram, the telegram itself is left as it is
+  bool KnxIpRouter::send_indication(KnxTelegram *telegram) {
+    uint8_t frame[KNXNETIP_ROUTING_FRAME_SIZE];
+    uint8_t *cemi = frame + KNXNETIP_HEADER_SIZE;
+    int cemi_length = knx_tp_to_cemi(KNX_CEMI_L_DATA_IND, telegram->data(), telegram->get_total_length(), cemi);
+    if (cemi_length == 0) {
+      return false;
+    }
+    int counter = telegram->get_routing_counter();
+    if (counter != KNX_ROUTING_COUNTER_UNLIMITED) {
+      cemi[3] = (cemi[3] & 0b10001111) | ((counter - 1) << 4);
+    }
+    this->write_datagram(KNXNETIP_ROUTING_INDICATION, frame, KNXNETIP_HEADER_SIZE + cemi_length);
+    this->metrics_->routed_to_ip++;
+    return true;
+  }
+
+  void KnxIpRouter::flush_tp_queue() {
+    while (this->tp_count_ > 0 && this->send_to_tp(&this->tp_queue_[this->tp_head_])) {
+      this->tp_head_ = (this->tp_head_ + 1) % KNX_ROUTER_TP_QUEUE_SIZE;
+      this->tp_count_--;
+    }
+  }
+
+  // Only a few of our frames are in the transmit queue at a time, so local telegrams still get through
+  bool KnxIpRouter::send_to_tp(KnxTelegram *telegram) {
+    if (this->parent_->get_tx_queue_depth() >= KNX_TX_QUEUE_SIZE) {
+      return false;
+    }
+    for (int i = 0; i < KNX_ROUTER_TP_PENDING; i++) {
+      KnxTxState state = this->parent_->get_tx_state(this->tp_pending_[i]);
+      if (state == KNX_TX_QUEUED || state == KNX_TX_SENT) {
+        continue;
+      }
+      KnxTxHandle handle = this->parent_->send_telegram(telegram);
+      if (handle == KNX_TX_INVALID_HANDLE) {
+        return false;
+      }
+      this->tp_pending_[i] = handle;
+      this->metrics_->routed_to_tp++;
+      return true;
+    }
+    return false;
+  }
+
+  bool KnxIpRouter::is_pending(KnxTxHandle handle) {
+    if (handle == KNX_TX_INVALID_HANDLE) {
+      return false;
+    }
+    for (int i = 0; i < KNX_ROUTER_TP_PENDING; i++) {
+      if (this->tp_pending_[i] == handle) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  void KnxIpRouter::handle_datagram(const uint8_t *data, int length) {
+    if (length < KNXNETIP_HEADER_SIZE || data[0] != KNXNETIP_HEADER_SIZE || data[1] != KNXNETIP_VERSION_10) {
+      return;
+    }
+    uint16_t service = (data[2] << 8) | data[3];
+    int total = (data[4] << 8) | data[5];
+    const uint8_t *body = data + KNXNETIP_HEADER_SIZE;
+    int body_length = (total < length ? total : length) - KNXNETIP_HEADER_SIZE;
+    if (body_length < 2) {
+      return;
+    }
+
+    switch (service) {
+      case KNXNETIP_ROUTING_INDICATION:
+        this->handle_indication(body, body_length);
+        break;
+
+      case KNXNETIP_ROUTING_BUSY: {
+        // Device state, wait time and control field
+        if (body_length < 6) {
+          break;
+        }
+        uint16_t wait_ms = (body[2] << 8) | body[3];
+        uint32_t until = millis() + wait_ms;
+        if (!this->busy_ || (int32_t) (until - this->busy_until_ms_) > 0) {
+          this->busy_until_ms_ = until;
+        }
+        this->busy_ = true;
+        KNX_TRACE("ROUTING_BUSY, waiting %u ms", wait_ms);
+        break;
+      }
+
+      case KNXNETIP_ROUTING_LOST_MESSAGE:
+        if (body_length >= 4) {
+          ESP_LOGW(TAG, "KNXnet/IP router lost %u frames.", (body[2] << 8) | body[3]);
+        }
+        break;
+
+      default:
+        break;
+    }
+  }
+
+  void KnxIpRouter::handle_indication(const uint8_t *cemi, int length) {
+    if (cemi[0] != KNX_CEMI_L_DATA_IND) {
+      return;
+    }
+    KnxTelegram *telegram = &this->tp_extended_;
+    if (knx_cemi_to_tp(cemi, length, telegram->data(), telegram->get_capacity()) == 0) {
+      return;
+    }
+    if (!telegram->is_target_group() || !this->parent_->accepts_frame(telegram->data())) {
+      return;
+    }
+    int counter = telegram->get_routing_counter();
+    if (counter == 0) {
+      return;
+    }
+    if (counter != KNX_ROUTING_COUNTER_UNLIMITED) {
+      telegram->set_routing_counter(counter - 1);
+    }
+    telegram->create_checksum();
+    this->parent_->receive_routed(telegram);
+
+    if (telegram->get_total_length() > MAX_KNX_TELEGRAM_SIZE) {
+      // Too long for a queue slot, handed over right away through the single extended transmit buffer
+      if (this->tp_count_ == 0 && this->send_to_tp(telegram)) {
+        return;
+      }
+    }
+    else if (this->tp_count_ < KNX_ROUTER_TP_QUEUE_SIZE) {
+      this->tp_queue_[(this->tp_head_ + this->tp_count_) % KNX_ROUTER_TP_QUEUE_SIZE] = *telegram;
+      this->tp_count_++;
+      if (this->tp_count_ >= KNX_ROUTER_TP_BUSY_LEVEL && millis() - this->busy_sent_ms_ >= KNX_ROUTER_BUSY_WAIT_MS) {
+        this->send_busy();
+      }
+      return;
+    }
+    this->metrics_->routing_lost++;
+    this->lost_++;
+  }
+
+  void KnxIpRouter::send_busy() {
+    uint8_t frame[KNXNETIP_HEADER_SIZE + 6] = {};
+    uint8_t *body = frame + KNXNETIP_HEADER_SIZE;
+    body[0] = 6;
+    body[2] = KNX_ROUTER_BUSY_WAIT_MS >> 8;
+    body[3] = KNX_ROUTER_BUSY_WAIT_MS & 0xFF;
+    this->write_datagram(KNXNETIP_ROUTING_BUSY, frame, sizeof(frame));
+    this->busy_sent_ms_ = millis();
+  }
+
+  void KnxIpRouter::send_lost() {
+    uint8_t frame[KNXNETIP_HEADER_SIZE + 4] = {};
+    uint8_t *body = frame + KNXNETIP_HEADER_SIZE;
+    body[0] = 4;
+    body[2] = this->lost_ >> 8;
+    body[3] = this->lost_ & 0xFF;
+    this->write_datagram(KNXNETIP_ROUTING_LOST_MESSAGE, frame, sizeof(frame));
+    this->lost_ = 0;
+    this->lost_sent_ms_ = millis();
+  }
+
+  void KnxIpRouter::write_datagram(uint16_t service, uint8_t *frame, int length) {
+    knx_netip_header(frame, service, length);
+    this->tx_socket_->sendto(frame, length, 0, (struct sockaddr *) &this->group_, sizeof(this->group_));
+  }
+
+}  // namespace knx
+}  // namespace esphome
+
+#endif  // USE_KNX_ROUTING
@@ -0,0 +1,92 @@
+// Author: Dulgheru Mihaita (Since 2022)
+
+#pragma once
+
+#include "esphome/core/defines.h"
+#ifdef USE_KNX_ROUTING
+
+#include <memory>
+#include <string>
+#include "esphome/components/socket/socket.h"
+#include "knx_component.h"
+#include "knx_netip.h"
+
+namespace esphome {
+namespace knx {
+
+// Frames from the line that wait while the IP side is busy, one of them may be an extended frame
+inline constexpr int KNX_ROUTER_IP_QUEUE_SIZE = 8;
+// Frames from IP waiting for the transmit queue, and how many of them may be queued there at once
+inline constexpr int KNX_ROUTER_TP_QUEUE_SIZE = 8;
+inline constexpr int KNX_ROUTER_TP_PENDING = 4;
+// ROUTING_BUSY is sent once the queue to the line holds this many frames, at most every wait time
+inline constexpr int KNX_ROUTER_TP_BUSY_LEVEL = 6;
+inline constexpr uint16_t KNX_ROUTER_BUSY_WAIT_MS = 100;
+// ROUTING_LOST_MESSAGE reports frames dropped towards the line, at most this often
+inline constexpr uint32_t KNX_ROUTER_LOST_INTERVAL_MS = 1000;
+inline constexpr int KNXNETIP_ROUTING_FRAME_SIZE = KNXNETIP_HEADER_SIZE + KNX_CEMI_MAX_SIZE;
+
+// Bridges the TP line to KNXnet/IP routing multicast. Group telegrams for addresses in the listen filter
+// go out as ROUTING_INDICATIONs, indications for those addresses are dispatched locally and queued for the line.
+class KnxIpRouter {
+  public:
+    void set_parent(KnxComponent *parent, KnxMetrics *metrics) {
+      this->parent_ = parent;
+      this->metrics_ = metrics;
+    }
+    void set_multicast_address(const std::string &address, uint16_t port) {
+      this->address_ = address;
+      this->port_ = port;
+    }
+    void dump_config();
+    void loop();
+    // A frame received on, or confirmed by, the line. handle is the transmit handle of a confirmed frame.
+    void route_to_ip(KnxTelegram *telegram, KnxTxHandle handle = KNX_TX_INVALID_HANDLE);
+
+  protected:
+    KnxComponent *parent_{nullptr};
+    KnxMetrics *metrics_{nullptr};
+    std::string address_;
+    uint16_t port_{3671};
+    std::unique_ptr<socket::Socket> socket_;
+    // Indications go out from their own port, so they can be told apart when the group loops them back
+    std::unique_ptr<socket::Socket> tx_socket_;
+    uint16_t tx_port_{0};
+    struct sockaddr_in group_;
+
+    // Line to IP, used while a ROUTING_BUSY is in effect
+    uint32_t busy_until_ms_{0};
+    bool busy_{false};
+    KnxStandardTelegram ip_queue_[KNX_ROUTER_IP_QUEUE_SIZE];
+    uint8_t ip_head_{0};
+    uint8_t ip_count_{0};
+    KnxExtendedTelegram ip_extended_;
+    int8_t ip_extended_slot_{-1};  // Slot of ip_queue_ that stands for ip_extended_
+
+    // IP to line
+    KnxStandardTelegram tp_queue_[KNX_ROUTER_TP_QUEUE_SIZE];
+    uint8_t tp_head_{0};
+    uint8_t tp_count_{0};
+    KnxTxHandle tp_pending_[KNX_ROUTER_TP_PENDING]{};
+    KnxExtendedTelegram tp_extended_;
+    uint32_t busy_sent_ms_{0};
+    uint16_t lost_{0};             // Not yet reported with ROUTING_LOST_MESSAGE
+    uint32_t lost_sent_ms_{0};
+
+    bool open_socket();
+    bool send_indication(KnxTelegram *telegram);
+    void flush_ip_queue();
+    void flush_tp_queue();
+    bool send_to_tp(KnxTelegram *telegram);
+    bool is_pending(KnxTxHandle handle);
+    void handle_datagram(const uint8_t *data, int length);
+    void handle_indication(const uint8_t *cemi, int length);
+    void send_busy();
+    void send_lost();
+    void write_datagram(uint16_t service, uint8_t *frame, int length);
+};
+
+}  // namespace knx
+}  // namespace esphome
+
+#endif  // USE_KNX_ROUTING
@@ -0,0 +1,282 @@
+// Author: Dulgheru Mihaita (Since 2022)
+
+#include "knx_ip_tunnel_transport.h"
+#ifdef USE_KNX_TUNNEL
+
+#include "knx_component.h"
+#include "esphome/core/log.h"
+#include "esphome/components/network/util.h"
+
+namespace esphome {
+namespace knx {
+
+  // HPAI with address and port 0: the interface answers to where the request came from (NAT mode)
+  static const uint8_t KNXNETIP_HPAI_NAT[8] = {0x08, 0x01, 0, 0, 0, 0, 0, 0};
+  // CRI: tunnel connection on the link layer
+  static const uint8_t KNXNETIP_CRI_TUNNEL_LINK_LAYER[4] = {0x04, 0x04, 0x02, 0x00};
+
+  void KnxIpTunnelTransport::dump_config() {
+    ESP_LOGCONFIG(TAG, " Knx KNXnet/IP tunnel: %s:%u", this->host_.c_str(), this->port_);
+  }
+
+  void KnxIpTunnelTransport::on_shutdown() {
+    // Interfaces only have a few tunnels, free ours instead of waiting for it to time out
+    if (this->state_ == KNX_TUNNEL_CONNECTED) {
+      this->send_request(KNXNETIP_DISCONNECT_REQUEST, true);
+    }
+  }
+
+  bool KnxIpTunnelTransport::open_socket() {
+    this->socket_ = socket::socket_ip(SOCK_DGRAM, IPPROTO_UDP);
+    if (this->socket_ == nullptr) {
+      ESP_LOGW(TAG, "Could not create the KNXnet/IP socket.");
+      return false;
+    }
+    this->socket_->setblocking(false);
+    struct sockaddr_storage address;
+    socklen_t length = socket::set_sockaddr((struct sockaddr *) &address, sizeof(address), this->host_, this->port_);
+    if (length == 0 || this->socket_->connect((struct sockaddr *) &address, length) != 0) {
+      ESP_LOGW(TAG, "Could not open the KNXnet/IP socket to %s.", this->host_.c_str());
+      this->socket_ = nullptr;
+      return false;
+    }
+    return true;
+  }
+
+  KnxComponentserial_eventType KnxIpTunnelTransport::poll() {
+    if (this->socket_ == nullptr && (!network::is_connected() || !this->open_socket())) {
+      return UNKNOWN;
+    }
+
+    uint32_t now = millis();
+    if (this->state_ == KNX_TUNNEL_DISCONNECTED && (this->state_ms_ == 0 || now - this->state_ms_ > KNXNETIP_CONNECT_TIMEOUT_MS)) {
+      this->connect();
+    }
+    else if (this->state_ == KNX_TUNNEL_CONNECTING && now - this->state_ms_ > KNXNETIP_CONNECT_TIMEOUT_MS) {
+      ESP_LOGW(TAG, "No CONNECT_RESPONSE from %s.", this->host_.c_str());
+      this->connect();
+    }
+    else if (this->state_ == KNX_TUNNEL_CONNECTED) {
+      if (this->heartbeat_pending_ && now - this->heartbeat_ms_ > KNXNETIP_HEARTBEAT_TIMEOUT_MS) {
+        this->heartbeat_pending_ = false;
+        if (++this->heartbeat_failures_ >= KNXNETIP_HEARTBEAT_RETRIES) {
+          this->disconnect("no CONNECTIONSTATE_RESPONSE");
+          return UNKNOWN;
+        }
+        // Asked again right away
+        this->heartbeat_ms_ = now - KNXNETIP_HEARTBEAT_INTERVAL_MS;
+      }
+      if (!this->heartbeat_pending_ && now - this->heartbeat_ms_ >= KNXNETIP_HEARTBEAT_INTERVAL_MS) {
+        this->send_request(KNXNETIP_CONNECTIONSTATE_REQUEST, true);
+        this->heartbeat_pending_ = true;
+        this->heartbeat_ms_ = now;
+      }
+      if (this->tx_waiting_ack_ && now - this->tx_sent_ms_ > KNXNETIP_TUNNELING_ACK_TIMEOUT_MS) {
+        if (!this->tx_repeated_) {
+          // Repeated once with the same sequence counter
+          this->socket_->write(this->tx_buffer_, this->tx_length_);
+          this->tx_repeated_ = true;
+          this->tx_sent_ms_ = now;
+        }
+        else {
+          this->tx_waiting_ack_ = false;
+          this->component_->tx_complete(KNX_TX_NACKED);
+          this->disconnect("no TUNNELING_ACK");
+          return UNKNOWN;
+        }
+      }
+    }
+
+    uint8_t buffer[KNXNETIP_MAX_FRAME_SIZE];
+    ssize_t length;
+    while ((length = this->socket_->read(buffer, sizeof(buffer))) > 0) {
+      KnxComponentserial_eventType event = this->handle_frame(buffer, length);
+      if (event != UNKNOWN) {
+        return event;
+      }
+    }
+    return UNKNOWN;
+  }
+
+  void KnxIpTunnelTransport::connect() {
+    uint8_t body[sizeof(KNXNETIP_HPAI_NAT) * 2 + sizeof(KNXNETIP_CRI_TUNNEL_LINK_LAYER)];
+    memcpy(body, KNXNETIP_HPAI_NAT, sizeof(KNXNETIP_HPAI_NAT));
+    memcpy(body + sizeof(KNXNETIP_HPAI_NAT), KNXNETIP_HPAI_NAT, sizeof(KNXNETIP_HPAI_NAT));
+    memcpy(body + 2 * sizeof(KNXNETIP_HPAI_NAT), KNXNETIP_CRI_TUNNEL_LINK_LAYER, sizeof(KNXNETIP_CRI_TUNNEL_LINK_LAYER));
+    this->write_frame(KNXNETIP_CONNECT_REQUEST, body, sizeof(body));
+    this->state_ = KNX_TUNNEL_CONNECTING;
+    this->state_ms_ = millis();
+  }
+
+  void KnxIpTunnelTransport::disconnect(const char *reason) {
+    ESP_LOGW(TAG, "KNXnet/IP tunnel closed: %s.", reason);
+    if (this->state_ == KNX_TUNNEL_CONNECTED) {
+      this->send_request(KNXNETIP_DISCONNECT_REQUEST, true);
+    }
+    if (this->tx_waiting_ack_) {
+      this->tx_waiting_ack_ = false;
+      this->component_->tx_complete(KNX_TX_NACKED);
+    }
+    this->state_ = KNX_TUNNEL_DISCONNECTED;
+    this->state_ms_ = millis();
+  }
+
+  // CONNECTIONSTATE_REQUEST and DISCONNECT_REQUEST/RESPONSE: channel, reserved byte (or status) and our HPAI
+  void KnxIpTunnelTransport::send_request(uint16_t service, bool with_hpai) {
+    uint8_t body[2 + sizeof(KNXNETIP_HPAI_NAT)];
+    body[0] = this->channel_;
+    body[1] = 0;
+    memcpy(body + 2, KNXNETIP_HPAI_NAT, sizeof(KNXNETIP_HPAI_NAT));
+    this->write_frame(service, body, with_hpai ? sizeof(body) : 2);
+  }
+
+  void KnxIpTunnelTransport::write_frame(uint16_t service, const uint8_t *body, int length) {
+    uint8_t frame[KNXNETIP_HEADER_SIZE + 32];
+    int total = KNXNETIP_HEADER_SIZE + length;
+    knx_netip_header(frame, service, total);
+    memcpy(frame + KNXNETIP_HEADER_SIZE, body, length);
+    this->socket_->write(frame, total);
+  }
+
+  void KnxIpTunnelTransport::send(KnxTelegram *telegram) {
+    uint8_t *body = this->tx_buffer_ + KNXNETIP_HEADER_SIZE;
+    body[0] = KNXNETIP_CONNECTION_HEADER_SIZE;
+    body[1] = this->channel_;
+    body[2] = this->tx_sequence_;
+    body[3] = 0;
+    int cemi_length = knx_tp_to_cemi(KNX_CEMI_L_DATA_REQ, telegram->data(), telegram->get_total_length(),
+                                     body + KNXNETIP_CONNECTION_HEADER_SIZE);
+    if (cemi_length == 0) {
+      this->component_->tx_complete(KNX_TX_NACKED);
+      return;
+    }
+    this->tx_length_ = KNXNETIP_HEADER_SIZE + KNXNETIP_CONNECTION_HEADER_SIZE + cemi_length;
+    knx_netip_header(this->tx_buffer_, KNXNETIP_TUNNELING_REQUEST, this->tx_length_);
+    this->socket_->write(this->tx_buffer_, this->tx_length_);
+    this->tx_waiting_ack_ = true;
+    this->tx_repeated_ = false;
+    this->tx_sent_ms_ = millis();
+  }
+
+  KnxComponentserial_eventType KnxIpTunnelTransport::handle_frame(const uint8_t *data, int length) {
+    if (length < KNXNETIP_HEADER_SIZE || data[0] != KNXNETIP_HEADER_SIZE || data[1] != KNXNETIP_VERSION_10) {
+      return UNKNOWN;
+    }
+    uint16_t service = (data[2] << 8) | data[3];
+    int total = (data[4] << 8) | data[5];
+    const uint8_t *body = data + KNXNETIP_HEADER_SIZE;
+    int body_length = (total < length ? total : length) - KNXNETIP_HEADER_SIZE;
+    if (body_length < 2) {
+      return UNKNOWN;
+    }
+
+    switch (service) {
+      case KNXNETIP_CONNECT_RESPONSE:
+        if (this->state_ != KNX_TUNNEL_CONNECTING) {
+          break;
+        }
+        if (body[1] != 0) {
+          ESP_LOGW(TAG, "KNXnet/IP interface refused the tunnel, status 0x%02X.", body[1]);
+          this->state_ = KNX_TUNNEL_DISCONNECTED;
+          this->state_ms_ = millis();
+          break;
+        }
+        this->channel_ = body[0];
+        this->rx_sequence_ = 0;
+        this->tx_sequence_ = 0;
+        this->heartbeat_ms_ = millis();
+        this->heartbeat_pending_ = false;
+        this->heartbeat_failures_ = 0;
+        this->state_ = KNX_TUNNEL_CONNECTED;
+        // The CRD after the data endpoint HPAI carries the individual address the interface uses for us
+        if (body_length >= 2 + 8 + 4) {
+          ESP_LOGI(TAG, "KNXnet/IP tunnel connected, channel %u, address %u.%u.%u", this->channel_,
+            body[12] >> 4, body[12] & 0x0F, body[13]);
+        }
+        break;
+
+      case KNXNETIP_CONNECTIONSTATE_RESPONSE:
+        if (body[0] != this->channel_ || this->state_ != KNX_TUNNEL_CONNECTED) {
+          break;
+        }
+        this->heartbeat_pending_ = false;
+        if (body[1] == 0) {
+          this->heartbeat_failures_ = 0;
+        }
+        else {
+          this->disconnect("connection state error");
+        }
+        break;
+
+      case KNXNETIP_DISCONNECT_REQUEST:
+        if (body[0] == this->channel_ && this->state_ == KNX_TUNNEL_CONNECTED) {
+          this->send_request(KNXNETIP_DISCONNECT_RESPONSE, false);
+          this->state_ = KNX_TUNNEL_DISCONNECTED;  // Before disconnect(), no DISCONNECT_REQUEST back
+          this->disconnect("closed by the interface");
+        }
+        break;
+
+      case KNXNETIP_TUNNELING_ACK:
+        if (body_length < KNXNETIP_CONNECTION_HEADER_SIZE || body[1] != this->channel_ || !this->tx_waiting_ack_ ||
+            body[2] != this->tx_sequence_) {
+          break;
+        }
+        this->tx_waiting_ack_ = false;
+        this->tx_sequence_++;
+        if (body[3] != 0) {
+          this->component_->tx_complete(KNX_TX_NACKED);
+        }
+        break;
+
+      case KNXNETIP_TUNNELING_REQUEST: {
+        if (body_length < KNXNETIP_CONNECTION_HEADER_SIZE || body[1] != this->channel_ ||
+            this->state_ != KNX_TUNNEL_CONNECTED) {
+          break;
+        }
+        uint8_t sequence = body[2];
+        if (sequence != this->rx_sequence_ && sequence != (uint8_t) (this->rx_sequence_ - 1)) {
+          // Out of order, the interface repeats it
+          break;
+        }
+        uint8_t ack[KNXNETIP_CONNECTION_HEADER_SIZE] = {KNXNETIP_CONNECTION_HEADER_SIZE, this->channel_, sequence, 0};
+        this->write_frame(KNXNETIP_TUNNELING_ACK, ack, sizeof(ack));
+        if (sequence != this->rx_sequence_) {
+          // Repeated because our ACK got lost, already handled
+          break;
+        }
+        this->rx_sequence_++;
+        return this->handle_cemi(body + KNXNETIP_CONNECTION_HEADER_SIZE, body_length - KNXNETIP_CONNECTION_HEADER_SIZE);
+      }
+
+      default:
+        break;
+    }
+    return UNKNOWN;
+  }
+
+  KnxComponentserial_eventType KnxIpTunnelTransport::handle_cemi(const uint8_t *cemi, int length) {
+    if (length < KNX_CEMI_HEADER_SIZE + cemi[1]) {
+      return UNKNOWN;
+    }
+    if (cemi[0] == KNX_CEMI_L_DATA_CON) {
+      // Confirm bit set: the interface could not send the frame on its line
+      bool failed = cemi[2 + cemi[1]] & 0b00000001;
+      this->component_->tx_complete(failed ? KNX_TX_NACKED : KNX_TX_CONFIRMED);
+      return UNKNOWN;
+    }
+    if (cemi[0] != KNX_CEMI_L_DATA_IND) {
+      return UNKNOWN;
+    }
+    uint8_t *frame = this->rx_telegram_.data();
+    int frame_length = knx_cemi_to_tp(cemi, length, frame, this->rx_telegram_.get_capacity());
+    if (frame_length == 0) {
+      return UNKNOWN;
+    }
+    this->rx_telegram_.create_checksum();
+    return this->component_->receive_frame(frame, frame_length, this->component_->accepts_frame(frame), micros());
+  }
+
+}  // namespace knx
+}  // namespace esphome
+
+#endif  // USE_KNX_TUNNEL
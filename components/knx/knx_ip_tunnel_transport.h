@@ -0,0 +1,73 @@
+// Author: Dulgheru Mihaita (Since 2022)
+
+#pragma once
+
+#include "esphome/core/defines.h"
+#ifdef USE_KNX_TUNNEL
+
+#include <memory>
+#include <string>
+#include "esphome/components/socket/socket.h"
+#include "knx_transport.h"
+#include "knx_netip.h"
+
+namespace esphome {
+namespace knx {
+
+enum KnxTunnelState {
+  KNX_TUNNEL_DISCONNECTED,
+  KNX_TUNNEL_CONNECTING,   // CONNECT_REQUEST sent
+  KNX_TUNNEL_CONNECTED
+};
+
+// Link layer tunnel to a KNXnet/IP interface, cEMI over UDP. The interface acknowledges frames on its
+// own line, so every frame it forwards is handed to KnxComponent as it is.
+class KnxIpTunnelTransport : public KnxTransport {
+  public:
+    void set_gateway(const std::string &host, uint16_t port) {
+      this->host_ = host;
+      this->port_ = port;
+    }
+    void dump_config() override;
+    void on_shutdown() override;
+    KnxComponentserial_eventType poll() override;
+    void send(KnxTelegram *telegram) override;
+    // One tunnelling request at a time, until its TUNNELING_ACK
+    bool ready_to_send() override { return this->state_ == KNX_TUNNEL_CONNECTED && !this->tx_waiting_ack_; }
+    // The request and its one repetition wait for a TUNNELING_ACK each, then the line confirms
+    uint32_t confirm_timeout_ms() override {
+      return 2 * KNXNETIP_TUNNELING_ACK_TIMEOUT_MS + KNXNETIP_TUNNELING_CONFIRM_TIMEOUT_MS;
+    }
+
+  protected:
+    std::string host_;
+    uint16_t port_{3671};
+    std::unique_ptr<socket::Socket> socket_;
+    KnxTunnelState state_{KNX_TUNNEL_DISCONNECTED};
+    uint32_t state_ms_{0};             // Last CONNECT_REQUEST or loss of the connection
+    uint8_t channel_{0};
+    uint8_t rx_sequence_{0};           // Expected from the interface
+    uint8_t tx_sequence_{0};
+    bool tx_waiting_ack_{false};
+    bool tx_repeated_{false};
+    uint32_t tx_sent_ms_{0};
+    uint8_t tx_buffer_[KNXNETIP_MAX_FRAME_SIZE];
+    uint16_t tx_length_{0};
+    uint32_t heartbeat_ms_{0};
+    bool heartbeat_pending_{false};
+    uint8_t heartbeat_failures_{0};
+    KnxExtendedTelegram rx_telegram_;
+
+    bool open_socket();
+    void connect();
+    void disconnect(const char *reason);
+    void send_request(uint16_t service, bool with_hpai);
+    void write_frame(uint16_t service, const uint8_t *body, int length);
+    KnxComponentserial_eventType handle_frame(const uint8_t *data, int length);
+    KnxComponentserial_eventType handle_cemi(const uint8_t *cemi, int length);
+};
+
+}  // namespace knx
+}  // namespace esphome
+
+#endif  // USE_KNX_TUNNEL
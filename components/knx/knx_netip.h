@@ -0,0 +1,48 @@
+// Author: Dulgheru Mihaita (Since 2022)
+
+#pragma once
+
+#include <cstdint>
+#include "knx_cemi.h"
+
+namespace esphome {
+namespace knx {
+
+// KNXnet/IP services used by the tunnelling client and the router
+inline constexpr uint16_t KNXNETIP_CONNECT_REQUEST = 0x0205;
+inline constexpr uint16_t KNXNETIP_CONNECT_RESPONSE = 0x0206;
+inline constexpr uint16_t KNXNETIP_CONNECTIONSTATE_REQUEST = 0x0207;
+inline constexpr uint16_t KNXNETIP_CONNECTIONSTATE_RESPONSE = 0x0208;
+inline constexpr uint16_t KNXNETIP_DISCONNECT_REQUEST = 0x0209;
+inline constexpr uint16_t KNXNETIP_DISCONNECT_RESPONSE = 0x020A;
+inline constexpr uint16_t KNXNETIP_TUNNELING_REQUEST = 0x0420;
+inline constexpr uint16_t KNXNETIP_TUNNELING_ACK = 0x0421;
+inline constexpr uint16_t KNXNETIP_ROUTING_INDICATION = 0x0530;
+inline constexpr uint16_t KNXNETIP_ROUTING_LOST_MESSAGE = 0x0531;
+inline constexpr uint16_t KNXNETIP_ROUTING_BUSY = 0x0532;
+inline constexpr uint8_t KNXNETIP_VERSION_10 = 0x10;
+inline constexpr int KNXNETIP_HEADER_SIZE = 6;
+// Connection header of tunnelling requests and acks: length, channel, sequence counter, status
+inline constexpr int KNXNETIP_CONNECTION_HEADER_SIZE = 4;
+inline constexpr int KNXNETIP_MAX_FRAME_SIZE = KNXNETIP_HEADER_SIZE + KNXNETIP_CONNECTION_HEADER_SIZE + KNX_CEMI_MAX_SIZE;
+// Timeouts from the KNXnet/IP specification
+inline constexpr uint32_t KNXNETIP_CONNECT_TIMEOUT_MS = 10000;
+inline constexpr uint32_t KNXNETIP_HEARTBEAT_INTERVAL_MS = 60000;
+inline constexpr uint32_t KNXNETIP_HEARTBEAT_TIMEOUT_MS = 10000;
+inline constexpr uint8_t KNXNETIP_HEARTBEAT_RETRIES = 3;
+inline constexpr uint32_t KNXNETIP_TUNNELING_ACK_TIMEOUT_MS = 1000;
+// After the TUNNELING_ACK the interface still has to send the frame on its line before L_DATA.con
+inline constexpr uint32_t KNXNETIP_TUNNELING_CONFIRM_TIMEOUT_MS = 1000;
+
+// Fills the KNXnet/IP header for a frame of total_length bytes, header included
+inline void knx_netip_header(uint8_t *frame, uint16_t service, uint16_t total_length) {
+  frame[0] = KNXNETIP_HEADER_SIZE;
+  frame[1] = KNXNETIP_VERSION_10;
+  frame[2] = service >> 8;
+  frame[3] = service & 0xFF;
+  frame[4] = total_length >> 8;
+  frame[5] = total_length & 0xFF;
+}
+
+}  // namespace knx
+}  // namespace esphome
@@ -0,0 +1,47 @@
+// Author: Dulgheru Mihaita (Since 2022)
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+namespace esphome {
+namespace knx {
+
+// Lock-free ring between exactly one producer and one consumer, e.g. a receive task and loop().
+// Entries are filled and read in place: the producer claims the next free slot, fills it and pushes it,
+// the consumer reads the oldest slot and pops it. Neither side ever blocks the other.
+template<typename T, uint32_t N> class KnxSpscRing {
+  public:
+    static_assert((N & (N - 1)) == 0, "ring size must be a power of two");
+
+    // Producer: slot to fill, nullptr while the ring is full
+    T *claim() {
+      uint32_t head = this->head_.load(std::memory_order_relaxed);
+      if (head - this->tail_.load(std::memory_order_acquire) == N) {
+        return nullptr;
+      }
+      return &this->slots_[head & (N - 1)];
+    }
+    // Producer: publishes the slot returned by claim()
+    void push() { this->head_.store(this->head_.load(std::memory_order_relaxed) + 1, std::memory_order_release); }
+
+    // Consumer: oldest slot, nullptr while the ring is empty
+    T *front() {
+      uint32_t tail = this->tail_.load(std::memory_order_relaxed);
+      if (this->head_.load(std::memory_order_acquire) == tail) {
+        return nullptr;
+      }
+      return &this->slots_[tail & (N - 1)];
+    }
+    // Consumer: releases the slot returned by front()
+    void pop() { this->tail_.store(this->tail_.load(std::memory_order_relaxed) + 1, std::memory_order_release); }
+
+  protected:
+    std::atomic<uint32_t> head_{0};
+    std::atomic<uint32_t> tail_{0};
+    T slots_[N];
+};
+
+}  // namespace knx
+}  // namespace esphome
@@ -10,28 +10,97 @@
 // Last modified: 05.05.2022
 
 #include "knx_telegram.h"
+#include "knx_dpt.h"
+#include <stdio.h>
+#include <string.h>
 
-KnxTelegram::KnxTelegram() {
+using esphome::knx::Dpt;
+
+KnxTelegram::KnxTelegram(uint8_t *storage, int capacity) : buffer(storage), capacity_(capacity) {
   clear();
 }
 
+bool KnxTelegram::copy_from(const KnxTelegram &other) {
+  if (this == &other) {
+    return true;
+  }
+  int length = const_cast<KnxTelegram &>(other).get_total_length();
+  if (length > capacity_) {
+    // Does not fit, e.g. a long extended frame into standard storage
+    clear();
+    return false;
+  }
+  memcpy(buffer, other.buffer, length);
+  return true;
+}
+
 void KnxTelegram::clear() {
-  for (int i = 0; i < MAX_KNX_TELEGRAM_SIZE; i++) {
-    buffer[i] = 0;
+  clear(false);
+}
+
+void KnxTelegram::clear(bool extended) {
+  memset(buffer, 0, capacity_);
+
+  if (extended) {
+    // Control Field, Extended Frame, Normal Priority, No Repeat
+    buffer[0] = 0b00111100;
+
+    // Target Group Address, Routing Counter = 6, Standard Extended Frame Format
+    buffer[1] = 0b11100000;
+
+    // Length = 1 (= 2 Bytes)
+    buffer[6] = 1;
+  }
+  else {
+    // Control Field, Normal Priority, No Repeat
+    buffer[0] = 0b10111100;
+
+    // Target Group Address, Routing Counter = 6, Length = 1 (= 2 Bytes)
+    buffer[5] = 0b11100001;
   }
+}
 
-  // Control Field, Normal Priority, No Repeat
-  buffer[0] = 0b10111100;
+bool KnxTelegram::is_extended() {
+  return !(buffer[0] & 0b10000000);
+}
 
-  // Target Group Address, Routing Counter = 6, Length = 1 (= 2 Bytes)
-  buffer[5] = 0b11100001;
+int KnxTelegram::get_max_payload_length() {
+  int maxLength = capacity_ - get_header_size() - 1;
+  int formatLimit = is_extended() ? MAX_KNX_EXTENDED_PAYLOAD_SIZE : 16;
+  return maxLength < formatLimit ? maxLength : formatLimit;
 }
 
-int KnxTelegram::get_buffer_byte(int index) {
+bool KnxTelegram::set_data(const uint8_t *data, int length) {
+  if (length + 2 > get_max_payload_length()) {
+    return false;
+  }
+  set_payload_length(length + 2);
+  memcpy(&buffer[get_header_size() + 2], data, length);
+  return true;
+}
+
+void KnxTelegram::set_value(const uint8_t *data, int length) {
+  set_payload_length(2 + length);
+  int apci = get_header_size() + 1;
+  buffer[apci] = (buffer[apci] & 0b11000000) | (data[0] & 0b00111111);
+  memcpy(&buffer[apci + 1], &data[1], length);
+}
+
+bool KnxTelegram::get_value(uint8_t *data, int length) {
+  if (get_payload_length() != 2 + length) {
+    return false;
+  }
+  int apci = get_header_size() + 1;
+  data[0] = buffer[apci] & 0b00111111;
+  memcpy(&data[1], &buffer[apci + 1], length);
+  return true;
+}
+
+uint8_t KnxTelegram::get_buffer_byte(int index) {
   return buffer[index];
 }
 
-void KnxTelegram::set_buffer_byte(int index, int content) {
+void KnxTelegram::set_buffer_byte(int index, uint8_t content) {
   buffer[index] = content;
 }
 
@@ -65,135 +134,173 @@ KnxPriorityType KnxTelegram::get_priority() {
 }
 
 void KnxTelegram::set_source_address(int area, int line, int member) {
-  buffer[1] = (area << 4) | line;	// Source Address
-  buffer[2] = member; // Source Address
+  int i = get_address_index();
+  buffer[i] = (area << 4) | line;	// Source Address
+  buffer[i + 1] = member; // Source Address
 }
 
 int KnxTelegram::get_source_area() {
-  return (buffer[1] >> 4);
+  return (buffer[get_address_index()] >> 4);
 }
 
 int KnxTelegram::get_source_line() {
-  return (buffer[1] & 0b00001111);
+  return (buffer[get_address_index()] & 0b00001111);
 }
 
 int KnxTelegram::get_source_member() {
-  return buffer[2];
+  return buffer[get_address_index() + 1];
 }
 
 void KnxTelegram::set_target_group_address(int main, int middle, int sub) {
-  buffer[3] = (main << 3) | middle;
-  buffer[4] = sub;
-  buffer[5] = buffer[5] | 0b10000000;
+  set_target_group_address(KnxGroupAddress(main, middle, sub));
 }
 
 void KnxTelegram::set_target_individual_address(int area, int line, int member) {
-  buffer[3] = (area << 4) | line;
-  buffer[4] = member;
-  buffer[5] = buffer[5] & 0b01111111;
+  int i = get_address_index() + 2;
+  buffer[i] = (area << 4) | line;
+  buffer[i + 1] = member;
+  buffer[get_npci_index()] = buffer[get_npci_index()] & 0b01111111;
 }
 
 bool KnxTelegram::is_target_group() {
-  return buffer[5] & 0b10000000;
+  return buffer[get_npci_index()] & 0b10000000;
 }
 
-String KnxTelegram::get_target_group(){
-  String target =
-        String(0 + this->get_target_main_group())   + "/" +
-        String(0 + this->get_target_middle_group()) + "/" +
-        String(0 + this->get_target_sub_group());
+void KnxTelegram::set_target_group_address(KnxGroupAddress address) {
+  int i = get_address_index() + 2;
+  buffer[i] = address.raw() >> 8;
+  buffer[i + 1] = address.raw() & 0xFF;
+  buffer[get_npci_index()] = buffer[get_npci_index()] | 0b10000000;
+}
+
+KnxGroupAddress KnxTelegram::get_target_group_address() {
+  int i = get_address_index() + 2;
+  return KnxGroupAddress((uint16_t) ((buffer[i] << 8) | buffer[i + 1]));
+}
+
+std::string KnxTelegram::get_target_group(){
+  char target[12];
+  snprintf(target, sizeof(target), "%d/%d/%d", this->get_target_main_group(), this->get_target_middle_group(), this->get_target_sub_group());
   return target;
 }
 
 int KnxTelegram::get_target_main_group() {
-  return ((buffer[3] & 0b01111000) >> 3);
+  return ((buffer[get_address_index() + 2] & 0b11111000) >> 3);
 }
 
 int KnxTelegram::get_target_middle_group() {
-  return (buffer[3] & 0b00000111);
+  return (buffer[get_address_index() + 2] & 0b00000111);
 }
 
 int KnxTelegram::get_target_sub_group() {
-  return buffer[4];
+  return buffer[get_address_index() + 3];
 }
 
 int KnxTelegram::get_target_area() {
-  return ((buffer[3] & 0b11110000) >> 4);
+  return ((buffer[get_address_index() + 2] & 0b11110000) >> 4);
 }
 
 int KnxTelegram::get_target_line() {
-  return (buffer[3] & 0b00001111);
+  return (buffer[get_address_index() + 2] & 0b00001111);
 }
 
 int KnxTelegram::get_target_member() {
-  return buffer[4];
+  return buffer[get_address_index() + 3];
 }
 
 void KnxTelegram::set_routing_counter(int counter) {
-  buffer[5] = buffer[5] & 0b10000000;
-  buffer[5] = buffer[5] | (counter << 4);
+  int i = get_npci_index();
+  buffer[i] = buffer[i] & 0b10001111;
+  buffer[i] = buffer[i] | ((counter & 0b00000111) << 4);
 }
 
 int KnxTelegram::get_routing_counter() {
-  return ((buffer[5] & 0b01110000) >> 4);
+  return ((buffer[get_npci_index()] & 0b01110000) >> 4);
 }
 
 void KnxTelegram::set_payload_length(int length) {
+  if (is_extended()) {
+    buffer[6] = length - 1;
+    return;
+  }
   buffer[5] = buffer[5] & 0b11110000;
   buffer[5] = buffer[5] | (length - 1);
 }
 
 int KnxTelegram::get_payload_length() {
+  if (is_extended()) {
+    return buffer[6] + 1;
+  }
   int length = (buffer[5] & 0b00001111) + 1;
   return length;
 }
 
 void KnxTelegram::set_command(KnxCommandType command) {
-  buffer[6] = buffer[6] & 0b11111100;
-  buffer[7] = buffer[7] & 0b00111111;
+  int i = get_header_size();
+  buffer[i] = buffer[i] & 0b11111100;
+  buffer[i + 1] = buffer[i + 1] & 0b00111111;
 
-  buffer[6] = buffer[6] | (command >> 2); // Command first two bits
-  buffer[7] = buffer[7] | (command << 6); // Command last two bits
+  buffer[i] = buffer[i] | (command >> 2); // Command first two bits
+  buffer[i + 1] = buffer[i + 1] | (command << 6); // Command last two bits
 }
 
 KnxCommandType KnxTelegram::get_command() {
-  return (KnxCommandType) (((buffer[6] & 0b00000011) << 2) | ((buffer[7] & 0b11000000) >> 6));
+  int i = get_header_size();
+  return (KnxCommandType) (((buffer[i] & 0b00000011) << 2) | ((buffer[i + 1] & 0b11000000) >> 6));
 }
 
 void KnxTelegram::set_control_data(KnxControlDataType cd) {
-  buffer[6] = buffer[6] & 0b11111100;
-  buffer[6] = buffer[6] | cd;
+  int i = get_header_size();
+  buffer[i] = buffer[i] & 0b11111100;
+  buffer[i] = buffer[i] | cd;
 }
 
 KnxControlDataType KnxTelegram::get_control_data() {
-  return (KnxControlDataType) (buffer[6] & 0b00000011);
+  return (KnxControlDataType) (buffer[get_header_size()] & 0b00000011);
 }
 
 KnxCommunicationType KnxTelegram::get_communication_type() {
-  return (KnxCommunicationType) ((buffer[6] & 0b11000000) >> 6);
+  return (KnxCommunicationType) ((buffer[get_header_size()] & 0b11000000) >> 6);
 }
 
 void KnxTelegram::set_communication_type(KnxCommunicationType type) {
-  buffer[6] = buffer[6] & 0b00111111;
-  buffer[6] = buffer[6] | (type << 6);
+  int i = get_header_size();
+  buffer[i] = buffer[i] & 0b00111111;
+  buffer[i] = buffer[i] | (type << 6);
 }
 
 int KnxTelegram::get_sequence_number() {
-  return (buffer[6] & 0b00111100) >> 2;
+  return (buffer[get_header_size()] & 0b00111100) >> 2;
 }
 
 void KnxTelegram::set_sequence_number(int number) {
-  buffer[6] = buffer[6] & 0b11000011;
-  buffer[6] = buffer[6] | (number << 2);
+  int i = get_header_size();
+  buffer[i] = buffer[i] & 0b11000011;
+  buffer[i] = buffer[i] | (number << 2);
 }
 
 void KnxTelegram::create_checksum() {
-  int checksumPos = get_payload_length() + KNX_TELEGRAM_HEADER_SIZE;
+  int checksumPos = get_payload_length() + get_header_size();
   buffer[checksumPos] = calculate_checksum();
 }
 
-int KnxTelegram::get_checksum() {
-  int checksumPos = get_payload_length() + KNX_TELEGRAM_HEADER_SIZE;
+uint32_t KnxTelegram::get_content_hash() {
+  // FNV-1a
+  uint32_t hash = 2166136261UL;
+  int end = get_header_size() + get_payload_length();
+  int hopIndex = is_extended() ? 1 : 5;
+  for (int i = 1; i < end; i++) {
+    uint8_t b = buffer[i];
+    if (i == hopIndex) {
+      b &= 0b10001111;
+    }
+    hash = (hash ^ b) * 16777619UL;
+  }
+  return hash;
+}
+
+uint8_t KnxTelegram::get_checksum() {
+  int checksumPos = get_payload_length() + get_header_size();
   return buffer[checksumPos];
 }
 
@@ -250,7 +357,7 @@ void KnxTelegram::print() {
     serial->print("Data Byte ");
     serial->print(i);
     serial->print(": ");
-    serial->println(buffer[6 + i], BIN);
+    serial->println(buffer[get_header_size() + i], BIN);
   }
 
 
@@ -265,11 +372,19 @@ void KnxTelegram::print() {
 #endif
 }
 
-int KnxTelegram::calculate_checksum() {
-  int bcc = 0xFF;
-  int size = get_payload_length() + KNX_TELEGRAM_HEADER_SIZE;
+uint8_t KnxTelegram::calculate_checksum() {
+  int size = get_payload_length() + get_header_size();
 
-  for (int i = 0; i < size; i++) {
+  // XOR four bytes at a time, then fold the word into a single byte
+  uint32_t word = 0;
+  int i = 0;
+  for (; i + 4 <= size; i += 4) {
+    uint32_t chunk;
+    memcpy(&chunk, &buffer[i], sizeof(chunk));
+    word ^= chunk;
+  }
+  uint8_t bcc = 0xFF ^ (word & 0xFF) ^ ((word >> 8) & 0xFF) ^ ((word >> 16) & 0xFF) ^ (word >> 24);
+  for (; i < size; i++) {
     bcc ^= buffer[i];
   }
 
@@ -277,275 +392,118 @@ int KnxTelegram::calculate_checksum() {
 }
 
 int KnxTelegram::get_total_length() {
-  return KNX_TELEGRAM_HEADER_SIZE + get_payload_length() + 1;
+  return get_header_size() + get_payload_length() + 1;
 }
 
 void KnxTelegram::set_first_data_byte(int data) {
-  buffer[7] = buffer[7] & 0b11000000;
-  buffer[7] = buffer[7] | data;
+  int i = get_header_size() + 1;
+  buffer[i] = buffer[i] & 0b11000000;
+  buffer[i] = buffer[i] | data;
 }
 
 int KnxTelegram::get_first_data_byte() {
-  return (buffer[7] & 0b00111111);
+  return (buffer[get_header_size() + 1] & 0b00111111);
 }
 
 bool KnxTelegram::get_bool() {
-  if (get_payload_length() != 2) {
-    // Wrong payload length
-    return 0;
-  }
-
-  return (get_first_data_byte() & 0b00000001);
+  return get<Dpt<1>>().value_or(false);
 }
 
 int KnxTelegram::get_4bit_int_value() {
-  if (get_payload_length() != 2) {
-    // Wrong payload length
-    return 0;
-  }
-
-  return (get_first_data_byte() & 0b00001111);
+  auto value = get<Dpt<3>>();
+  return value.has_value() ? (value->increase << 3) | value->steps : 0;
 }
 
 bool KnxTelegram::get_4bit_direction_value() {
-  if (get_payload_length() != 2) {
-    // Wrong payload length
-    return 0;
-  }
-
-  return ((get_first_data_byte() & 0b00001000)) >> 3;
+  auto value = get<Dpt<3>>();
+  return value.has_value() && value->increase;
 }
 
-byte KnxTelegram::get_4bit_steps_value() {
-  if (get_payload_length() != 2) {
-    // Wrong payload length
-    return 0;
-  }
-
-  return (get_first_data_byte() & 0b00000111);
+uint8_t KnxTelegram::get_4bit_steps_value() {
+  auto value = get<Dpt<3>>();
+  return value.has_value() ? value->steps : 0;
 }
 
 void KnxTelegram::set_1byte_int_value(int value) {
-  set_payload_length(3);
-  buffer[8] = value;
+  set<Dpt<5>>(value);
 }
 
 int KnxTelegram::get_1byte_int_value() {
-  if (get_payload_length() != 3) {
-    // Wrong payload length
-    return 0;
-  }
-
-  return (buffer[8]);
+  return get<Dpt<5>>().value_or(0);
 }
 
 void KnxTelegram::set_2byte_int_value(int value) {
-  set_payload_length(4);
-
-  buffer[8] = byte(value >> 8);
-  buffer[9] = byte(value & 0x00FF);
+  set<Dpt<7>>(value);
 }
 
 int KnxTelegram::get_2byte_int_value() {
-  if (get_payload_length() != 4) {
-    // Wrong payload length
-    return 0;
-  }
-  int value = int(buffer[8] << 8) + int(buffer[9]);
-
-  return (value);
+  return get<Dpt<7>>().value_or(0);
 }
 
 void KnxTelegram::set_2byte_float_value(float value) {
-  set_payload_length(4);
-
-  float v = value * 100.0f;
-  int exponent = 0;
-  for (; v < -2048.0f; v /= 2) exponent++;
-  for (; v > 2047.0f; v /= 2) exponent++;
-  long m = (int)round(v) & 0x7FF;
-  short msb = (short) (exponent << 3 | m >> 8);
-  if (value < 0.0f) msb |= 0x80;
-  buffer[8] = msb;
-  buffer[9] = (byte)m;
+  set<Dpt<9>>(value);
 }
 
 float KnxTelegram::get_2byte_float_value() {
-  if (get_payload_length() != 4) {
-    // Wrong payload length
-    return 0;
-  }
-
-  int exponent = (buffer[8] & 0b01111000) >> 3;
-  int mantissa = ((buffer[8] & 0b00000111) << 8) | (buffer[9]);
-
-  if (buffer[8] & 0b10000000) {
-    return ((-2048 + mantissa) * 0.01) * pow(2.0, exponent);
-  }
-
-  return (mantissa * 0.01) * pow(2.0, exponent);
+  return get<Dpt<9>>().value_or(0);
 }
 
 void KnxTelegram::set_3byte_time(int weekday, int hour, int minute, int second) {
-  set_payload_length(5);
-
-  // Move the weekday by 5 bits to the left
-  weekday = weekday << 5;
-
-  // Buffer [8] bit 5-7 for weekday, bit 0-4 for hour
-  buffer[8] = (weekday & 0b11100000) + (hour & 0b00011111);
-
-  // Buffer [9] bit 6-7 empty, bit 0-5 for minutes
-  buffer[9] =  minute & 0b00111111;
-
-  // Buffer [10] bit 6-7 empty, bit 0-5 for seconds
-  buffer[10] = second & 0b00111111;
+  set<Dpt<10>>({(uint8_t) weekday, (uint8_t) hour, (uint8_t) minute, (uint8_t) second});
 }
 
 int KnxTelegram::get_3byte_weekday_value() {
-  if (get_payload_length() != 5) {
-    // Wrong payload length
-    return 0;
-  }
-  return (buffer[8] & 0b11100000) >> 5;
+  auto value = get<Dpt<10>>();
+  return value.has_value() ? value->weekday : 0;
 }
 
 int KnxTelegram::get_3byte_hour_value() {
-  if (get_payload_length() != 5) {
-    // Wrong payload length
-    return 0;
-  }
-  return (buffer[8] & 0b00011111);
+  auto value = get<Dpt<10>>();
+  return value.has_value() ? value->hour : 0;
 }
 
 int KnxTelegram::get_3byte_minute_value() {
-  if (get_payload_length() != 5) {
-    // Wrong payload length
-    return 0;
-  }
-  return (buffer[9] & 0b00111111);
+  auto value = get<Dpt<10>>();
+  return value.has_value() ? value->minute : 0;
 }
 
 int KnxTelegram::get_3byte_second_value() {
-  if (get_payload_length() != 5) {
-    // Wrong payload length
-    return 0;
-  }
-  return (buffer[10] & 0b00111111);
+  auto value = get<Dpt<10>>();
+  return value.has_value() ? value->second : 0;
 }
 
 void KnxTelegram::set_3byte_date(int day, int month, int year) {
-  set_payload_length(5);
-
-  // Buffer [8] bit 5-7 empty, bit 0-4 for month days
-  buffer[8] = day & 0b00011111;
-
-  // Buffer [9] bit 4-7 empty, bit 0-3 for months
-  buffer[9] =  month & 0b00001111;
-
-  // Buffer [10] fill with year
-  buffer[10] = year;
+  set<Dpt<11>>({(uint8_t) day, (uint8_t) month, (uint16_t) year});
 }
 
 int KnxTelegram::get_3byte_day_value() {
-  if (get_payload_length() != 5) {
-    // Wrong payload length
-    return 0;
-  }
-  return (buffer[8] & 0b00011111);
+  auto value = get<Dpt<11>>();
+  return value.has_value() ? value->day : 0;
 }
 
 int KnxTelegram::get_3byte_month_value() {
-  if (get_payload_length() != 5) {
-    // Wrong payload length
-    return 0;
-  }
-  return (buffer[9] & 0b00001111);
+  auto value = get<Dpt<11>>();
+  return value.has_value() ? value->month : 0;
 }
 
 int KnxTelegram::get_3byte_year_value() {
-  if (get_payload_length() != 5) {
-    // Wrong payload length
-    return 0;
-  }
-  return (buffer[10]);
+  // Raw two digit year, as it travels on the bus
+  auto value = get<Dpt<11>>();
+  return value.has_value() ? value->year % 100 : 0;
 }
 
 void KnxTelegram::set_4byte_float_value(float value) {
-  set_payload_length(6);
+  set<Dpt<14>>(value);
+}
 
-  byte b[4];
-  float *f = (float*)(void*) & (b[0]);
-  *f = value;
+float KnxTelegram::get_4byte_float_value() {
+  return get<Dpt<14>>().value_or(0);
+}
 
-  buffer[8 + 3] = b[0];
-  buffer[8 + 2] = b[1];
-  buffer[8 + 1] = b[2];
-  buffer[8 + 0] = b[3];
+void KnxTelegram::set_14byte_value(const std::string &value) {
+  set<Dpt<16>>(value);
 }
 
-float KnxTelegram::get_4byte_float_value() {
-  if (get_payload_length() != 6) {
-    // Wrong payload length
-    return 0;
-  }
-  byte b[4];
-  b[0] = buffer[8 + 3];
-  b[1] = buffer[8 + 2];
-  b[2] = buffer[8 + 1];
-  b[3] = buffer[8 + 0];
-  float *f = (float*)(void*) & (b[0]);
-  float  r = *f;
-  return r;
-}
-
-void KnxTelegram::set_14byte_value(String value) {
-  // Define
-  char _load[15];
-
-  // Empty/Initialize with space
-  for (int i = 0; i < 14; ++i)
-  {
-    _load[i] = 0;
-  }
-  set_payload_length(16);
-  // Make out of value the Chararray
-  value.toCharArray(_load, 15); // Must be 15 - because it completes with 0
-  buffer[8 + 0] = _load [0];
-  buffer[8 + 1] = _load [1];
-  buffer[8 + 2] = _load [2];
-  buffer[8 + 3] = _load [3];
-  buffer[8 + 4] = _load [4];
-  buffer[8 + 5] = _load [5];
-  buffer[8 + 6] = _load [6];
-  buffer[8 + 7] = _load [7];
-  buffer[8 + 8] = _load [8];
-  buffer[8 + 9] = _load [9];
-  buffer[8 + 10] = _load [10];
-  buffer[8 + 11] = _load [11];
-  buffer[8 + 12] = _load [12];
-  buffer[8 + 13] = _load [13];
-}
-
-String KnxTelegram::get_14byte_value() {
-  if (get_payload_length() != 16) {
-    // Wrong payload length
-    return "";
-  }
-  char _load[15];
-  _load[0] = buffer[8 + 0];
-  _load[1] = buffer[8 + 1];
-  _load[2] = buffer[8 + 2];
-  _load[3] = buffer[8 + 3];
-  _load[4] = buffer[8 + 4];
-  _load[5] = buffer[8 + 5];
-  _load[6] = buffer[8 + 6];
-  _load[7] = buffer[8 + 7];
-  _load[8] = buffer[8 + 8];
-  _load[9] = buffer[8 + 9];
-  _load[10] = buffer[8 + 10];
-  _load[11] = buffer[8 + 11];
-  _load[12] = buffer[8 + 12];
-  _load[13] = buffer[8 + 13];
-  return (_load);
-}
\ No newline at end of file
+std::string KnxTelegram::get_14byte_value() {
+  return get<Dpt<16>>().value_or("");
+}
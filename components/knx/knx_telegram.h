@@ -11,10 +11,17 @@
 #ifndef KnxTelegram_h
 #define KnxTelegram_h
 
-#include "Arduino.h"
+#include <stdint.h>
+#include <string>
+#include "knx_group_address.h"
+#include <optional>
 
 #define MAX_KNX_TELEGRAM_SIZE 23
 #define KNX_TELEGRAM_HEADER_SIZE 6
+// L_Data_Extended: control, extended control, 2 x address, 8 bit length, up to 255 payload bytes, checksum
+#define MAX_KNX_EXTENDED_PAYLOAD_SIZE 255
+#define KNX_EXTENDED_TELEGRAM_HEADER_SIZE 7
+#define MAX_KNX_EXTENDED_TELEGRAM_SIZE (KNX_EXTENDED_TELEGRAM_HEADER_SIZE + MAX_KNX_EXTENDED_PAYLOAD_SIZE + 1)
 
 // KNX priorities
 enum KnxPriorityType {
@@ -60,13 +67,26 @@ enum KnxControlDataType {
   KNX_CONTROLDATA_NEG_CONFIRM = 0b11   // NCD
 };
 
+// A standard or extended frame in storage of the derived class: KnxStandardTelegram has room for a standard
+// frame, KnxExtendedTelegram for the longest extended frame. Handled through KnxTelegram pointers.
 class KnxTelegram {
   public:
-    KnxTelegram();
+    KnxTelegram(const KnxTelegram &other) = delete;
+    KnxTelegram &operator=(const KnxTelegram &other) = delete;
 
     void clear();
-    void set_buffer_byte(int index, int content);
-    int get_buffer_byte(int index);
+    void clear(bool extended);
+    bool is_extended();
+    // Copies the frame of other, fails (and clears) if it does not fit into this storage
+    bool copy_from(const KnxTelegram &other);
+    int get_capacity() { return capacity_; }
+    int get_max_payload_length();
+    void set_buffer_byte(int index, uint8_t content);
+    uint8_t get_buffer_byte(int index);
+    // Raw frame, size() bytes including the checksum
+    uint8_t *data() { return buffer; }
+    const uint8_t *data() const { return buffer; }
+    int size() { return get_total_length(); }
     void set_payload_length(int size);
     int get_payload_length();
     void set_repeated(bool repeat);
@@ -80,7 +100,9 @@ class KnxTelegram {
     void set_target_group_address(int main, int middle, int sub);
     void set_target_individual_address(int area, int line, int member);
     bool is_target_group();
-    String get_target_group();
+    void set_target_group_address(KnxGroupAddress address);
+    KnxGroupAddress get_target_group_address();
+    std::string get_target_group();
     int get_target_main_group();
     int get_target_middle_group();
     int get_target_sub_group();
@@ -98,7 +120,7 @@ class KnxTelegram {
 
     int get_4bit_int_value();
     bool get_4bit_direction_value();
-    byte get_4bit_steps_value();
+    uint8_t get_4bit_steps_value();
 
     void set_1byte_int_value(int value);
     int get_1byte_int_value();
@@ -121,12 +143,39 @@ class KnxTelegram {
     void set_4byte_float_value(float value);
     float get_4byte_float_value();
 
-    void set_14byte_value(String value);
-    String get_14byte_value();
+    void set_14byte_value(const std::string &value);
+    std::string get_14byte_value();
+
+    // Data bytes following the APCI, for values that do not fit a datapoint type (bulk data)
+    bool set_data(const uint8_t *data, int length);
+    const uint8_t *get_data() { return &buffer[get_header_size() + 2]; }
+    int get_data_length() { return get_payload_length() - 2; }
+
+    // Generic datapoint access, see knx_dpt.h. get() is empty if the payload length does not match D.
+    // Raw datapoint octets in the layout of knx_dpt.h: data[0] holds the 6 low APCI bits, data[1..length] follow
+    void set_value(const uint8_t *data, int length);
+    bool get_value(uint8_t *data, int length);
+
+    template<typename D> void set(const typename D::value_type &value) {
+      uint8_t data[1 + D::length] = {0};
+      D::encode(value, data);
+      set_value(data, D::length);
+    }
+    template<typename D> std::optional<typename D::value_type> get() {
+      uint8_t data[1 + D::length];
+      if (!get_value(data, D::length)) {
+        return {};
+      }
+      return D::decode(data);
+    }
+
+    // Hash of source, destination, TPCI/APCI and payload. Repeat flag, priority and hop count are left out,
+    // so a repeated or re-routed copy hashes like the original.
+    uint32_t get_content_hash();
 
     void create_checksum();
     bool verify_checksum();
-    int get_checksum();
+    uint8_t get_checksum();
     void print();
     int get_total_length();
     KnxCommunicationType get_communication_type();
@@ -136,10 +185,56 @@ class KnxTelegram {
     KnxControlDataType get_control_data();
     void set_control_data(KnxControlDataType);
 
+    // Offsets that differ between the standard and the extended frame format
+    int get_header_size() { return is_extended() ? KNX_EXTENDED_TELEGRAM_HEADER_SIZE : KNX_TELEGRAM_HEADER_SIZE; }
+
+  protected:
+    KnxTelegram(uint8_t *storage, int capacity);
+
+    uint8_t *buffer;
+
   private:
-    int buffer[MAX_KNX_TELEGRAM_SIZE];
-    int calculate_checksum();
+    int get_address_index() { return is_extended() ? 2 : 1; }  // Source address, target address follows
+    int get_npci_index() { return is_extended() ? 1 : 5; }     // Address type and routing counter
+
+    uint8_t calculate_checksum();
+    int capacity_;
+};
+
+class KnxStandardTelegram : public KnxTelegram {
+  public:
+    KnxStandardTelegram() : KnxTelegram(standard_storage_, MAX_KNX_TELEGRAM_SIZE) {}
+    KnxStandardTelegram(const KnxTelegram &other) : KnxStandardTelegram() { copy_from(other); }
+    KnxStandardTelegram(const KnxStandardTelegram &other) : KnxStandardTelegram() { copy_from(other); }
+    KnxStandardTelegram &operator=(const KnxTelegram &other) {
+      copy_from(other);
+      return *this;
+    }
+    KnxStandardTelegram &operator=(const KnxStandardTelegram &other) {
+      copy_from(other);
+      return *this;
+    }
 
+  private:
+    uint8_t standard_storage_[MAX_KNX_TELEGRAM_SIZE];
+};
+
+class KnxExtendedTelegram : public KnxTelegram {
+  public:
+    KnxExtendedTelegram() : KnxTelegram(extended_storage_, MAX_KNX_EXTENDED_TELEGRAM_SIZE) {}
+    KnxExtendedTelegram(const KnxTelegram &other) : KnxExtendedTelegram() { copy_from(other); }
+    KnxExtendedTelegram(const KnxExtendedTelegram &other) : KnxExtendedTelegram() { copy_from(other); }
+    KnxExtendedTelegram &operator=(const KnxTelegram &other) {
+      copy_from(other);
+      return *this;
+    }
+    KnxExtendedTelegram &operator=(const KnxExtendedTelegram &other) {
+      copy_from(other);
+      return *this;
+    }
+
+  private:
+    uint8_t extended_storage_[MAX_KNX_EXTENDED_TELEGRAM_SIZE];
 };
 
 #endif
\ No newline at end of file
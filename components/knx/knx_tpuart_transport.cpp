@@ -0,0 +1,478 @@
+// Author: Dulgheru Mihaita (Since 2022)
+
+#include "knx_tpuart_transport.h"
+#ifdef USE_KNX_TPUART
+
+#include "knx_component.h"
+#include "esphome/core/log.h"
+
+namespace esphome {
+namespace knx {
+
+#ifdef USE_KNX_RX_TASK
+// The receive task writes ACKs and transceiver requests while loop() writes frames and the busy mode
+#define TPUART_TX_LOCK() LockGuard tx_lock_guard(this->tx_lock_)
+#else
+#define TPUART_TX_LOCK()
+#endif
+
+  static const char *transceiver_name(KnxTransceiverType transceiver) {
+    switch (transceiver) {
+      case KNX_TRANSCEIVER_TPUART: return "TPUART";
+      case KNX_TRANSCEIVER_TPUART2: return "TP-UART2";
+      case KNX_TRANSCEIVER_NCN5120: return "NCN5120";
+      default: return "not detected yet";
+    }
+  }
+
+  // CRC-CCITT (polynomial 0x1021, initial value 0xFFFF) as used by the TP-UART2 CRC mode
+  static uint16_t crc_ccitt(const uint8_t *data, int length) {
+    uint16_t crc = 0xFFFF;
+    for (int i = 0; i < length; i++) {
+      crc ^= data[i] << 8;
+      for (int bit = 0; bit < 8; bit++) {
+        crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+      }
+    }
+    return crc;
+  }
+
+  void KnxTpuartTransport::setup() {
+    // The transceiver is detected and configured once its reset indication arrives
+    this->uart_reset();
+#ifdef USE_KNX_RX_TASK
+    if (this->rx_task_core_ >= 0 &&
+        xTaskCreatePinnedToCore(rx_task, "knx_rx", TPUART_RX_TASK_STACK_SIZE, this, this->rx_task_priority_,
+                                &this->rx_task_, this->rx_task_core_) != pdPASS) {
+      ESP_LOGW(TAG, "Could not start the receive task, receiving from loop().");
+      this->rx_task_ = nullptr;
+    }
+#endif
+    // A frame start seen by an idle loop() 16 ms late leaves no time to ACK a short frame, so loop() runs
+    // back to back for as long as it receives
+    if (!this->rx_task_running()) {
+      this->high_freq_.start();
+    }
+  }
+
+  void KnxTpuartTransport::dump_config() {
+    ESP_LOGCONFIG(TAG, " Knx transceiver: %s, ACK for our address by %s, UART CRC %s", transceiver_name(this->chip_),
+      this->address_ack_ ? "transceiver" : "software", this->crc_active_ ? "on" : "off");
+#ifdef USE_KNX_RX_TASK
+    if (this->rx_task_ != nullptr) {
+      ESP_LOGCONFIG(TAG, " Knx receive task on core %d, priority %d", this->rx_task_core_, this->rx_task_priority_);
+    }
+#endif
+  }
+
+  void KnxTpuartTransport::uart_reset() {
+    TPUART_TX_LOCK();
+    this->write(TPUART_RESET_REQUEST);
+  }
+
+  void KnxTpuartTransport::uart_state_request() {
+    TPUART_TX_LOCK();
+    this->write(TPUART_STATE_REQUEST);
+  }
+
+  // After every reset: the transceiver has forgotten its address and modes
+  void KnxTpuartTransport::configure_transceiver() {
+    TPUART_TX_LOCK();
+    this->address_ack_ = false;
+    this->crc_active_ = false;
+    if (this->transceiver_ != KNX_TRANSCEIVER_AUTO) {
+      this->apply_transceiver(this->transceiver_);
+    }
+    else if (this->chip_ != KNX_TRANSCEIVER_AUTO) {
+      this->apply_transceiver(this->chip_);
+    }
+    else {
+      // The original TPUART ignores both requests
+      this->write(TPUART2_PRODUCT_ID_REQUEST);
+      this->probe_ = TPUART_PROBE_PRODUCT_ID;
+      this->probe_ms_ = millis();
+    }
+  }
+
+  void KnxTpuartTransport::probe_timeout() {
+    TPUART_TX_LOCK();
+    if (this->probe_ == TPUART_PROBE_PRODUCT_ID) {
+      this->write(NCN5120_SYSTEM_STAT_REQUEST);
+      this->probe_ = TPUART_PROBE_SYSTEM_STAT;
+      this->probe_ms_ = millis();
+      return;
+    }
+    this->apply_transceiver(KNX_TRANSCEIVER_TPUART);
+  }
+
+  // Answers to the probe requests, only expected between frames
+  bool KnxTpuartTransport::probe_response(uint8_t b) {
+    TPUART_TX_LOCK();
+    switch (this->probe_) {
+      case TPUART_PROBE_PRODUCT_ID:
+        // Anything else is noise, the probe goes on to U_SystemStat when no response comes in time
+        if ((b & TPUART2_PRODUCT_ID_MASK) != TPUART2_PRODUCT_ID_RESPONSE ||
+            (b & TPUART_STATE_INDICATION_MASK) == TPUART_STATE_INDICATION_MASK) {
+          return false;
+        }
+        this->apply_transceiver(KNX_TRANSCEIVER_TPUART2);
+        return true;
+      case TPUART_PROBE_SYSTEM_STAT:
+        if (b != NCN5120_SYSTEM_STAT_INDICATION) {
+          return false;
+        }
+        this->probe_ = TPUART_PROBE_SYSTEM_STAT_VALUE;
+        return true;
+      case TPUART_PROBE_SYSTEM_STAT_VALUE:
+        this->apply_transceiver(KNX_TRANSCEIVER_NCN5120);
+        return true;
+      default:
+        return false;
+    }
+  }
+
+  // Called with tx_lock_ held
+  void KnxTpuartTransport::apply_transceiver(KnxTransceiverType transceiver) {
+    this->chip_ = transceiver;
+    this->probe_ = TPUART_PROBE_NONE;
+    uint16_t address = this->component_->get_individual_address();
+    if (transceiver == KNX_TRANSCEIVER_TPUART2) {
+      uint8_t request[3] = {TPUART2_SET_ADDRESS, (uint8_t) (address >> 8), (uint8_t) (address & 0xFF)};
+      this->write_array(request, sizeof(request));
+      this->address_ack_ = true;
+      if (this->uart_crc_) {
+        this->write(TPUART2_ACTIVATE_CRC);
+        this->crc_active_ = true;
+      }
+    }
+    else if (transceiver == KNX_TRANSCEIVER_NCN5120) {
+      // Address high, address low and a byte that is ignored
+      uint8_t request[4] = {NCN5120_SET_ADDRESS, (uint8_t) (address >> 8), (uint8_t) (address & 0xFF), 0};
+      this->write_array(request, sizeof(request));
+      this->address_ack_ = true;
+    }
+    if (this->busy_mode_) {
+      this->write_busy_mode();
+    }
+    this->rx_deliver(TPUART_RX_EVENT_TRANSCEIVER, 0);
+  }
+
+  void KnxTpuartTransport::set_busy_mode(bool busy) {
+    TPUART_TX_LOCK();
+    this->busy_mode_ = busy;
+    this->write_busy_mode();
+  }
+
+  void KnxTpuartTransport::write_busy_mode() {
+    if (this->chip_ == KNX_TRANSCEIVER_TPUART2) {
+      this->write(this->busy_mode_ ? TPUART2_ACTIVATE_BUSY_MODE : TPUART2_RESET_BUSY_MODE);
+    }
+    else if (this->chip_ == KNX_TRANSCEIVER_NCN5120) {
+      this->write(this->busy_mode_ ? NCN5120_SET_BUSY : NCN5120_QUIT_BUSY);
+    }
+    // The original TPUART has no busy mode, our own ACKs carry the busy flag instead
+  }
+
+  KnxComponentserial_eventType KnxTpuartTransport::poll() {
+    this->check_errors();
+    this->log_overflow();
+#ifdef USE_KNX_RX_TASK
+    if (this->rx_task_ != nullptr) {
+      return this->poll_rx_ring();
+    }
+#endif
+    return this->receive();
+  }
+
+  bool KnxTpuartTransport::input_pending() {
+#ifdef USE_KNX_RX_TASK
+    if (this->rx_task_ != nullptr) {
+      return this->rx_ring_.front() != nullptr;
+    }
+#endif
+    return this->available() > 0;
+  }
+
+  // Receive state machine, run from loop() or from the receive task. Handles everything that is buffered,
+  // returns after each complete frame and with UNKNOWN once the UART has nothing left.
+  KnxComponentserial_eventType KnxTpuartTransport::receive() {
+    // A full receive buffer has most likely dropped bytes, counted once until it drains
+    bool full = this->available() >= (int) this->parent_->get_rx_buffer_size();
+    if (full && !this->rx_full_) {
+      this->rx_overflow_ |= TPUART_OVERFLOW_UART;
+      this->metrics_->rx_overflows++;
+    }
+    this->rx_full_ = full;
+    if (this->probe_ != TPUART_PROBE_NONE && millis() - this->probe_ms_ > TPUART_PROBE_TIMEOUT_MS) {
+      this->probe_timeout();
+    }
+    if (this->rx_state_ == TPUART_RX_FRAME && this->available() == 0 &&
+        micros() - this->rx_last_byte_us_ > TPUART_RX_GAP_TIMEOUT_US) {
+      // Nothing arrived since the last byte, so the gap on the bus is at least that long
+      int received = this->rx_index_;
+      this->rx_reset();
+      this->rx_deliver(TPUART_RX_EVENT_INCOMPLETE, received);
+    }
+
+    while (this->available() > 0) {
+      int incomingByte = this->read();
+      this->rx_last_byte_us_ = micros();
+
+      if (this->rx_state_ == TPUART_RX_IDLE) {
+        if (this->is_knx_control_byte(incomingByte)) {
+          this->rx_buffer_[0] = incomingByte;
+          this->rx_index_ = 1;
+          // Real length is known once the length byte has been received
+          this->rx_length_ = (incomingByte & 0b10000000) ? KNX_TELEGRAM_HEADER_SIZE : KNX_EXTENDED_TELEGRAM_HEADER_SIZE;
+          this->rx_state_ = TPUART_RX_FRAME;
+          continue;
+        }
+        else if (incomingByte == TPUART_DATA_CONFIRM_SUCCESS) {
+          this->rx_deliver(TPUART_RX_EVENT_CONFIRMED, 0);
+          continue;
+        }
+        else if (incomingByte == TPUART_DATA_CONFIRM_FAILED) {
+          this->rx_deliver(TPUART_RX_EVENT_NACKED, 0);
+          continue;
+        }
+        else if (incomingByte == TPUART_RESET_INDICATION_BYTE) {
+          KnxComponentserial_eventType event = this->rx_deliver(TPUART_RX_EVENT_RESET, 0);
+          this->configure_transceiver();
+          return event;
+        }
+        else if (this->probe_ != TPUART_PROBE_NONE && this->probe_response(incomingByte)) {
+          continue;
+        }
+        else if (incomingByte == KNX_ACK_FRAME) {
+          this->metrics_->bus_acks++;
+          continue;
+        }
+        else if (incomingByte == KNX_NACK_FRAME) {
+          this->metrics_->bus_nacks++;
+          continue;
+        }
+        else if (incomingByte == KNX_BUSY_FRAME) {
+          this->metrics_->bus_busy++;
+          continue;
+        }
+        else {
+          // Line noise or a lost frame start, dropped until the next control byte
+          if (!this->rx_task_running()) {
+            KNX_TRACE("Unknown TPUART byte 0x%02X", incomingByte);
+          }
+          continue;
+        }
+      }
+
+      this->rx_buffer_[this->rx_index_++] = incomingByte;
+      if (this->rx_index_ == KNX_RX_ADDRESSED_SIZE) {
+        this->rx_acknowledge();
+      }
+      if (this->rx_index_ == this->rx_length_ && this->rx_index_ <= KNX_EXTENDED_TELEGRAM_HEADER_SIZE) {
+        // Header complete: header + payload + checksum, followed by the UART CRC in CRC mode
+        if (this->rx_buffer_[0] & 0b10000000) {
+          this->rx_length_ = KNX_TELEGRAM_HEADER_SIZE + (this->rx_buffer_[5] & 0b00001111) + 1 + 1;
+        }
+        else if (this->rx_buffer_[6] > MAX_KNX_EXTENDED_PAYLOAD_SIZE - 1) {
+          // Longer than any buffer on the way, the frame cannot be valid
+          this->rx_reset();
+          this->rx_deliver(TPUART_RX_EVENT_INVALID_LENGTH, KNX_EXTENDED_TELEGRAM_HEADER_SIZE);
+          continue;
+        }
+        else {
+          this->rx_length_ = KNX_EXTENDED_TELEGRAM_HEADER_SIZE + this->rx_buffer_[6] + 1 + 1;
+        }
+        if (this->crc_active_) {
+          this->rx_length_ += TPUART_CRC_SIZE;
+        }
+      }
+      if (this->rx_index_ < this->rx_length_) {
+        continue;
+      }
+
+      int length = this->rx_length_;
+      this->rx_reset();
+      if (this->crc_active_) {
+        length -= TPUART_CRC_SIZE;
+        uint16_t crc = (this->rx_buffer_[length] << 8) | this->rx_buffer_[length + 1];
+        if (crc != crc_ccitt(this->rx_buffer_, length)) {
+          // Corrupted between the transceiver and us, the bus checksum cannot be trusted either
+          this->rx_deliver(TPUART_RX_EVENT_CRC_ERROR, 0);
+          continue;
+        }
+      }
+      return this->rx_deliver(TPUART_RX_EVENT_FRAME, length);
+    }
+    return UNKNOWN;
+  }
+
+  // Hands a result of the receive path to the component, through the ring while the receive task runs
+  KnxComponentserial_eventType KnxTpuartTransport::rx_deliver(TpuartRxEventType type, int length) {
+#ifdef USE_KNX_RX_TASK
+    if (this->rx_task_ != nullptr) {
+      TpuartRxEvent *event = this->rx_ring_.claim();
+      if (event == nullptr) {
+        this->rx_overflow_ |= TPUART_OVERFLOW_RING;
+        this->metrics_->rx_overflows++;
+        return UNKNOWN;
+      }
+      event->type = type;
+      event->interested = this->rx_interested_;
+      event->length = length;
+      event->timestamp_us = this->rx_last_byte_us_;
+      memcpy(event->frame, this->rx_buffer_, length);
+      this->rx_ring_.push();
+      return UNKNOWN;
+    }
+#endif
+    return this->rx_dispatch(type, this->rx_buffer_, length, this->rx_interested_, this->rx_last_byte_us_);
+  }
+
+  KnxComponentserial_eventType KnxTpuartTransport::rx_dispatch(TpuartRxEventType type, const uint8_t *frame, int length,
+                                                               bool interested, uint32_t timestamp_us) {
+    switch (type) {
+      case TPUART_RX_EVENT_CONFIRMED:
+        this->component_->tx_complete(KNX_TX_CONFIRMED);
+        return UNKNOWN;
+      case TPUART_RX_EVENT_NACKED:
+        this->component_->tx_complete(KNX_TX_NACKED);
+        return UNKNOWN;
+      case TPUART_RX_EVENT_CRC_ERROR:
+        ESP_LOGW(TAG, "Telegram with invalid UART CRC, discarding.");
+        this->metrics_->rx_checksum_errors++;
+        return UNKNOWN;
+      case TPUART_RX_EVENT_INVALID_LENGTH:
+        ESP_LOGW(TAG, "Extended telegram with invalid length %u, discarding.", frame[6]);
+        this->metrics_->rx_checksum_errors++;
+        return UNKNOWN;
+      case TPUART_RX_EVENT_INCOMPLETE:
+        ESP_LOGW(TAG, "Incomplete telegram (%d bytes), discarding.", length);
+        this->metrics_->rx_timeouts++;
+        return UNKNOWN;
+      case TPUART_RX_EVENT_RESET:
+        ESP_LOGD(TAG, "Event TPUART_RESET_INDICATION");
+        this->metrics_->tpuart_resets++;
+        return TPUART_RESET_INDICATION;
+      case TPUART_RX_EVENT_TRANSCEIVER:
+        // Written before the event was pushed
+        if (this->uart_crc_ && !this->crc_active_) {
+          ESP_LOGW(TAG, "UART CRC mode needs a TP-UART2, the %s is used without it.", transceiver_name(this->chip_));
+        }
+        ESP_LOGI(TAG, "Transceiver %s, ACK for our address by %s", transceiver_name(this->chip_),
+          this->address_ack_ ? "the transceiver" : "software");
+        return UNKNOWN;
+      default:
+        return this->component_->receive_frame(frame, length, interested, timestamp_us);
+    }
+  }
+
+#ifdef USE_KNX_RX_TASK
+  // Same result as receive() from loop(): everything queued up to and including the next telegram or reset
+  KnxComponentserial_eventType KnxTpuartTransport::poll_rx_ring() {
+    TpuartRxEvent *event;
+    while ((event = this->rx_ring_.front()) != nullptr) {
+      KnxComponentserial_eventType result = this->rx_dispatch(event->type, event->frame, event->length,
+                                                              event->interested, event->timestamp_us);
+      this->rx_ring_.pop();
+      if (result != UNKNOWN) {
+        return result;
+      }
+    }
+    return UNKNOWN;
+  }
+
+  void KnxTpuartTransport::rx_task(void *arg) {
+    KnxTpuartTransport *transport = static_cast<KnxTpuartTransport *>(arg);
+    while (true) {
+      transport->receive();
+      if (transport->available() == 0) {
+        vTaskDelay(1);
+      }
+    }
+  }
+#endif
+
+  void KnxTpuartTransport::log_overflow() {
+    if (this->rx_overflow_ == 0) {
+      return;
+    }
+    uint8_t overflow = this->rx_overflow_;
+    this->rx_overflow_ &= ~overflow;
+    if (overflow & TPUART_OVERFLOW_UART) {
+      ESP_LOGW(TAG, "UART receive buffer full, telegrams may have been lost.");
+    }
+    if (overflow & TPUART_OVERFLOW_RING) {
+      ESP_LOGW(TAG, "Receive ring full, telegrams have been dropped.");
+    }
+  }
+
+  void KnxTpuartTransport::rx_reset() {
+    this->rx_state_ = TPUART_RX_IDLE;
+    this->rx_index_ = 0;
+    this->rx_length_ = 0;
+  }
+
+  // Decides whether the frame is for us as soon as both addresses are in and asks the TPUART to acknowledge it.
+  // The request is only honoured before the frame ends, so this must not wait for the payload or the checksum.
+  void KnxTpuartTransport::rx_acknowledge() {
+    this->rx_interested_ = this->component_->accepts_frame(this->rx_buffer_);
+    bool extended = !(this->rx_buffer_[0] & 0b10000000);
+    bool group = (extended ? this->rx_buffer_[1] : this->rx_buffer_[5]) & 0b10000000;
+    if (!group && this->address_ack_) {
+      // Acknowledged by the transceiver itself
+      return;
+    }
+    if (this->rx_interested_) {
+      this->send_ack();
+      this->metrics_->acks_sent++;
+    }
+    else {
+      this->send_not_addressed();
+      this->metrics_->not_addressed_sent++;
+    }
+  }
+
+  bool KnxTpuartTransport::is_knx_control_byte(int b) {
+    return ( (b | 0b00101100) == 0b10111100 )  // Standard frame, ignore repeat flag and priority flag
+        || ( (b | 0b00101100) == 0b00111100 ); // Extended frame
+  }
+
+  void KnxTpuartTransport::check_errors() {
+    this->check_uart_settings(19200, 1, esphome::uart::UARTParityOptions::UART_CONFIG_PARITY_EVEN, 8);
+  }
+
+  void KnxTpuartTransport::send(KnxTelegram* telegram) {
+    TPUART_TX_LOCK();
+    int messageSize = telegram->get_total_length();
+    const uint8_t *data = telegram->data();
+
+    // Every byte is preceded by its U_L_DataStart/Continue/End service, which carries a 6 bit index.
+    // Standard frames go out in one call, extended frames select each further 64 byte block with U_L_DataOffset.
+    uint8_t sendbuf[2 * TPUART_DATA_BLOCK_SIZE + 1];
+    int pos = 0;
+    for (int i = 0; i < messageSize; i++) {
+      if (i > 0 && (i % TPUART_DATA_BLOCK_SIZE) == 0) {
+        this->write_array(sendbuf, pos);
+        pos = 0;
+        sendbuf[pos++] = TPUART_DATA_OFFSET | (i / TPUART_DATA_BLOCK_SIZE);
+      }
+      sendbuf[pos++] = (i == (messageSize - 1) ? TPUART_DATA_END : TPUART_DATA_START_CONTINUE) | (i % TPUART_DATA_BLOCK_SIZE);
+      sendbuf[pos++] = data[i];
+    }
+    this->write_array(sendbuf, pos);
+  }
+
+  void KnxTpuartTransport::send_ack() {
+    TPUART_TX_LOCK();
+    this->write(TPUART_ACK_INFORMATION | TPUART_ACK_ADDRESSED | (this->busy_mode_ ? TPUART_ACK_BUSY : 0));
+  }
+
+  void KnxTpuartTransport::send_not_addressed() {
+    TPUART_TX_LOCK();
+    this->write(TPUART_ACK_INFORMATION);
+  }
+
+}  // namespace knx
+}  // namespace esphome
+
+#endif  // USE_KNX_TPUART
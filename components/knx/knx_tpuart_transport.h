@@ -0,0 +1,214 @@
+// Author: Dulgheru Mihaita (Since 2022)
+
+#pragma once
+
+#include "esphome/core/defines.h"
+#ifdef USE_KNX_TPUART
+
+#include "esphome/core/helpers.h"
+#include "esphome/components/uart/uart.h"
+#include "knx_transport.h"
+#ifdef USE_KNX_RX_TASK
+#include <atomic>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include "knx_spsc_ring.h"
+#endif
+
+namespace esphome {
+namespace knx {
+
+// Services to the transceiver
+inline constexpr uint8_t TPUART_RESET_REQUEST = 0x01;
+inline constexpr uint8_t TPUART_STATE_REQUEST = 0x02;
+inline constexpr uint8_t TPUART_ACK_INFORMATION = 0b00010000;  // | busy << 1 | addressed
+inline constexpr uint8_t TPUART_ACK_ADDRESSED = 0b00000001;
+inline constexpr uint8_t TPUART_ACK_BUSY = 0b00000010;
+inline constexpr uint8_t TPUART_STATE_INDICATION_MASK = 0b00000111;
+// Acknowledge frames of other devices, passed on as they are seen on the bus
+inline constexpr uint8_t KNX_ACK_FRAME = 0xCC;
+inline constexpr uint8_t KNX_NACK_FRAME = 0x0C;
+inline constexpr uint8_t KNX_BUSY_FRAME = 0xC0;
+// TP-UART2 extended services
+inline constexpr uint8_t TPUART2_PRODUCT_ID_REQUEST = 0x20;
+// U_ProductID.response: product 010 in the top 3 bits, the version below
+inline constexpr uint8_t TPUART2_PRODUCT_ID_MASK = 0b11100000;
+inline constexpr uint8_t TPUART2_PRODUCT_ID_RESPONSE = 0b01000000;
+inline constexpr uint8_t TPUART2_ACTIVATE_BUSY_MODE = 0x21;
+inline constexpr uint8_t TPUART2_RESET_BUSY_MODE = 0x22;
+inline constexpr uint8_t TPUART2_ACTIVATE_CRC = 0x25;
+inline constexpr uint8_t TPUART2_SET_ADDRESS = 0x28;
+// NCN5120 / NCN5130 services
+inline constexpr uint8_t NCN5120_SET_BUSY = 0x03;
+inline constexpr uint8_t NCN5120_QUIT_BUSY = 0x04;
+inline constexpr uint8_t NCN5120_SYSTEM_STAT_REQUEST = 0x0D;
+inline constexpr uint8_t NCN5120_SYSTEM_STAT_INDICATION = 0x4B;
+inline constexpr uint8_t NCN5120_SET_ADDRESS = 0xF1;
+// How long each probe request waits for its answer after a reset
+inline constexpr uint32_t TPUART_PROBE_TIMEOUT_MS = 100;
+// CRC-CCITT appended by a TP-UART2 in CRC mode to every frame it passes on
+inline constexpr int TPUART_CRC_SIZE = 2;
+inline constexpr uint8_t TPUART_DATA_START_CONTINUE = 0b10000000;
+inline constexpr uint8_t TPUART_DATA_END = 0b01000000;
+inline constexpr uint8_t TPUART_DATA_OFFSET = 0b00001000;
+inline constexpr int TPUART_DATA_BLOCK_SIZE = 64;
+// Services from TPUART
+inline constexpr uint8_t TPUART_RESET_INDICATION_BYTE = 0b11;
+inline constexpr uint8_t TPUART_DATA_CONFIRM_SUCCESS = 0b10001011;
+inline constexpr uint8_t TPUART_DATA_CONFIRM_FAILED = 0b00001011;
+// TP1 runs at 9600 bit/s. Characters of one frame are separated by 2 bit times of idle,
+// so a frame that stays silent for longer than 50 bit times has been aborted by the sender.
+inline constexpr uint32_t KNX_TP1_BIT_TIME_US = 104;
+inline constexpr uint32_t TPUART_RX_GAP_TIMEOUT_US = 50 * KNX_TP1_BIT_TIME_US;
+// The ACK request is written once the first KNX_RX_ADDRESSED_SIZE bytes (control fields and both addresses) are in.
+// The shortest frame still has 2 characters of 13 bit times on the bus after that, and the request is one
+// 11 bit character on the 19200 baud UART, so it reaches the TPUART well before the frame ends.
+inline constexpr int KNX_RX_ADDRESSED_SIZE = 6;
+inline constexpr uint32_t TPUART_ACK_WINDOW_US = 2 * 13 * KNX_TP1_BIT_TIME_US;
+inline constexpr uint32_t TPUART_UART_CHAR_US = 11 * 1000000 / 19200;
+static_assert(KNX_RX_ADDRESSED_SIZE <= KNX_TELEGRAM_HEADER_SIZE, "addressing must be decided before the shortest frame ends");
+static_assert(TPUART_UART_CHAR_US < TPUART_ACK_WINDOW_US, "ACK request does not fit the acknowledge window");
+
+enum KnxTransceiverType {
+  KNX_TRANSCEIVER_AUTO,      // Detected after the reset, also used while not yet known
+  KNX_TRANSCEIVER_TPUART,    // Siemens TPUART, every ACK is sent by us
+  KNX_TRANSCEIVER_TPUART2,
+  KNX_TRANSCEIVER_NCN5120    // Also NCN5130
+};
+
+enum TpuartProbeState {
+  TPUART_PROBE_NONE,
+  TPUART_PROBE_PRODUCT_ID,         // U_ProductID sent, only a TP-UART2 answers
+  TPUART_PROBE_SYSTEM_STAT,        // U_SystemStat sent, only an NCN5120 answers
+  TPUART_PROBE_SYSTEM_STAT_VALUE   // U_SystemStat.ind received, its value follows
+};
+
+// What the receive path hands to the component, through KnxTpuartTransport::rx_deliver().
+// Everything that is logged or counted on the component's side goes this way, so the receive task never logs.
+enum TpuartRxEventType : uint8_t {
+  TPUART_RX_EVENT_FRAME,
+  TPUART_RX_EVENT_CONFIRMED,
+  TPUART_RX_EVENT_NACKED,
+  TPUART_RX_EVENT_CRC_ERROR,
+  TPUART_RX_EVENT_INVALID_LENGTH,  // Extended frame header, discarded
+  TPUART_RX_EVENT_INCOMPLETE,      // The bytes received before the gap
+  TPUART_RX_EVENT_RESET,
+  TPUART_RX_EVENT_TRANSCEIVER      // Detected or configured after a reset
+};
+
+// Overflows seen by the receive path, logged by poll()
+inline constexpr uint8_t TPUART_OVERFLOW_UART = 0b01;
+inline constexpr uint8_t TPUART_OVERFLOW_RING = 0b10;
+
+#ifdef USE_KNX_RX_TASK
+// The idle receive task sleeps one tick between reads, longer would miss the acknowledge window.
+// __init__.py sets CONFIG_FREERTOS_HZ to 1000 on ESP-IDF, Arduino is built with it.
+static_assert(configTICK_RATE_HZ >= 1000, "the knx receive task needs CONFIG_FREERTOS_HZ set to 1000");
+inline constexpr uint32_t TPUART_RX_RING_SIZE = 8;
+inline constexpr uint32_t TPUART_RX_TASK_STACK_SIZE = 4096;
+
+struct TpuartRxEvent {
+  TpuartRxEventType type;
+  bool interested;
+  uint16_t length;
+  uint32_t timestamp_us;
+  uint8_t frame[MAX_KNX_EXTENDED_TELEGRAM_SIZE];
+};
+#endif
+
+enum TpuartRxState {
+  TPUART_RX_IDLE,   // Waiting for a control byte
+  TPUART_RX_FRAME   // Collecting the bytes of a telegram
+};
+
+// TP1 line through a TPUART compatible transceiver on a UART (19200 baud, 8E1).
+// TP-UART2 and NCN5120 are given our individual address and acknowledge frames for it themselves,
+// group frames are still acknowledged by us while they are received.
+class KnxTpuartTransport : public KnxTransport, public uart::UARTDevice {
+  public:
+    KnxTpuartTransport() = default;
+    KnxTpuartTransport(uart::UARTComponent *uart) : uart::UARTDevice(uart) {}
+    void set_transceiver(KnxTransceiverType transceiver) { this->transceiver_ = transceiver; }
+    // TP-UART2 only: frames from the transceiver carry a CRC-CCITT over the UART
+    void set_uart_crc(bool uart_crc) { this->uart_crc_ = uart_crc; }
+#ifdef USE_KNX_RX_TASK
+    // Receives and acknowledges in a task pinned to core instead of in loop(), set before setup()
+    void set_rx_task(int core, int priority) {
+      this->rx_task_core_ = core;
+      this->rx_task_priority_ = priority;
+    }
+#endif
+    KnxTransceiverType get_transceiver() { return this->chip_; }
+    void setup() override;
+    void dump_config() override;
+    KnxComponentserial_eventType poll() override;
+    bool input_pending() override;
+    void send(KnxTelegram *telegram) override;
+    // Do not interleave our frame with one that is still being received. With the receive task this
+    // reads state owned by the task, a frame starting right now is caught by the TPUART arbitration.
+    bool ready_to_send() override { return this->rx_state_ == TPUART_RX_IDLE; }
+
+    void uart_reset();
+    void uart_state_request();
+    void send_ack();
+    void send_not_addressed();
+    // Frames for us are answered with BUSY, so the sender repeats them later
+    void set_busy_mode(bool busy);
+
+  protected:
+    // Receive state machine, kept between loop() calls
+    TpuartRxState rx_state_{TPUART_RX_IDLE};
+    uint8_t rx_buffer_[MAX_KNX_EXTENDED_TELEGRAM_SIZE + TPUART_CRC_SIZE];
+    uint16_t rx_index_{0};
+    uint16_t rx_length_{0};
+    uint32_t rx_last_byte_us_{0};
+    bool rx_interested_{false};         // ACK requested for the frame being received
+    bool rx_full_{false};               // UART receive buffer was full at the last check
+    HighFrequencyLoopRequester high_freq_;  // Held from setup() on unless the receive task runs
+
+    KnxTransceiverType transceiver_{KNX_TRANSCEIVER_AUTO};  // As configured
+    KnxTransceiverType chip_{KNX_TRANSCEIVER_AUTO};         // As detected, kept over resets
+    TpuartProbeState probe_{TPUART_PROBE_NONE};
+    uint32_t probe_ms_{0};
+    bool address_ack_{false};    // The transceiver acknowledges frames for our individual address
+    bool uart_crc_{false};
+    bool crc_active_{false};
+    bool busy_mode_{false};
+
+#ifdef USE_KNX_RX_TASK
+    // The task owns the receive state machine, the metrics it counts and the probe; loop() only reads the ring.
+    // UART writes and the transceiver state are shared and taken under tx_lock_.
+    int rx_task_core_{-1};
+    int rx_task_priority_{5};
+    TaskHandle_t rx_task_{nullptr};
+    KnxSpscRing<TpuartRxEvent, TPUART_RX_RING_SIZE> rx_ring_;
+    std::atomic<uint8_t> rx_overflow_{0};
+    Mutex tx_lock_;
+    static void rx_task(void *arg);
+    KnxComponentserial_eventType poll_rx_ring();
+    bool rx_task_running() { return this->rx_task_ != nullptr; }
+#else
+    uint8_t rx_overflow_{0};
+    bool rx_task_running() { return false; }
+#endif
+
+    KnxComponentserial_eventType receive();
+    KnxComponentserial_eventType rx_deliver(TpuartRxEventType type, int length);
+    KnxComponentserial_eventType rx_dispatch(TpuartRxEventType type, const uint8_t *frame, int length, bool interested,
+                                             uint32_t timestamp_us);
+    void rx_reset();
+    void rx_acknowledge();
+    bool is_knx_control_byte(int);
+    void check_errors();
+    void configure_transceiver();
+    void probe_timeout();
+    bool probe_response(uint8_t);
+    void apply_transceiver(KnxTransceiverType);
+    void write_busy_mode();
+    void log_overflow();
+};
+
+}  // namespace knx
+}  // namespace esphome
+
+#endif  // USE_KNX_TPUART
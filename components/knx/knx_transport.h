@@ -0,0 +1,51 @@
+// Author: Dulgheru Mihaita (Since 2022)
+
+#pragma once
+
+#include <cstdint>
+#include "knx_telegram.h"
+
+namespace esphome {
+namespace knx {
+
+class KnxComponent;
+struct KnxMetrics;
+
+enum KnxComponentserial_eventType {
+  TPUART_RESET_INDICATION,
+  KNX_TELEGRAM,
+  IRRELEVANT_KNX_TELEGRAM,
+  UNKNOWN
+};
+
+// Carries telegrams between KnxComponent and the bus. Complete frames are handed to
+// KnxComponent::receive_frame(), the outcome of send() is reported through KnxComponent::tx_complete().
+class KnxTransport {
+  public:
+    virtual ~KnxTransport() = default;
+    void set_parent(KnxComponent *parent, KnxMetrics *metrics) {
+      this->component_ = parent;
+      this->metrics_ = metrics;
+    }
+
+    virtual void setup() {}
+    virtual void dump_config() {}
+    virtual void on_shutdown() {}
+    // Processes what arrived since the last call and returns after the first complete frame, or with UNKNOWN
+    // once nothing is left. KnxComponent calls it again within its receive budget.
+    virtual KnxComponentserial_eventType poll() = 0;
+    // Something is buffered that poll() would process right away
+    virtual bool input_pending() { return false; }
+    // Called only while ready_to_send(), one telegram at a time
+    virtual void send(KnxTelegram *telegram) = 0;
+    virtual bool ready_to_send() = 0;
+    // Shortest time send() may take to report its outcome, serial_timeout applies when it is longer
+    virtual uint32_t confirm_timeout_ms() { return 0; }
+
+  protected:
+    KnxComponent *component_{nullptr};
+    KnxMetrics *metrics_{nullptr};
+};
+
+}  // namespace knx
+}  // namespace esphome
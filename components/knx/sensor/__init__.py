@@ -0,0 +1,133 @@
+import esphome.codegen as cg
+import esphome.config_validation as cv
+from esphome.components import sensor
+from esphome.const import (
+    CONF_ID,
+    UNIT_PERCENT,
+    ENTITY_CATEGORY_DIAGNOSTIC,
+    STATE_CLASS_MEASUREMENT,
+    STATE_CLASS_TOTAL_INCREASING,
+)
+
+from .. import CONF_KNX_ID, knx_component, knx_ns
+
+DEPENDENCIES = ["knx"]
+
+KnxSensor = knx_ns.class_("KnxSensor", cg.PollingComponent)
+
+UNIT_FRAMES = "frames"
+UNIT_TELEGRAMS = "telegrams"
+UNIT_ACKS = "acks"
+UNIT_RESETS = "resets"
+UNIT_OVERFLOWS = "overflows"
+UNIT_LOOPS = "loops"
+UNIT_MICROSECONDS = "µs"
+
+# Counters, published as totals since boot: setter and unit
+COUNTERS = {
+    "frames_received": ("set_frames_received_sensor", UNIT_FRAMES),
+    "frames_accepted": ("set_frames_accepted_sensor", UNIT_FRAMES),
+    "frames_filtered": ("set_frames_filtered_sensor", UNIT_FRAMES),
+    "duplicates": ("set_duplicates_sensor", UNIT_FRAMES),
+    "checksum_errors": ("set_checksum_errors_sensor", UNIT_FRAMES),
+    # Frames cut short by a gap on the bus
+    "incomplete_frames": ("set_incomplete_frames_sensor", UNIT_FRAMES),
+    # ACK requests written to the TPUART, and acknowledge frames of other devices on the bus
+    "acks": ("set_acks_sensor", UNIT_ACKS),
+    "not_addressed": ("set_not_addressed_sensor", UNIT_ACKS),
+    "bus_acks": ("set_bus_acks_sensor", UNIT_FRAMES),
+    "bus_nacks": ("set_bus_nacks_sensor", UNIT_FRAMES),
+    "bus_busy": ("set_bus_busy_sensor", UNIT_FRAMES),
+    "tx_confirmed": ("set_tx_confirmed_sensor", UNIT_TELEGRAMS),
+    "tx_failed": ("set_tx_failed_sensor", UNIT_TELEGRAMS),
+    "tx_timed_out": ("set_tx_timed_out_sensor", UNIT_TELEGRAMS),
+    "tx_suppressed": ("set_tx_suppressed_sensor", UNIT_TELEGRAMS),
+    "tpuart_resets": ("set_tpuart_resets_sensor", UNIT_RESETS),
+    "rx_overflows": ("set_rx_overflows_sensor", UNIT_OVERFLOWS),
+    "budget_exhausted": ("set_budget_exhausted_sensor", UNIT_LOOPS),
+    "routed_to_ip": ("set_routed_to_ip_sensor", UNIT_FRAMES),
+    "routed_to_tp": ("set_routed_to_tp_sensor", UNIT_FRAMES),
+    "routing_lost": ("set_routing_lost_sensor", UNIT_FRAMES),
+}
+# Former name of incomplete_frames, easily taken for the serial_timeout of the knx component
+CONF_SERIAL_TIMEOUTS = "serial_timeouts"
+CONF_QUEUE_DEPTH = "queue_depth"
+CONF_MAX_LOOP_TIME = "max_loop_time"
+# Rates from the bus monitor, which has to be enabled on the knx component
+CONF_BUS_LOAD = "bus_load"
+CONF_BITS_PER_SECOND = "bits_per_second"
+CONF_FRAMES_PER_SECOND = "frames_per_second"
+
+CONFIG_SCHEMA = cv.All(
+    cv.Schema(
+        {
+            cv.GenerateID(): cv.declare_id(KnxSensor),
+            cv.GenerateID(CONF_KNX_ID): cv.use_id(knx_component),
+            **{
+                cv.Optional(counter): sensor.sensor_schema(
+                    unit_of_measurement=unit,
+                    accuracy_decimals=0,
+                    state_class=STATE_CLASS_TOTAL_INCREASING,
+                    entity_category=ENTITY_CATEGORY_DIAGNOSTIC,
+                )
+                for counter, (_, unit) in COUNTERS.items()
+            },
+            cv.Optional(CONF_SERIAL_TIMEOUTS): sensor.sensor_schema(
+                unit_of_measurement=UNIT_FRAMES,
+                accuracy_decimals=0,
+                state_class=STATE_CLASS_TOTAL_INCREASING,
+                entity_category=ENTITY_CATEGORY_DIAGNOSTIC,
+            ),
+            cv.Optional(CONF_QUEUE_DEPTH): sensor.sensor_schema(
+                accuracy_decimals=0,
+                state_class=STATE_CLASS_MEASUREMENT,
+                entity_category=ENTITY_CATEGORY_DIAGNOSTIC,
+            ),
+            cv.Optional(CONF_MAX_LOOP_TIME): sensor.sensor_schema(
+                unit_of_measurement=UNIT_MICROSECONDS,
+                accuracy_decimals=0,
+                state_class=STATE_CLASS_MEASUREMENT,
+                entity_category=ENTITY_CATEGORY_DIAGNOSTIC,
+            ),
+            cv.Optional(CONF_BUS_LOAD): sensor.sensor_schema(
+                unit_of_measurement=UNIT_PERCENT,
+                accuracy_decimals=1,
+                state_class=STATE_CLASS_MEASUREMENT,
+                entity_category=ENTITY_CATEGORY_DIAGNOSTIC,
+            ),
+            cv.Optional(CONF_BITS_PER_SECOND): sensor.sensor_schema(
+                unit_of_measurement="bit/s",
+                accuracy_decimals=0,
+                state_class=STATE_CLASS_MEASUREMENT,
+                entity_category=ENTITY_CATEGORY_DIAGNOSTIC,
+            ),
+            cv.Optional(CONF_FRAMES_PER_SECOND): sensor.sensor_schema(
+                unit_of_measurement="frames/s",
+                accuracy_decimals=1,
+                state_class=STATE_CLASS_MEASUREMENT,
+                entity_category=ENTITY_CATEGORY_DIAGNOSTIC,
+            ),
+        }
+    ).extend(cv.polling_component_schema("60s")),
+    cv.has_at_most_one_key("incomplete_frames", CONF_SERIAL_TIMEOUTS),
+)
+
+
+async def to_code(config):
+    parent = await cg.get_variable(config[CONF_KNX_ID])
+    var = cg.new_Pvariable(config[CONF_ID], parent)
+    await cg.register_component(var, config)
+
+    setters = {
+        **{counter: setter for counter, (setter, _) in COUNTERS.items()},
+        CONF_SERIAL_TIMEOUTS: "set_incomplete_frames_sensor",
+        CONF_QUEUE_DEPTH: "set_queue_depth_sensor",
+        CONF_MAX_LOOP_TIME: "set_max_loop_time_sensor",
+        CONF_BUS_LOAD: "set_bus_load_sensor",
+        CONF_BITS_PER_SECOND: "set_bits_per_second_sensor",
+        CONF_FRAMES_PER_SECOND: "set_frames_per_second_sensor",
+    }
+    for key, setter in setters.items():
+        if key in config:
+            sens = await sensor.new_sensor(config[key])
+            cg.add(getattr(var, setter)(sens))
@@ -0,0 +1,87 @@
+#include "knx_sensor.h"
+#include "esphome/core/log.h"
+
+namespace esphome {
+namespace knx {
+
+  static void publish(sensor::Sensor *sensor, uint32_t value) {
+    if (sensor != nullptr) {
+      sensor->publish_state(value);
+    }
+  }
+
+  void KnxSensor::update() {
+    const KnxMetrics &metrics = this->parent_->get_metrics();
+    publish(this->frames_received_sensor_, metrics.rx_frames);
+    publish(this->frames_accepted_sensor_, metrics.rx_accepted);
+    publish(this->frames_filtered_sensor_, metrics.rx_filtered);
+    publish(this->duplicates_sensor_, metrics.rx_duplicates);
+    publish(this->checksum_errors_sensor_, metrics.rx_checksum_errors);
+    publish(this->incomplete_frames_sensor_, metrics.rx_timeouts);
+    publish(this->acks_sensor_, metrics.acks_sent);
+    publish(this->not_addressed_sensor_, metrics.not_addressed_sent);
+    publish(this->bus_acks_sensor_, metrics.bus_acks);
+    publish(this->bus_nacks_sensor_, metrics.bus_nacks);
+    publish(this->bus_busy_sensor_, metrics.bus_busy);
+    publish(this->tx_confirmed_sensor_, metrics.tx_confirmed);
+    publish(this->tx_failed_sensor_, metrics.tx_failed);
+    publish(this->tx_timed_out_sensor_, metrics.tx_timed_out);
+    publish(this->tx_suppressed_sensor_, metrics.tx_suppressed);
+    publish(this->tpuart_resets_sensor_, metrics.tpuart_resets);
+    publish(this->rx_overflows_sensor_, metrics.rx_overflows);
+    publish(this->budget_exhausted_sensor_, metrics.rx_budget_exhausted);
+    publish(this->routed_to_ip_sensor_, metrics.routed_to_ip);
+    publish(this->routed_to_tp_sensor_, metrics.routed_to_tp);
+    publish(this->routing_lost_sensor_, metrics.routing_lost);
+    publish(this->queue_depth_sensor_, this->parent_->get_tx_queue_depth());
+    // The maximum is taken per update interval
+    publish(this->max_loop_time_sensor_, this->parent_->take_max_loop_time_us());
+
+    // Rates are refreshed at the bus monitor interval
+    KnxBusMonitor *monitor = this->parent_->get_bus_monitor();
+    if (monitor != nullptr) {
+      if (this->bus_load_sensor_ != nullptr) {
+        this->bus_load_sensor_->publish_state(monitor->get_bus_load());
+      }
+      if (this->bits_per_second_sensor_ != nullptr) {
+        this->bits_per_second_sensor_->publish_state(monitor->get_bits_per_second());
+      }
+      if (this->frames_per_second_sensor_ != nullptr) {
+        this->frames_per_second_sensor_->publish_state(monitor->get_frames_per_second());
+      }
+    }
+  }
+
+  void KnxSensor::dump_config() {
+    ESP_LOGCONFIG(TAG, "Knx Sensor:");
+    LOG_UPDATE_INTERVAL(this);
+    LOG_SENSOR("  ", "Frames Received", this->frames_received_sensor_);
+    LOG_SENSOR("  ", "Frames Accepted", this->frames_accepted_sensor_);
+    LOG_SENSOR("  ", "Frames Filtered", this->frames_filtered_sensor_);
+    LOG_SENSOR("  ", "Duplicates", this->duplicates_sensor_);
+    LOG_SENSOR("  ", "Checksum Errors", this->checksum_errors_sensor_);
+    LOG_SENSOR("  ", "Incomplete Frames", this->incomplete_frames_sensor_);
+    LOG_SENSOR("  ", "ACKs", this->acks_sensor_);
+    LOG_SENSOR("  ", "Not Addressed", this->not_addressed_sensor_);
+    LOG_SENSOR("  ", "Bus ACKs", this->bus_acks_sensor_);
+    LOG_SENSOR("  ", "Bus NACKs", this->bus_nacks_sensor_);
+    LOG_SENSOR("  ", "Bus BUSY", this->bus_busy_sensor_);
+    LOG_SENSOR("  ", "TX Confirmed", this->tx_confirmed_sensor_);
+    LOG_SENSOR("  ", "TX Failed", this->tx_failed_sensor_);
+    LOG_SENSOR("  ", "TX Timed Out", this->tx_timed_out_sensor_);
+    LOG_SENSOR("  ", "TX Suppressed", this->tx_suppressed_sensor_);
+    LOG_SENSOR("  ", "TPUART Resets", this->tpuart_resets_sensor_);
+    LOG_SENSOR("  ", "RX Overflows", this->rx_overflows_sensor_);
+    LOG_SENSOR("  ", "Budget Exhausted", this->budget_exhausted_sensor_);
+    LOG_SENSOR("  ", "Routed To IP", this->routed_to_ip_sensor_);
+    LOG_SENSOR("  ", "Routed To TP", this->routed_to_tp_sensor_);
+    LOG_SENSOR("  ", "Routing Lost", this->routing_lost_sensor_);
+    LOG_SENSOR("  ", "Queue Depth", this->queue_depth_sensor_);
+    LOG_SENSOR("  ", "Max Loop Time", this->max_loop_time_sensor_);
+    LOG_SENSOR("  ", "Bus Load", this->bus_load_sensor_);
+    LOG_SENSOR("  ", "Bits Per Second", this->bits_per_second_sensor_);
+    LOG_SENSOR("  ", "Frames Per Second", this->frames_per_second_sensor_);
+  }
+
+}  // namespace knx
+}  // namespace esphome
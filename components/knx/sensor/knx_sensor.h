@@ -0,0 +1,75 @@
+#pragma once
+
+#include "esphome/core/component.h"
+#include "esphome/components/sensor/sensor.h"
+#include "esphome/components/knx/knx_component.h"
+
+namespace esphome {
+namespace knx {
+
+// Publishes the KnxComponent counters, each sensor is optional
+class KnxSensor : public PollingComponent {
+  public:
+    KnxSensor(KnxComponent *parent) : parent_(parent) {}
+    void update() override;
+    void dump_config() override;
+
+    void set_frames_received_sensor(sensor::Sensor *sensor) { this->frames_received_sensor_ = sensor; }
+    void set_frames_accepted_sensor(sensor::Sensor *sensor) { this->frames_accepted_sensor_ = sensor; }
+    void set_frames_filtered_sensor(sensor::Sensor *sensor) { this->frames_filtered_sensor_ = sensor; }
+    void set_duplicates_sensor(sensor::Sensor *sensor) { this->duplicates_sensor_ = sensor; }
+    void set_checksum_errors_sensor(sensor::Sensor *sensor) { this->checksum_errors_sensor_ = sensor; }
+    void set_incomplete_frames_sensor(sensor::Sensor *sensor) { this->incomplete_frames_sensor_ = sensor; }
+    void set_acks_sensor(sensor::Sensor *sensor) { this->acks_sensor_ = sensor; }
+    void set_not_addressed_sensor(sensor::Sensor *sensor) { this->not_addressed_sensor_ = sensor; }
+    void set_bus_acks_sensor(sensor::Sensor *sensor) { this->bus_acks_sensor_ = sensor; }
+    void set_bus_nacks_sensor(sensor::Sensor *sensor) { this->bus_nacks_sensor_ = sensor; }
+    void set_bus_busy_sensor(sensor::Sensor *sensor) { this->bus_busy_sensor_ = sensor; }
+    void set_tx_confirmed_sensor(sensor::Sensor *sensor) { this->tx_confirmed_sensor_ = sensor; }
+    void set_tx_failed_sensor(sensor::Sensor *sensor) { this->tx_failed_sensor_ = sensor; }
+    void set_tx_timed_out_sensor(sensor::Sensor *sensor) { this->tx_timed_out_sensor_ = sensor; }
+    void set_tx_suppressed_sensor(sensor::Sensor *sensor) { this->tx_suppressed_sensor_ = sensor; }
+    void set_tpuart_resets_sensor(sensor::Sensor *sensor) { this->tpuart_resets_sensor_ = sensor; }
+    void set_rx_overflows_sensor(sensor::Sensor *sensor) { this->rx_overflows_sensor_ = sensor; }
+    void set_budget_exhausted_sensor(sensor::Sensor *sensor) { this->budget_exhausted_sensor_ = sensor; }
+    void set_routed_to_ip_sensor(sensor::Sensor *sensor) { this->routed_to_ip_sensor_ = sensor; }
+    void set_routed_to_tp_sensor(sensor::Sensor *sensor) { this->routed_to_tp_sensor_ = sensor; }
+    void set_routing_lost_sensor(sensor::Sensor *sensor) { this->routing_lost_sensor_ = sensor; }
+    void set_queue_depth_sensor(sensor::Sensor *sensor) { this->queue_depth_sensor_ = sensor; }
+    void set_max_loop_time_sensor(sensor::Sensor *sensor) { this->max_loop_time_sensor_ = sensor; }
+    void set_bus_load_sensor(sensor::Sensor *sensor) { this->bus_load_sensor_ = sensor; }
+    void set_bits_per_second_sensor(sensor::Sensor *sensor) { this->bits_per_second_sensor_ = sensor; }
+    void set_frames_per_second_sensor(sensor::Sensor *sensor) { this->frames_per_second_sensor_ = sensor; }
+
+  protected:
+    KnxComponent *parent_;
+    sensor::Sensor *frames_received_sensor_{nullptr};
+    sensor::Sensor *frames_accepted_sensor_{nullptr};
+    sensor::Sensor *frames_filtered_sensor_{nullptr};
+    sensor::Sensor *duplicates_sensor_{nullptr};
+    sensor::Sensor *checksum_errors_sensor_{nullptr};
+    sensor::Sensor *incomplete_frames_sensor_{nullptr};
+    sensor::Sensor *acks_sensor_{nullptr};
+    sensor::Sensor *not_addressed_sensor_{nullptr};
+    sensor::Sensor *bus_acks_sensor_{nullptr};
+    sensor::Sensor *bus_nacks_sensor_{nullptr};
+    sensor::Sensor *bus_busy_sensor_{nullptr};
+    sensor::Sensor *tx_confirmed_sensor_{nullptr};
+    sensor::Sensor *tx_failed_sensor_{nullptr};
+    sensor::Sensor *tx_timed_out_sensor_{nullptr};
+    sensor::Sensor *tx_suppressed_sensor_{nullptr};
+    sensor::Sensor *tpuart_resets_sensor_{nullptr};
+    sensor::Sensor *rx_overflows_sensor_{nullptr};
+    sensor::Sensor *budget_exhausted_sensor_{nullptr};
+    sensor::Sensor *routed_to_ip_sensor_{nullptr};
+    sensor::Sensor *routed_to_tp_sensor_{nullptr};
+    sensor::Sensor *routing_lost_sensor_{nullptr};
+    sensor::Sensor *queue_depth_sensor_{nullptr};
+    sensor::Sensor *max_loop_time_sensor_{nullptr};
+    sensor::Sensor *bus_load_sensor_{nullptr};
+    sensor::Sensor *bits_per_second_sensor_{nullptr};
+    sensor::Sensor *frames_per_second_sensor_{nullptr};
+};
+
+}  // namespace knx
+}  // namespace esphome
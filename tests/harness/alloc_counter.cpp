@@ -0,0 +1,43 @@
+// Author: Dulgheru Mihaita (Since 2022)
+
+#include "alloc_counter.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+static std::atomic<uint64_t> allocations{0};
+static thread_local int uncounted = 0;
+
+void *operator new(std::size_t size) {
+  if (uncounted == 0) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+  }
+  void *memory = std::malloc(size == 0 ? 1 : size);
+  if (memory == nullptr) {
+    throw std::bad_alloc();
+  }
+  return memory;
+}
+
+void *operator new[](std::size_t size) { return operator new(size); }
+
+void operator delete(void *memory) noexcept { std::free(memory); }
+
+void operator delete[](void *memory) noexcept { std::free(memory); }
+
+void operator delete(void *memory, std::size_t) noexcept { std::free(memory); }
+
+void operator delete[](void *memory, std::size_t) noexcept { std::free(memory); }
+
+namespace esphome {
+namespace knx {
+
+  uint64_t get_allocation_count() { return allocations.load(std::memory_order_relaxed); }
+
+  UncountedAllocations::UncountedAllocations() { uncounted++; }
+
+  UncountedAllocations::~UncountedAllocations() { uncounted--; }
+
+}  // namespace knx
+}  // namespace esphome
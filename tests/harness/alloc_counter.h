@@ -0,0 +1,21 @@
+// Author: Dulgheru Mihaita (Since 2022)
+
+#pragma once
+
+#include <cstdint>
+
+namespace esphome {
+namespace knx {
+
+// Heap allocations of the whole program so far, alloc_counter.cpp replaces the global operator new
+uint64_t get_allocation_count();
+
+// Allocations of this thread are not counted while one exists, e.g. in the simulated transceiver
+class UncountedAllocations {
+  public:
+    UncountedAllocations();
+    ~UncountedAllocations();
+};
+
+}  // namespace knx
+}  // namespace esphome
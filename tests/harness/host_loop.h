@@ -0,0 +1,80 @@
+// Author: Dulgheru Mihaita (Since 2022)
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "esphome/core/component.h"
+#include "esphome/core/hal.h"
+#include "esphome/core/helpers.h"
+#include "host_platform.h"
+
+namespace esphome {
+namespace knx {
+
+// ESPHome runs loop() every 16 ms, back to back while a HighFrequencyLoopRequester is started
+inline constexpr uint32_t HOST_LOOP_INTERVAL_US = 16000;
+inline constexpr uint32_t HOST_LOOP_HIGH_FREQUENCY_US = 100;
+
+// Drives components like the ESPHome main loop. On the virtual clock each iteration advances the clock to the
+// next one, so seconds of bus traffic take milliseconds. Hooks run first in every iteration, e.g. a stand-in server.
+class HostLoop {
+  public:
+    HostLoop(Component *component) { this->components_.push_back(component); }
+    void add_component(Component *component) { this->components_.push_back(component); }
+    void add_hook(std::function<void()> &&hook) { this->hooks_.push_back(std::move(hook)); }
+    void set_interval_us(uint32_t interval_us, uint32_t high_frequency_us = HOST_LOOP_HIGH_FREQUENCY_US) {
+      this->interval_us_ = interval_us;
+      this->high_frequency_us_ = high_frequency_us;
+    }
+
+    void run_once() {
+      for (auto &hook : this->hooks_) {
+        hook();
+      }
+      for (auto *component : this->components_) {
+        component->loop();
+        component->call_intervals(millis());
+      }
+      this->iterations_++;
+    }
+
+    void run_for_ms(uint32_t ms) {
+      this->run_until([] { return false; }, ms);
+    }
+
+    // Runs until done() holds after an iteration, false if it did not within timeout_ms
+    bool run_until(const std::function<bool()> &done, uint32_t timeout_ms) {
+      uint64_t end = host::now_us() + timeout_ms * 1000ULL;
+      while (host::now_us() < end) {
+        this->run_once();
+        if (done()) {
+          return true;
+        }
+        uint32_t step = HighFrequencyLoopRequester::is_high_frequency() ? this->high_frequency_us_ : this->interval_us_;
+        if (host::is_real_time()) {
+          std::this_thread::sleep_for(std::chrono::microseconds(step));
+        }
+        else {
+          host::advance_us(step);
+        }
+      }
+      return false;
+    }
+
+    uint32_t get_iterations() { return this->iterations_; }
+
+  protected:
+    std::vector<Component *> components_;
+    std::vector<std::function<void()>> hooks_;
+    uint32_t interval_us_{HOST_LOOP_INTERVAL_US};
+    uint32_t high_frequency_us_{HOST_LOOP_HIGH_FREQUENCY_US};
+    uint32_t iterations_{0};
+};
+
+}  // namespace knx
+}  // namespace esphome
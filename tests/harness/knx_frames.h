@@ -0,0 +1,73 @@
+// Author: Dulgheru Mihaita (Since 2022)
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "knx_dpt.h"
+#include "knx_telegram.h"
+
+namespace esphome {
+namespace knx {
+
+// Device that sends the frames injected by the tests
+inline constexpr int TEST_SOURCE_AREA = 1;
+inline constexpr int TEST_SOURCE_LINE = 1;
+inline constexpr int TEST_SOURCE_MEMBER = 20;
+
+inline std::vector<uint8_t> frame_bytes(KnxTelegram &telegram) {
+  return std::vector<uint8_t>(telegram.data(), telegram.data() + telegram.get_total_length());
+}
+
+template<typename D>
+std::vector<uint8_t> group_frame(KnxGroupAddress address, KnxCommandType command, const typename D::value_type &value,
+                                 int source_member = TEST_SOURCE_MEMBER) {
+  KnxStandardTelegram telegram;
+  telegram.set_source_address(TEST_SOURCE_AREA, TEST_SOURCE_LINE, source_member);
+  telegram.set_target_group_address(address);
+  telegram.set_command(command);
+  telegram.set<D>(value);
+  telegram.create_checksum();
+  return frame_bytes(telegram);
+}
+
+inline std::vector<uint8_t> group_read_frame(KnxGroupAddress address, int source_member = TEST_SOURCE_MEMBER) {
+  KnxStandardTelegram telegram;
+  telegram.set_source_address(TEST_SOURCE_AREA, TEST_SOURCE_LINE, source_member);
+  telegram.set_target_group_address(address);
+  telegram.set_command(KNX_COMMAND_READ);
+  telegram.set_payload_length(2);
+  telegram.create_checksum();
+  return frame_bytes(telegram);
+}
+
+// Group write with length data octets after the APCI, an extended frame once they do not fit a standard one
+inline std::vector<uint8_t> extended_frame(KnxGroupAddress address, int length, int source_member = TEST_SOURCE_MEMBER) {
+  KnxExtendedTelegram telegram;
+  telegram.clear(true);
+  telegram.set_source_address(TEST_SOURCE_AREA, TEST_SOURCE_LINE, source_member);
+  telegram.set_target_group_address(address);
+  telegram.set_command(KNX_COMMAND_WRITE);
+  std::vector<uint8_t> data(length);
+  for (int i = 0; i < length; i++) {
+    data[i] = i;
+  }
+  telegram.set_data(data.data(), length);
+  telegram.create_checksum();
+  return frame_bytes(telegram);
+}
+
+// T_Connect to an individual address, 8 bytes: the shortest frame on the line
+inline std::vector<uint8_t> connect_frame(int area, int line, int member, int source_member = TEST_SOURCE_MEMBER) {
+  KnxStandardTelegram telegram;
+  telegram.set_source_address(TEST_SOURCE_AREA, TEST_SOURCE_LINE, source_member);
+  telegram.set_target_individual_address(area, line, member);
+  telegram.set_payload_length(1);
+  telegram.set_communication_type(KNX_COMM_UCD);
+  telegram.set_control_data(KNX_CONTROLDATA_CONNECT);
+  telegram.create_checksum();
+  return frame_bytes(telegram);
+}
+
+}  // namespace knx
+}  // namespace esphome
@@ -0,0 +1,134 @@
+// Author: Dulgheru Mihaita (Since 2022)
+
+#include "knxnetip_server.h"
+
+namespace esphome {
+namespace knx {
+
+  bool KnxNetIpServer::start() {
+    this->socket_ = socket::socket_ip(SOCK_DGRAM, IPPROTO_UDP);
+    if (this->socket_ == nullptr) {
+      return false;
+    }
+    struct sockaddr_storage address;
+    socklen_t length = socket::set_sockaddr((struct sockaddr *) &address, sizeof(address), "127.0.0.1", 0);
+    if (this->socket_->bind((struct sockaddr *) &address, length) != 0 ||
+        this->socket_->getsockname((struct sockaddr *) &address, &length) != 0) {
+      this->socket_ = nullptr;
+      return false;
+    }
+    this->socket_->setblocking(false);
+    this->port_ = ntohs(((struct sockaddr_in *) &address)->sin_port);
+    return true;
+  }
+
+  void KnxNetIpServer::poll() {
+    uint8_t buffer[KNXNETIP_MAX_FRAME_SIZE];
+    struct sockaddr_storage source;
+    socklen_t source_length = sizeof(source);
+    ssize_t length;
+    while ((length = this->socket_->recvfrom(buffer, sizeof(buffer), (struct sockaddr *) &source, &source_length)) > 0) {
+      this->client_ = source;
+      this->client_length_ = source_length;
+      this->handle(buffer, length);
+      source_length = sizeof(source);
+    }
+  }
+
+  void KnxNetIpServer::handle(const uint8_t *data, int length) {
+    if (length < KNXNETIP_HEADER_SIZE + 2 || data[0] != KNXNETIP_HEADER_SIZE || data[1] != KNXNETIP_VERSION_10) {
+      return;
+    }
+    uint16_t service = (data[2] << 8) | data[3];
+    const uint8_t *body = data + KNXNETIP_HEADER_SIZE;
+    int body_length = length - KNXNETIP_HEADER_SIZE;
+
+    switch (service) {
+      case KNXNETIP_CONNECT_REQUEST:
+        // Channel, status, data endpoint HPAI and the CRD with the tunnel address
+        this->connect_requests_++;
+        this->connected_ = true;
+        this->tx_sequence_ = 0;
+        this->reply(KNXNETIP_CONNECT_RESPONSE, {SERVER_CHANNEL, 0, 0x08, 0x01, 127, 0, 0, 1,
+                                                (uint8_t) (this->port_ >> 8), (uint8_t) (this->port_ & 0xFF),
+                                                0x04, 0x04, SERVER_TUNNEL_ADDRESS >> 8, SERVER_TUNNEL_ADDRESS & 0xFF});
+        break;
+
+      case KNXNETIP_CONNECTIONSTATE_REQUEST:
+        this->heartbeats_++;
+        if (this->answer_heartbeat_) {
+          this->reply(KNXNETIP_CONNECTIONSTATE_RESPONSE, {body[0], (uint8_t) (this->connected_ ? 0 : 0x21)});
+        }
+        break;
+
+      case KNXNETIP_DISCONNECT_REQUEST:
+        this->disconnect_requests_++;
+        this->connected_ = false;
+        this->reply(KNXNETIP_DISCONNECT_RESPONSE, {body[0], 0});
+        break;
+
+      case KNXNETIP_TUNNELING_ACK:
+        if (body_length >= KNXNETIP_CONNECTION_HEADER_SIZE) {
+          this->acks_.push_back(body[2]);
+        }
+        break;
+
+      case KNXNETIP_TUNNELING_REQUEST: {
+        if (body_length < KNXNETIP_CONNECTION_HEADER_SIZE + KNX_CEMI_HEADER_SIZE) {
+          break;
+        }
+        const uint8_t *cemi = body + KNXNETIP_CONNECTION_HEADER_SIZE;
+        int cemi_length = body_length - KNXNETIP_CONNECTION_HEADER_SIZE;
+        this->requests_.push_back({body[2], std::vector<uint8_t>(cemi, cemi + cemi_length)});
+        if (this->drop_acks_ > 0) {
+          this->drop_acks_--;
+          break;
+        }
+        this->reply(KNXNETIP_TUNNELING_ACK, {KNXNETIP_CONNECTION_HEADER_SIZE, SERVER_CHANNEL, body[2], 0});
+        if (cemi[0] == KNX_CEMI_L_DATA_REQ && this->send_confirm_) {
+          // The same frame back, confirm bit in control field 1 set if it could not be sent on the line
+          std::vector<uint8_t> confirm(cemi, cemi + cemi_length);
+          confirm[0] = KNX_CEMI_L_DATA_CON;
+          confirm[2 + cemi[1]] |= this->confirm_failed_ ? 0b00000001 : 0;
+          this->send_tunneling_request(this->tx_sequence_++, confirm.data(), confirm.size());
+        }
+        break;
+      }
+
+      default:
+        break;
+    }
+  }
+
+  void KnxNetIpServer::send_indication(const std::vector<uint8_t> &frame) {
+    this->send_indication(frame, this->tx_sequence_++);
+  }
+
+  void KnxNetIpServer::send_indication(const std::vector<uint8_t> &frame, uint8_t sequence) {
+    uint8_t cemi[KNX_CEMI_MAX_SIZE];
+    int length = knx_tp_to_cemi(KNX_CEMI_L_DATA_IND, frame.data(), frame.size(), cemi);
+    this->send_tunneling_request(sequence, cemi, length);
+  }
+
+  void KnxNetIpServer::send_disconnect_request() {
+    this->connected_ = false;
+    this->reply(KNXNETIP_DISCONNECT_REQUEST, {SERVER_CHANNEL, 0, 0x08, 0x01, 127, 0, 0, 1,
+                                              (uint8_t) (this->port_ >> 8), (uint8_t) (this->port_ & 0xFF)});
+  }
+
+  void KnxNetIpServer::send_tunneling_request(uint8_t sequence, const uint8_t *cemi, int length) {
+    std::vector<uint8_t> body = {KNXNETIP_CONNECTION_HEADER_SIZE, SERVER_CHANNEL, sequence, 0};
+    body.insert(body.end(), cemi, cemi + length);
+    this->reply(KNXNETIP_TUNNELING_REQUEST, body);
+  }
+
+  // To the client that sent the last datagram
+  void KnxNetIpServer::reply(uint16_t service, const std::vector<uint8_t> &body) {
+    std::vector<uint8_t> frame(KNXNETIP_HEADER_SIZE + body.size());
+    knx_netip_header(frame.data(), service, frame.size());
+    std::copy(body.begin(), body.end(), frame.begin() + KNXNETIP_HEADER_SIZE);
+    this->socket_->sendto(frame.data(), frame.size(), 0, (struct sockaddr *) &this->client_, this->client_length_);
+  }
+
+}  // namespace knx
+}  // namespace esphome
@@ -0,0 +1,78 @@
+// Author: Dulgheru Mihaita (Since 2022)
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "esphome/components/socket/socket.h"
+#include "knx_netip.h"
+
+namespace esphome {
+namespace knx {
+
+inline constexpr uint8_t SERVER_CHANNEL = 7;
+// Individual address the interface gives the tunnel, 1.1.250
+inline constexpr uint16_t SERVER_TUNNEL_ADDRESS = 0x11FA;
+
+// A tunnelling request the server received, cEMI frame with its sequence counter
+struct ServerRequest {
+  uint8_t sequence;
+  std::vector<uint8_t> cemi;
+};
+
+// Stand-in KNXnet/IP interface with one tunnel on 127.0.0.1 and an ephemeral port. Answers from poll(),
+// which a HostLoop hook calls before the component, so datagrams on the loopback are handled in one iteration.
+class KnxNetIpServer {
+  public:
+    // False if no socket could be bound
+    bool start();
+    uint16_t get_port() { return this->port_; }
+    void poll();
+
+    // Frames sent to the tunnel client as L_DATA.ind, with the next sequence counter unless given
+    void send_indication(const std::vector<uint8_t> &frame);
+    void send_indication(const std::vector<uint8_t> &frame, uint8_t sequence);
+    void send_disconnect_request();
+
+    // TUNNELING_ACKs not sent for the next count requests
+    void drop_acks(int count) { this->drop_acks_ = count; }
+    // L_DATA.con for L_DATA.req: confirmed, failed or none at all
+    void set_confirm(bool send, bool failed = false) {
+      this->send_confirm_ = send;
+      this->confirm_failed_ = failed;
+    }
+    void set_heartbeat_answers(bool answer) { this->answer_heartbeat_ = answer; }
+
+    bool is_connected() { return this->connected_; }
+    uint32_t get_connect_requests() { return this->connect_requests_; }
+    uint32_t get_heartbeats() { return this->heartbeats_; }
+    uint32_t get_disconnect_requests() { return this->disconnect_requests_; }
+    const std::vector<ServerRequest> &get_requests() { return this->requests_; }
+    // Sequence counters the client acknowledged, in order
+    const std::vector<uint8_t> &get_acks() { return this->acks_; }
+
+  protected:
+    std::unique_ptr<socket::Socket> socket_;
+    uint16_t port_{0};
+    struct sockaddr_storage client_;
+    socklen_t client_length_{0};
+    bool connected_{false};
+    uint8_t tx_sequence_{0};
+    int drop_acks_{0};
+    bool send_confirm_{true};
+    bool confirm_failed_{false};
+    bool answer_heartbeat_{true};
+    uint32_t connect_requests_{0};
+    uint32_t heartbeats_{0};
+    uint32_t disconnect_requests_{0};
+    std::vector<ServerRequest> requests_;
+    std::vector<uint8_t> acks_;
+
+    void handle(const uint8_t *data, int length);
+    void reply(uint16_t service, const std::vector<uint8_t> &body);
+    void send_tunneling_request(uint8_t sequence, const uint8_t *cemi, int length);
+};
+
+}  // namespace knx
+}  // namespace esphome
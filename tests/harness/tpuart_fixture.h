@@ -0,0 +1,67 @@
+// Author: Dulgheru Mihaita (Since 2022)
+
+#pragma once
+
+#include <memory>
+#include <vector>
+#include <gtest/gtest.h>
+#include "automation.h"
+#include "host_loop.h"
+#include "host_platform.h"
+#include "knx_component.h"
+#include "knx_frames.h"
+#include "knx_tpuart_transport.h"
+#include "tpuart_simulator.h"
+
+namespace esphome {
+namespace knx {
+
+// KnxComponent with individual address 1.1.10 on a simulated TPUART, on the virtual clock
+class TpuartFixture : public ::testing::Test {
+  protected:
+    void SetUp() override {
+      host::reset_clock();
+      host::reset_log_counts();
+      this->knx.set_transport(&this->transport);
+      this->knx.set_individual_address(1, 1, 10);
+      this->knx.set_serial_timeout(1000);
+    }
+
+    // Ends a receive task before the transport goes away
+    void TearDown() override { host::stop_tasks(); }
+
+    // setup() and the transceiver detection that follows the first reset indication
+    void start() {
+      this->knx.setup();
+      this->loop.run_until([this] { return this->transport.get_transceiver() != KNX_TRANSCEIVER_AUTO; }, 1000);
+    }
+
+    // Until everything injected and sent is over and confirmed, and loop() ran once more
+    void run_until_idle(uint32_t timeout_ms = 60000) {
+      this->loop.run_until([this] {
+        return this->knx.get_tx_queue_depth() == 0 && host::now_us() >= this->sim.get_bus_free_us();
+      }, timeout_ms);
+      this->loop.run_for_ms(20);
+    }
+
+    // Copies of the telegrams the trigger for address and command fired with
+    std::vector<std::vector<uint8_t>> *watch(KnxGroupAddress address, KnxCommandType command) {
+      this->triggers_.emplace_back(new KnxGroupTrigger(&this->knx, address, command));
+      this->received_.emplace_back(new std::vector<std::vector<uint8_t>>());
+      auto *received = this->received_.back().get();
+      this->triggers_.back()->set_callback([received](KnxTelegram *telegram) {
+        received->push_back(frame_bytes(*telegram));
+      });
+      return received;
+    }
+
+    TpuartSimulator sim;
+    KnxTpuartTransport transport{&sim};
+    KnxComponent knx;
+    HostLoop loop{&knx};
+    std::vector<std::unique_ptr<KnxGroupTrigger>> triggers_;
+    std::vector<std::unique_ptr<std::vector<std::vector<uint8_t>>>> received_;
+};
+
+}  // namespace knx
+}  // namespace esphome
@@ -0,0 +1,314 @@
+// Author: Dulgheru Mihaita (Since 2022)
+
+#include "tpuart_simulator.h"
+#include "alloc_counter.h"
+#include "host_platform.h"
+
+namespace esphome {
+namespace knx {
+
+  uint16_t sim_crc_ccitt(const uint8_t *data, int length) {
+    uint16_t crc = 0xFFFF;
+    for (int i = 0; i < length; i++) {
+      crc ^= data[i] << 8;
+      for (int bit = 0; bit < 8; bit++) {
+        crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+      }
+    }
+    return crc;
+  }
+
+  // Moves the bytes that are due into the UART receive buffer, a full buffer loses them
+  void TpuartSimulator::pump() {
+    uint64_t now = host::now_us();
+    while (!this->scheduled_.empty() && this->scheduled_.begin()->first <= now) {
+      if (this->rx_fifo_.size() >= this->get_rx_buffer_size()) {
+        this->uart_overflows_++;
+      }
+      else {
+        this->rx_fifo_.push_back(this->scheduled_.begin()->second);
+      }
+      this->scheduled_.erase(this->scheduled_.begin());
+    }
+  }
+
+  void TpuartSimulator::schedule(uint64_t at_us, uint8_t byte) {
+    this->scheduled_.emplace(at_us, byte);
+  }
+
+  // The UART side runs inside loop(), what the simulator allocates there is not the component's
+  int TpuartSimulator::available() {
+    UncountedAllocations uncounted;
+    std::lock_guard<std::mutex> guard(this->lock_);
+    this->pump();
+    return this->rx_fifo_.size();
+  }
+
+  bool TpuartSimulator::peek_byte(uint8_t *data) {
+    UncountedAllocations uncounted;
+    std::lock_guard<std::mutex> guard(this->lock_);
+    this->pump();
+    if (this->rx_fifo_.empty()) {
+      return false;
+    }
+    *data = this->rx_fifo_.front();
+    return true;
+  }
+
+  bool TpuartSimulator::read_array(uint8_t *data, size_t length) {
+    UncountedAllocations uncounted;
+    std::lock_guard<std::mutex> guard(this->lock_);
+    this->pump();
+    if (this->rx_fifo_.size() < length) {
+      return false;
+    }
+    for (size_t i = 0; i < length; i++) {
+      data[i] = this->rx_fifo_.front();
+      this->rx_fifo_.pop_front();
+    }
+    return true;
+  }
+
+  // Every byte arrives one UART character after the previous one has been received
+  void TpuartSimulator::write_array(const uint8_t *data, size_t length) {
+    UncountedAllocations uncounted;
+    std::lock_guard<std::mutex> guard(this->lock_);
+    uint64_t at = std::max(host::now_us(), this->uart_tx_free_us_);
+    for (size_t i = 0; i < length; i++) {
+      at += TPUART_UART_CHAR_US;
+      this->receive_service(data[i], at);
+    }
+    this->uart_tx_free_us_ = at;
+  }
+
+  void TpuartSimulator::receive_service(uint8_t byte, uint64_t at_us) {
+    if (this->tx_position_ >= 0) {
+      if ((int) this->tx_frame_.size() <= this->tx_position_) {
+        this->tx_frame_.resize(this->tx_position_ + 1);
+      }
+      this->tx_frame_[this->tx_position_] = byte;
+      this->tx_position_ = -1;
+      if (this->tx_end_) {
+        this->send_frame(at_us);
+      }
+      return;
+    }
+    if (this->arguments_left_ > 0) {
+      this->arguments_.push_back(byte);
+      if (--this->arguments_left_ == 0) {
+        this->receive_arguments();
+      }
+      return;
+    }
+
+    bool tpuart2 = this->chip_ == SimChip::TPUART2;
+    bool ncn5120 = this->chip_ == SimChip::NCN5120;
+    if ((byte & 0b11000000) == TPUART_DATA_START_CONTINUE || (byte & 0b11000000) == TPUART_DATA_END) {
+      this->tx_end_ = (byte & 0b11000000) == TPUART_DATA_END;
+      this->tx_position_ = this->tx_block_ * TPUART_DATA_BLOCK_SIZE + (byte & 0b00111111);
+    }
+    else if ((byte & 0b11111000) == TPUART_ACK_INFORMATION) {
+      this->receive_ack_information(byte, at_us);
+    }
+    else if (byte == TPUART_RESET_REQUEST) {
+      this->reset_requests_++;
+      this->reset_chip(at_us, SIM_RESET_DELAY_US);
+    }
+    else if (byte == TPUART_STATE_REQUEST) {
+      this->state_requests_++;
+      this->schedule(at_us + TPUART_UART_CHAR_US, SIM_STATE_INDICATION_OK);
+    }
+    else if (byte == NCN5120_SYSTEM_STAT_REQUEST) {
+      // Would be U_L_DataOffset 5, which no frame needs
+      if (ncn5120) {
+        this->schedule(at_us + TPUART_UART_CHAR_US, NCN5120_SYSTEM_STAT_INDICATION);
+        this->schedule(at_us + 2 * TPUART_UART_CHAR_US, SIM_NCN5120_SYSTEM_STAT);
+      }
+      else {
+        this->unknown_services_++;
+      }
+    }
+    else if ((byte & 0b11111000) == TPUART_DATA_OFFSET) {
+      this->tx_block_ = byte & 0b00000111;
+    }
+    else if (tpuart2 && byte == TPUART2_PRODUCT_ID_REQUEST) {
+      this->schedule(at_us + TPUART_UART_CHAR_US, SIM_TPUART2_PRODUCT_ID);
+    }
+    else if ((tpuart2 && byte == TPUART2_ACTIVATE_BUSY_MODE) || (ncn5120 && byte == NCN5120_SET_BUSY)) {
+      this->busy_mode_ = true;
+    }
+    else if ((tpuart2 && byte == TPUART2_RESET_BUSY_MODE) || (ncn5120 && byte == NCN5120_QUIT_BUSY)) {
+      this->busy_mode_ = false;
+    }
+    else if (tpuart2 && byte == TPUART2_ACTIVATE_CRC) {
+      this->crc_mode_ = true;
+    }
+    else if ((tpuart2 && byte == TPUART2_SET_ADDRESS) || (ncn5120 && byte == NCN5120_SET_ADDRESS)) {
+      this->service_ = byte;
+      this->arguments_.clear();
+      this->arguments_left_ = tpuart2 ? 2 : 3;
+    }
+    else {
+      this->unknown_services_++;
+    }
+  }
+
+  void TpuartSimulator::receive_arguments() {
+    if (this->service_ == TPUART2_SET_ADDRESS || this->service_ == NCN5120_SET_ADDRESS) {
+      this->individual_address_ = (this->arguments_[0] << 8) | this->arguments_[1];
+    }
+  }
+
+  // Belongs to the last frame that started before it arrived
+  void TpuartSimulator::receive_ack_information(uint8_t byte, uint64_t at_us) {
+    for (auto it = this->rx_frames_.rbegin(); it != this->rx_frames_.rend(); it++) {
+      if (it->start_us > at_us) {
+        continue;
+      }
+      if (it->ack_requested) {
+        break;
+      }
+      it->ack_requested = true;
+      it->ack_information = byte;
+      it->ack_us = at_us;
+      return;
+    }
+    this->unknown_services_++;
+  }
+
+  // The frame goes on the bus once it is free, L_DATA.con follows the acknowledge
+  void TpuartSimulator::send_frame(uint64_t at_us) {
+    uint64_t start = std::max(at_us, this->bus_free_us_);
+    uint64_t end = start + (this->tx_frame_.size() - 1) * SIM_BUS_CHAR_US + SIM_BUS_CHAR_BITS_US;
+    uint64_t acknowledged = end + SIM_ACK_GAP_US + SIM_BUS_CHAR_BITS_US;
+    this->bus_free_us_ = acknowledged + SIM_IDLE_US;
+    this->tx_frames_.push_back({this->tx_frame_, at_us, end});
+    this->tx_frame_.clear();
+    this->tx_block_ = 0;
+    this->tx_end_ = false;
+    if (this->confirm_ != SimConfirm::NONE) {
+      this->schedule(acknowledged + this->confirm_delay_us_ + TPUART_UART_CHAR_US,
+                     this->confirm_ == SimConfirm::POSITIVE ? TPUART_DATA_CONFIRM_SUCCESS : TPUART_DATA_CONFIRM_FAILED);
+    }
+  }
+
+  // Address, busy and CRC mode are forgotten, the indication follows after delay_us
+  void TpuartSimulator::reset_chip(uint64_t at_us, uint32_t delay_us) {
+    this->individual_address_ = 0;
+    this->busy_mode_ = false;
+    this->crc_mode_ = false;
+    this->tx_frame_.clear();
+    this->tx_block_ = 0;
+    this->tx_position_ = -1;
+    this->arguments_left_ = 0;
+    this->schedule(at_us + delay_us, TPUART_RESET_INDICATION_BYTE);
+  }
+
+  void TpuartSimulator::set_chip(SimChip chip) {
+    std::lock_guard<std::mutex> guard(this->lock_);
+    this->chip_ = chip;
+  }
+
+  void TpuartSimulator::set_confirm(SimConfirm confirm, uint32_t extra_delay_us) {
+    std::lock_guard<std::mutex> guard(this->lock_);
+    this->confirm_ = confirm;
+    this->confirm_delay_us_ = extra_delay_us;
+  }
+
+  size_t TpuartSimulator::inject_frame(const std::vector<uint8_t> &frame, const SimFaults &faults) {
+    std::lock_guard<std::mutex> guard(this->lock_);
+    std::vector<uint8_t> uart = frame;
+    int length = faults.truncate >= 0 ? std::min<int>(faults.truncate, frame.size()) : frame.size();
+    uart.resize(length);
+    if (this->crc_mode_ && length == (int) frame.size()) {
+      uint16_t crc = sim_crc_ccitt(frame.data(), frame.size());
+      uart.push_back(crc >> 8);
+      uart.push_back(crc & 0xFF);
+    }
+
+    SimRxFrame rx;
+    rx.bytes = frame;
+    rx.start_us = std::max(host::now_us(), this->bus_free_us_);
+    rx.end_us = rx.start_us + (length - 1) * SIM_BUS_CHAR_US + SIM_BUS_CHAR_BITS_US;
+    rx.addressed_us = rx.start_us + (KNX_RX_ADDRESSED_SIZE - 1) * SIM_BUS_CHAR_US + SIM_BUS_CHAR_BITS_US +
+                      TPUART_UART_CHAR_US;
+    for (int i = 0; i < (int) uart.size(); i++) {
+      // Forwarded once received from the bus, the CRC follows the last byte on the UART
+      uint64_t at = i < length ? rx.start_us + i * SIM_BUS_CHAR_US + SIM_BUS_CHAR_BITS_US + TPUART_UART_CHAR_US
+                               : rx.end_us + (i - length + 2) * TPUART_UART_CHAR_US;
+      if (i == faults.drop_byte) {
+        continue;
+      }
+      this->schedule(at, i == faults.corrupt_byte ? uart[i] ^ faults.corrupt_mask : uart[i]);
+    }
+    this->bus_free_us_ = rx.end_us + SIM_ACK_GAP_US + SIM_BUS_CHAR_BITS_US + SIM_IDLE_US;
+    this->rx_frames_.push_back(rx);
+    return this->rx_frames_.size() - 1;
+  }
+
+  void TpuartSimulator::inject_bytes(const std::vector<uint8_t> &bytes) {
+    std::lock_guard<std::mutex> guard(this->lock_);
+    uint64_t at = host::now_us();
+    for (uint8_t byte : bytes) {
+      at += TPUART_UART_CHAR_US;
+      this->schedule(at, byte);
+    }
+  }
+
+  void TpuartSimulator::inject_reset() {
+    std::lock_guard<std::mutex> guard(this->lock_);
+    this->reset_chip(host::now_us(), TPUART_UART_CHAR_US);
+  }
+
+  uint64_t TpuartSimulator::get_bus_free_us() {
+    std::lock_guard<std::mutex> guard(this->lock_);
+    return this->bus_free_us_;
+  }
+
+  std::vector<SimRxFrame> TpuartSimulator::get_rx_frames() {
+    std::lock_guard<std::mutex> guard(this->lock_);
+    return this->rx_frames_;
+  }
+
+  std::vector<SimTxFrame> TpuartSimulator::get_tx_frames() {
+    std::lock_guard<std::mutex> guard(this->lock_);
+    return this->tx_frames_;
+  }
+
+  uint32_t TpuartSimulator::get_reset_requests() {
+    std::lock_guard<std::mutex> guard(this->lock_);
+    return this->reset_requests_;
+  }
+
+  uint32_t TpuartSimulator::get_state_requests() {
+    std::lock_guard<std::mutex> guard(this->lock_);
+    return this->state_requests_;
+  }
+
+  uint32_t TpuartSimulator::get_uart_overflows() {
+    std::lock_guard<std::mutex> guard(this->lock_);
+    return this->uart_overflows_;
+  }
+
+  uint32_t TpuartSimulator::get_unknown_services() {
+    std::lock_guard<std::mutex> guard(this->lock_);
+    return this->unknown_services_;
+  }
+
+  uint16_t TpuartSimulator::get_individual_address() {
+    std::lock_guard<std::mutex> guard(this->lock_);
+    return this->individual_address_;
+  }
+
+  bool TpuartSimulator::is_busy_mode() {
+    std::lock_guard<std::mutex> guard(this->lock_);
+    return this->busy_mode_;
+  }
+
+  bool TpuartSimulator::is_crc_mode() {
+    std::lock_guard<std::mutex> guard(this->lock_);
+    return this->crc_mode_;
+  }
+
+}  // namespace knx
+}  // namespace esphome
@@ -0,0 +1,145 @@
+// Author: Dulgheru Mihaita (Since 2022)
+
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <vector>
+#include "esphome/components/uart/uart.h"
+#include "knx_tpuart_transport.h"
+
+namespace esphome {
+namespace knx {
+
+// TP1 at 9600 bit/s: a character is 11 bits followed by 2 bits of idle
+inline constexpr uint32_t SIM_BUS_CHAR_US = 13 * KNX_TP1_BIT_TIME_US;
+inline constexpr uint32_t SIM_BUS_CHAR_BITS_US = 11 * KNX_TP1_BIT_TIME_US;
+// After a frame the acknowledge character follows 15 bit times later, the next frame 50 bit times after that
+inline constexpr uint32_t SIM_ACK_GAP_US = 15 * KNX_TP1_BIT_TIME_US;
+inline constexpr uint32_t SIM_IDLE_US = 50 * KNX_TP1_BIT_TIME_US;
+inline constexpr uint32_t SIM_RESET_DELAY_US = 1000;
+// Answers of the simulated chips to the probes of KnxTpuartTransport
+inline constexpr uint8_t SIM_TPUART2_PRODUCT_ID = 0x41;
+inline constexpr uint8_t SIM_NCN5120_SYSTEM_STAT = 0x00;
+inline constexpr uint8_t SIM_STATE_INDICATION_OK = 0x07;
+
+enum class SimChip { TPUART, TPUART2, NCN5120 };
+
+enum class SimConfirm {
+  POSITIVE,
+  NEGATIVE,
+  NONE       // The L_DATA.con is lost
+};
+
+// Faults on the UART between the transceiver and the host, applied to one injected frame
+struct SimFaults {
+  int drop_byte{-1};             // Index of a byte that never arrives
+  int corrupt_byte{-1};          // Index of a byte that arrives with corrupt_mask xored in
+  uint8_t corrupt_mask{0xFF};
+  int truncate{-1};              // The sender aborts after this many bytes
+};
+
+// A frame injected on the line and what the host answered while it was received. Times are on the host clock.
+struct SimRxFrame {
+  std::vector<uint8_t> bytes;
+  uint64_t start_us;
+  uint64_t addressed_us;         // Control fields and both addresses (KNX_RX_ADDRESSED_SIZE bytes) are readable
+  uint64_t end_us;               // Last character is on the bus, the U_AckInformation has to be in by then
+  bool ack_requested{false};
+  uint8_t ack_information{0};
+  uint64_t ack_us{0};            // U_AckInformation completely received by the transceiver
+
+  bool acknowledged_in_time() const { return this->ack_requested && this->ack_us <= this->end_us; }
+};
+
+// A frame the host asked the transceiver to send
+struct SimTxFrame {
+  std::vector<uint8_t> bytes;
+  uint64_t received_us;          // Last U_L_DataEnd byte received by the transceiver
+  uint64_t end_us;               // Sent on the bus
+};
+
+// TPUART on a 19200 baud UART with a scripted TP1 line behind it. Bytes reach the host at the time they would
+// on real hardware: each injected frame takes its bus time, each byte one more UART character. Everything
+// runs on the host clock, so with the virtual clock a test runs as fast as the code under test allows.
+// Safe to use from a receive task and the test at the same time.
+class TpuartSimulator : public uart::UARTComponent {
+  public:
+    void write_array(const uint8_t *data, size_t length) override;
+    bool peek_byte(uint8_t *data) override;
+    bool read_array(uint8_t *data, size_t length) override;
+    int available() override;
+    void flush() override {}
+
+    void set_chip(SimChip chip);
+    // How sent frames are confirmed, extra_delay_us after the acknowledge on the bus
+    void set_confirm(SimConfirm confirm, uint32_t extra_delay_us = 0);
+
+    // Puts a frame on the line after the ones injected before, returns its index in get_rx_frames()
+    size_t inject_frame(const std::vector<uint8_t> &frame, const SimFaults &faults = {});
+    // Bytes as they are on the UART, e.g. noise or a stray confirmation
+    void inject_bytes(const std::vector<uint8_t> &bytes);
+    // The transceiver resets by itself, e.g. after the bus voltage dropped
+    void inject_reset();
+    // The line is free from then on, after the injected and sent frames
+    uint64_t get_bus_free_us();
+
+    std::vector<SimRxFrame> get_rx_frames();
+    std::vector<SimTxFrame> get_tx_frames();
+    uint32_t get_reset_requests();
+    uint32_t get_state_requests();
+    uint32_t get_uart_overflows();
+    // Bytes from the host that no chip service explains
+    uint32_t get_unknown_services();
+    // Set by the host, only on a TP-UART2 or NCN5120
+    uint16_t get_individual_address();
+    bool is_busy_mode();
+    bool is_crc_mode();
+
+  protected:
+    std::mutex lock_;
+    SimChip chip_{SimChip::TPUART};
+    SimConfirm confirm_{SimConfirm::POSITIVE};
+    uint32_t confirm_delay_us_{0};
+
+    // Towards the host: scheduled bytes by the time they become readable, and the UART receive buffer
+    std::multimap<uint64_t, uint8_t> scheduled_;
+    std::deque<uint8_t> rx_fifo_;
+    uint32_t uart_overflows_{0};
+    uint64_t bus_free_us_{0};
+    uint64_t uart_tx_free_us_{0};    // Host to transceiver, the UART is busy until then
+    std::vector<SimRxFrame> rx_frames_;
+    std::vector<SimTxFrame> tx_frames_;
+
+    // Host services being parsed
+    std::vector<uint8_t> tx_frame_;
+    int tx_block_{0};
+    int tx_position_{-1};            // Byte expected after a U_L_DataStart/Continue/End
+    bool tx_end_{false};
+    uint8_t service_{0};             // Service waiting for its arguments
+    std::vector<uint8_t> arguments_;
+    int arguments_left_{0};
+
+    uint32_t reset_requests_{0};
+    uint32_t state_requests_{0};
+    uint32_t unknown_services_{0};
+    uint16_t individual_address_{0};
+    bool busy_mode_{false};
+    bool crc_mode_{false};
+
+    void pump();
+    void schedule(uint64_t at_us, uint8_t byte);
+    void receive_service(uint8_t byte, uint64_t at_us);
+    void receive_arguments();
+    void receive_ack_information(uint8_t byte, uint64_t at_us);
+    void send_frame(uint64_t at_us);
+    void reset_chip(uint64_t at_us, uint32_t delay_us);
+};
+
+// CRC-CCITT of the TP-UART2 CRC mode
+uint16_t sim_crc_ccitt(const uint8_t *data, int length);
+
+}  // namespace knx
+}  // namespace esphome
@@ -0,0 +1,28 @@
+// Author: Dulgheru Mihaita (Since 2022)
+
+// Host build: the parts of the generated esphome.h and of Arduino the knx component uses
+
+#pragma once
+
+#include <string>
+#include "esphome/core/defines.h"
+#include "esphome/core/hal.h"
+#include "esphome/core/helpers.h"
+#include "esphome/core/log.h"
+#include "esphome/core/component.h"
+#include "esphome/core/automation.h"
+
+// Arduino String, only what the component takes it for
+class String {
+  public:
+    String(const char *text = "") : text_(text) {}
+    String(const std::string &text) : text_(text) {}
+    const char *c_str() const { return this->text_.c_str(); }
+
+  protected:
+    std::string text_;
+};
+
+using esphome::millis;
+using esphome::micros;
+using esphome::delay;
@@ -0,0 +1,12 @@
+// Author: Dulgheru Mihaita (Since 2022)
+
+#pragma once
+
+namespace esphome {
+namespace network {
+
+// The host network is always up
+inline bool is_connected() { return true; }
+
+}  // namespace network
+}  // namespace esphome
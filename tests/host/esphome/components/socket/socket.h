@@ -0,0 +1,38 @@
+// Author: Dulgheru Mihaita (Since 2022)
+
+// Host build: the ESPHome socket interface on top of the BSD sockets of the host
+
+#pragma once
+
+#include <memory>
+#include <string>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+namespace esphome {
+namespace socket {
+
+class Socket {
+  public:
+    virtual ~Socket() = default;
+    virtual int bind(const struct sockaddr *addr, socklen_t addrlen) = 0;
+    virtual int connect(const struct sockaddr *addr, socklen_t addrlen) = 0;
+    virtual int getsockname(struct sockaddr *addr, socklen_t *addrlen) = 0;
+    virtual int setsockopt(int level, int optname, const void *optval, socklen_t optlen) = 0;
+    virtual ssize_t read(void *buf, size_t len) = 0;
+    virtual ssize_t recvfrom(void *buf, size_t len, struct sockaddr *addr, socklen_t *addrlen) = 0;
+    virtual ssize_t write(const void *buf, size_t len) = 0;
+    virtual ssize_t sendto(const void *buf, size_t len, int flags, const struct sockaddr *to, socklen_t tolen) = 0;
+    virtual int setblocking(bool blocking) = 0;
+    virtual int get_fd() = 0;
+};
+
+std::unique_ptr<Socket> socket(int domain, int type, int protocol);
+// IPv4 on the host
+std::unique_ptr<Socket> socket_ip(int type, int protocol);
+socklen_t set_sockaddr(struct sockaddr *addr, socklen_t addrlen, const std::string &ip_address, uint16_t port);
+socklen_t set_sockaddr_any(struct sockaddr *addr, socklen_t addrlen, uint16_t port);
+
+}  // namespace socket
+}  // namespace esphome
@@ -0,0 +1,61 @@
+// Author: Dulgheru Mihaita (Since 2022)
+
+// Host build: the ESPHome UART interface, implemented by the simulators of the host tests
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace esphome {
+namespace uart {
+
+enum UARTParityOptions {
+  UART_CONFIG_PARITY_NONE,
+  UART_CONFIG_PARITY_EVEN,
+  UART_CONFIG_PARITY_ODD
+};
+
+class UARTComponent {
+  public:
+    virtual ~UARTComponent() = default;
+    virtual void write_array(const uint8_t *data, size_t length) = 0;
+    virtual bool peek_byte(uint8_t *data) = 0;
+    virtual bool read_array(uint8_t *data, size_t length) = 0;
+    virtual int available() = 0;
+    virtual void flush() = 0;
+
+    void set_rx_buffer_size(size_t rx_buffer_size) { this->rx_buffer_size_ = rx_buffer_size; }
+    size_t get_rx_buffer_size() { return this->rx_buffer_size_; }
+
+  protected:
+    size_t rx_buffer_size_{256};
+};
+
+class UARTDevice {
+  public:
+    UARTDevice() = default;
+    UARTDevice(UARTComponent *parent) : parent_(parent) {}
+    void set_uart_parent(UARTComponent *parent) { this->parent_ = parent; }
+
+    void write_byte(uint8_t data) { this->parent_->write_array(&data, 1); }
+    void write(uint8_t data) { this->parent_->write_array(&data, 1); }
+    void write_array(const uint8_t *data, size_t length) { this->parent_->write_array(data, length); }
+    bool read_byte(uint8_t *data) { return this->parent_->read_array(data, 1); }
+    int read() {
+      uint8_t data;
+      this->read_byte(&data);
+      return data;
+    }
+    int available() { return this->parent_->available(); }
+    // The simulators always run at the settings asked for
+    bool check_uart_settings(uint32_t baud_rate, uint8_t stop_bits, UARTParityOptions parity, uint8_t data_bits) {
+      return true;
+    }
+
+  protected:
+    UARTComponent *parent_{nullptr};
+};
+
+}  // namespace uart
+}  // namespace esphome
@@ -0,0 +1,30 @@
+// Author: Dulgheru Mihaita (Since 2022)
+
+#pragma once
+
+#include <functional>
+#include <utility>
+
+namespace esphome {
+
+// Tests attach a callback where ESPHome would attach the automation
+template<typename... Ts> class Trigger {
+  public:
+    void trigger(Ts... x) {
+      if (this->callback_) {
+        this->callback_(x...);
+      }
+    }
+    void set_callback(std::function<void(Ts...)> &&callback) { this->callback_ = std::move(callback); }
+
+  protected:
+    std::function<void(Ts...)> callback_;
+};
+
+template<typename... Ts> class Action {
+  public:
+    virtual ~Action() = default;
+    virtual void play(Ts... x) = 0;
+};
+
+}  // namespace esphome
@@ -0,0 +1,45 @@
+// Author: Dulgheru Mihaita (Since 2022)
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace esphome {
+
+class Component {
+  public:
+    virtual ~Component() = default;
+    virtual void setup() {}
+    virtual void loop() {}
+    virtual void dump_config() {}
+    virtual void on_shutdown() {}
+    virtual float get_setup_priority() const { return 0; }
+
+    // Runs the intervals that are due, called by the host loop instead of the ESPHome scheduler
+    void call_intervals(uint32_t now_ms) {
+      for (auto &interval : this->intervals_) {
+        if (now_ms - interval.last_ms >= interval.interval_ms) {
+          interval.last_ms = now_ms;
+          interval.callback();
+        }
+      }
+    }
+
+  protected:
+    void set_interval(const std::string &name, uint32_t interval_ms, std::function<void()> &&callback) {
+      this->intervals_.push_back({name, interval_ms, 0, std::move(callback)});
+    }
+
+    struct Interval {
+      std::string name;
+      uint32_t interval_ms;
+      uint32_t last_ms;
+      std::function<void()> callback;
+    };
+    std::vector<Interval> intervals_;
+};
+
+}  // namespace esphome
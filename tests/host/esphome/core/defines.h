@@ -0,0 +1,10 @@
+// Author: Dulgheru Mihaita (Since 2022)
+
+// Host build: every transport is compiled in, the trace is left out as in a default configuration
+
+#pragma once
+
+#define USE_KNX_TPUART
+#define USE_KNX_TUNNEL
+#define USE_KNX_ROUTING
+#define USE_KNX_RX_TASK
@@ -0,0 +1,76 @@
+// Author: Dulgheru Mihaita (Since 2022)
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace esphome {
+
+template<typename T> using optional = std::optional<T>;
+
+class Mutex {
+  public:
+    void lock() { this->mutex_.lock(); }
+    bool try_lock() { return this->mutex_.try_lock(); }
+    void unlock() { this->mutex_.unlock(); }
+
+  protected:
+    std::mutex mutex_;
+};
+
+class LockGuard {
+  public:
+    LockGuard(Mutex &mutex) : mutex_(mutex) { this->mutex_.lock(); }
+    ~LockGuard() { this->mutex_.unlock(); }
+
+  protected:
+    Mutex &mutex_;
+};
+
+// Counted like in ESPHome, the host loop runs faster while any requester is started
+class HighFrequencyLoopRequester {
+  public:
+    ~HighFrequencyLoopRequester() { this->stop(); }
+    void start() {
+      if (!this->started_) {
+        this->started_ = true;
+        num_requests_++;
+      }
+    }
+    void stop() {
+      if (this->started_) {
+        this->started_ = false;
+        num_requests_--;
+      }
+    }
+    static bool is_high_frequency() { return num_requests_ > 0; }
+
+  protected:
+    bool started_{false};
+    static inline int num_requests_{0};
+};
+
+template<typename... Ts> class CallbackManager;
+template<typename... Ts> class CallbackManager<void(Ts...)> {
+  public:
+    void add(std::function<void(Ts...)> &&callback) { this->callbacks_.push_back(std::move(callback)); }
+    void call(Ts... args) {
+      for (auto &callback : this->callbacks_) {
+        callback(args...);
+      }
+    }
+
+  protected:
+    std::vector<std::function<void(Ts...)>> callbacks_;
+};
+
+std::string format_hex(const uint8_t *data, size_t length);
+
+}  // namespace esphome
@@ -0,0 +1,5 @@
+// Author: Dulgheru Mihaita (Since 2022)
+
+#pragma once
+
+#include "esphome/components/network/util.h"
@@ -0,0 +1,15 @@
+// Author: Dulgheru Mihaita (Since 2022)
+
+// Host build: tasks are std::threads, see freertos/task.h
+
+#pragma once
+
+#include <cstdint>
+
+#define configTICK_RATE_HZ 1000
+#define pdPASS 1
+#define pdFAIL 0
+
+typedef int BaseType_t;
+typedef uint32_t TickType_t;
+typedef void *TaskHandle_t;
@@ -0,0 +1,12 @@
+// Author: Dulgheru Mihaita (Since 2022)
+
+#pragma once
+
+#include "freertos/FreeRTOS.h"
+
+// Starts a std::thread, core and priority are ignored. On the virtual clock it returns once the task sleeps.
+BaseType_t xTaskCreatePinnedToCore(void (*task)(void *), const char *name, uint32_t stack_depth, void *parameter,
+                                   int priority, TaskHandle_t *handle, int core);
+// Sleeps until the tick ticks from now, on the virtual clock until host::advance_us() gets there. Once
+// host::stop_tasks() has been called it ends the calling task instead.
+void vTaskDelay(TickType_t ticks);
@@ -0,0 +1,290 @@
+// Author: Dulgheru Mihaita (Since 2022)
+
+#include "host_platform.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+#include "esphome/core/hal.h"
+#include "esphome/core/helpers.h"
+#include "esphome/core/log.h"
+#include "esphome/components/socket/socket.h"
+#include "freertos/task.h"
+
+namespace esphome {
+namespace host {
+
+  static std::atomic<bool> real_time{false};
+  static std::atomic<uint64_t> virtual_us{0};
+  static std::chrono::steady_clock::time_point real_start = std::chrono::steady_clock::now();
+
+  // Tasks end by an exception thrown from vTaskDelay(), so the task function needs no way out
+  struct TaskStopped {};
+  // On the virtual clock a task runs only while the thread that advances the clock waits for it, from its start
+  // or a wake up tick until its next vTaskDelay(). Task and loop() never overlap and every run is the same.
+  struct Task {
+    std::thread thread;
+    uint64_t wake_us{0};
+    bool sleeping{false};  // In vTaskDelay() until wake_us
+    bool ended{false};
+  };
+  static std::mutex tasks_lock;
+  static std::condition_variable tasks_changed;
+  static std::vector<std::unique_ptr<Task>> tasks;
+  static std::atomic<bool> tasks_stopping{false};
+  static thread_local Task *current_task = nullptr;
+
+  // Waits with a timeout, condition_variable::wait() is missing from older libstdc++ the tests may run against
+  template<typename P> void wait_tasks(std::unique_lock<std::mutex> &guard, P done) {
+    while (!done()) {
+      tasks_changed.wait_for(guard, std::chrono::milliseconds(10));
+    }
+  }
+
+  void set_real_time(bool enable) {
+    std::lock_guard<std::mutex> guard(tasks_lock);
+    real_start = std::chrono::steady_clock::now() - std::chrono::microseconds(virtual_us.load());
+    real_time = enable;
+    tasks_changed.notify_all();
+  }
+
+  bool is_real_time() { return real_time; }
+
+  void advance_us(uint64_t us) {
+    if (real_time) {
+      return;
+    }
+    if (current_task != nullptr) {
+      virtual_us += us;
+      return;
+    }
+    uint64_t target = virtual_us + us;
+    std::unique_lock<std::mutex> guard(tasks_lock);
+    while (true) {
+      // The task due first runs at its tick until it sleeps again
+      Task *next = nullptr;
+      for (auto &task : tasks) {
+        if (task->sleeping && task->wake_us <= target && (next == nullptr || task->wake_us < next->wake_us)) {
+          next = task.get();
+        }
+      }
+      if (next == nullptr) {
+        break;
+      }
+      if (next->wake_us > virtual_us) {
+        virtual_us = next->wake_us;
+      }
+      next->sleeping = false;
+      tasks_changed.notify_all();
+      wait_tasks(guard, [next] { return next->sleeping || next->ended; });
+    }
+    virtual_us = target;
+  }
+
+  uint64_t now_us() {
+    if (real_time) {
+      return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - real_start).count();
+    }
+    return virtual_us;
+  }
+
+  void reset_clock() {
+    real_time = false;
+    virtual_us = 0;
+  }
+
+  static int log_level() {
+    static int level = [] {
+      const char *env = getenv("KNX_TEST_LOG_LEVEL");
+      return env != nullptr ? atoi(env) : ESPHOME_LOG_LEVEL_WARN;
+    }();
+    return level;
+  }
+  static std::atomic<int> log_threshold{-1};
+  static std::atomic<uint32_t> log_counts[ESPHOME_LOG_LEVEL_VERBOSE + 1];
+
+  void set_log_level(int level) { log_threshold = level; }
+
+  uint32_t get_log_count(int level) { return log_counts[level]; }
+
+  void reset_log_counts() {
+    for (auto &count : log_counts) {
+      count = 0;
+    }
+  }
+
+  void stop_tasks() {
+    std::vector<std::unique_ptr<Task>> stopping;
+    {
+      std::lock_guard<std::mutex> guard(tasks_lock);
+      tasks_stopping = true;
+      stopping.swap(tasks);
+      tasks_changed.notify_all();
+    }
+    for (auto &task : stopping) {
+      task->thread.join();
+    }
+    tasks_stopping = false;
+  }
+
+}  // namespace host
+
+  uint32_t millis() { return host::now_us() / 1000; }
+
+  uint32_t micros() { return host::now_us(); }
+
+  void delay(uint32_t ms) { delayMicroseconds(ms * 1000); }
+
+  void delayMicroseconds(uint32_t us) {
+    if (host::is_real_time()) {
+      std::this_thread::sleep_for(std::chrono::microseconds(us));
+    }
+    else {
+      host::advance_us(us);
+    }
+  }
+
+  std::string format_hex(const uint8_t *data, size_t length) {
+    static const char *const digits = "0123456789abcdef";
+    std::string hex;
+    hex.reserve(length * 2);
+    for (size_t i = 0; i < length; i++) {
+      hex += digits[data[i] >> 4];
+      hex += digits[data[i] & 0x0F];
+    }
+    return hex;
+  }
+
+  void esp_log_printf_(int level, const char *tag, int line, const char *format, ...) {
+    host::log_counts[level]++;
+    int threshold = host::log_threshold >= 0 ? host::log_threshold.load() : host::log_level();
+    if (level > threshold) {
+      return;
+    }
+    static const char *const letters = "?EWICDV";
+    char message[512];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(message, sizeof(message), format, args);
+    va_end(args);
+    fprintf(stderr, "[%c][%s:%d] %s\n", letters[level], tag, line, message);
+  }
+
+namespace socket {
+
+  class HostSocket : public Socket {
+    public:
+      HostSocket(int fd) : fd_(fd) {}
+      ~HostSocket() override { ::close(this->fd_); }
+      int bind(const struct sockaddr *addr, socklen_t addrlen) override { return ::bind(this->fd_, addr, addrlen); }
+      int connect(const struct sockaddr *addr, socklen_t addrlen) override { return ::connect(this->fd_, addr, addrlen); }
+      int getsockname(struct sockaddr *addr, socklen_t *addrlen) override { return ::getsockname(this->fd_, addr, addrlen); }
+      int setsockopt(int level, int optname, const void *optval, socklen_t optlen) override {
+        return ::setsockopt(this->fd_, level, optname, optval, optlen);
+      }
+      ssize_t read(void *buf, size_t len) override { return ::read(this->fd_, buf, len); }
+      ssize_t recvfrom(void *buf, size_t len, struct sockaddr *addr, socklen_t *addrlen) override {
+        return ::recvfrom(this->fd_, buf, len, 0, addr, addrlen);
+      }
+      ssize_t write(const void *buf, size_t len) override { return ::write(this->fd_, buf, len); }
+      ssize_t sendto(const void *buf, size_t len, int flags, const struct sockaddr *to, socklen_t tolen) override {
+        return ::sendto(this->fd_, buf, len, flags, to, tolen);
+      }
+      int setblocking(bool blocking) override {
+        int flags = fcntl(this->fd_, F_GETFL, 0);
+        return fcntl(this->fd_, F_SETFL, blocking ? flags & ~O_NONBLOCK : flags | O_NONBLOCK);
+      }
+      int get_fd() override { return this->fd_; }
+
+    protected:
+      int fd_;
+  };
+
+  std::unique_ptr<Socket> socket(int domain, int type, int protocol) {
+    int fd = ::socket(domain, type, protocol);
+    if (fd < 0) {
+      return nullptr;
+    }
+    return std::unique_ptr<Socket>{new HostSocket(fd)};
+  }
+
+  std::unique_ptr<Socket> socket_ip(int type, int protocol) { return socket(AF_INET, type, protocol); }
+
+  socklen_t set_sockaddr(struct sockaddr *addr, socklen_t addrlen, const std::string &ip_address, uint16_t port) {
+    if (addrlen < sizeof(struct sockaddr_in)) {
+      return 0;
+    }
+    auto *server = reinterpret_cast<struct sockaddr_in *>(addr);
+    memset(server, 0, sizeof(struct sockaddr_in));
+    server->sin_family = AF_INET;
+    server->sin_port = htons(port);
+    if (inet_pton(AF_INET, ip_address.c_str(), &server->sin_addr) != 1) {
+      return 0;
+    }
+    return sizeof(struct sockaddr_in);
+  }
+
+  socklen_t set_sockaddr_any(struct sockaddr *addr, socklen_t addrlen, uint16_t port) {
+    return set_sockaddr(addr, addrlen, "0.0.0.0", port);
+  }
+
+}  // namespace socket
+}  // namespace esphome
+
+BaseType_t xTaskCreatePinnedToCore(void (*task)(void *), const char *name, uint32_t stack_depth, void *parameter,
+                                   int priority, TaskHandle_t *handle, int core) {
+  using namespace esphome::host;
+  std::unique_lock<std::mutex> guard(tasks_lock);
+  tasks.push_back(std::unique_ptr<Task>{new Task()});
+  Task *created = tasks.back().get();
+  // Set before the task runs, as FreeRTOS does
+  if (handle != nullptr) {
+    *handle = created;
+  }
+  created->thread = std::thread([task, parameter, created] {
+    current_task = created;
+    try {
+      task(parameter);
+    }
+    catch (const TaskStopped &) {
+    }
+    std::lock_guard<std::mutex> guard(tasks_lock);
+    created->ended = true;
+    tasks_changed.notify_all();
+  });
+  // On the virtual clock the creator waits until the task has run up to its first vTaskDelay()
+  wait_tasks(guard, [created] { return created->sleeping || created->ended || real_time; });
+  return pdPASS;
+}
+
+void vTaskDelay(TickType_t ticks) {
+  using namespace esphome::host;
+  if (tasks_stopping) {
+    throw TaskStopped();
+  }
+  if (real_time || current_task == nullptr) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(ticks * 1000 / configTICK_RATE_HZ));
+    return;
+  }
+  // Woken at a tick boundary, like FreeRTOS
+  const uint64_t tick_us = 1000000 / configTICK_RATE_HZ;
+  std::unique_lock<std::mutex> guard(tasks_lock);
+  current_task->wake_us = (virtual_us / tick_us + ticks) * tick_us;
+  current_task->sleeping = true;
+  tasks_changed.notify_all();
+  wait_tasks(guard, [] { return !current_task->sleeping || tasks_stopping || real_time; });
+  current_task->sleeping = false;
+  if (tasks_stopping) {
+    throw TaskStopped();
+  }
+}
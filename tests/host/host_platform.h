@@ -0,0 +1,31 @@
+// Author: Dulgheru Mihaita (Since 2022)
+
+// Controls of the host platform behind the ESPHome stand-ins, used by the tests
+
+#pragma once
+
+#include <cstdint>
+
+namespace esphome {
+namespace host {
+
+// The clock is virtual by default: it only moves when a test advances it (or delay() is called),
+// so a run sees the same timing every time. Tasks are run at their ticks while it is advanced.
+void set_real_time(bool real_time);
+bool is_real_time();
+void advance_us(uint64_t us);
+uint64_t now_us();
+// Back to virtual time 0
+void reset_clock();
+
+// Messages up to this level are printed, all are counted. The default is ESPHOME_LOG_LEVEL_WARN,
+// KNX_TEST_LOG_LEVEL in the environment overrides it.
+void set_log_level(int level);
+uint32_t get_log_count(int level);
+void reset_log_counts();
+
+// Ends every task started with xTaskCreatePinnedToCore() at its next vTaskDelay() and waits for it
+void stop_tasks();
+
+}  // namespace host
+}  // namespace esphome
@@ -0,0 +1,276 @@
+// Author: Dulgheru Mihaita (Since 2022)
+
+// Per frame cost of the telegram layer and of the receive path, in ns and heap allocations per frame.
+// Frame mixes: DPT 1 switching, DPT 9 sensors, DPT 16 text and a mix of the three (60/30/10 %).
+// The receive path (UART, filter, ACK, read_knx_telegram(), dispatch) is swept over listen tables of 1 to 1000.
+//   knx_bench [--quick]
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <random>
+#include <vector>
+#include "alloc_counter.h"
+#include "automation.h"
+#include "host_platform.h"
+#include "knx_component.h"
+#include "knx_frames.h"
+#include "knx_tpuart_transport.h"
+
+namespace esphome {
+namespace knx {
+
+  static const int BENCH_FRAMES = 1000;
+
+  enum BenchMix { MIX_DPT1, MIX_DPT9, MIX_DPT16, MIX_ALL };
+  static const char *const MIX_NAMES[] = {"DPT1", "DPT9", "DPT16", "mix"};
+
+  // Replays a byte stream of frames as if all of it had arrived, the ACK requests are only counted
+  class BenchUart : public uart::UARTComponent {
+    public:
+      BenchUart() { this->set_rx_buffer_size(1 << 20); }
+      void load(const std::vector<uint8_t> &stream) {
+        this->stream_ = stream;
+        this->position_ = 0;
+      }
+      void write_array(const uint8_t *data, size_t length) override { this->written_ += length; }
+      bool peek_byte(uint8_t *data) override {
+        if (this->position_ == this->stream_.size()) {
+          return false;
+        }
+        *data = this->stream_[this->position_];
+        return true;
+      }
+      bool read_array(uint8_t *data, size_t length) override {
+        if (this->stream_.size() - this->position_ < length) {
+          return false;
+        }
+        memcpy(data, &this->stream_[this->position_], length);
+        this->position_ += length;
+        return true;
+      }
+      int available() override { return this->stream_.size() - this->position_; }
+      void flush() override {}
+
+    protected:
+      std::vector<uint8_t> stream_;
+      size_t position_{0};
+      size_t written_{0};
+  };
+
+  struct BenchFrame {
+    int dpt;
+    KnxStandardTelegram telegram;
+  };
+
+  // Targets come from addresses, a share of hit_percent of them; the others are outside the listen table.
+  // Sources and values change from frame to frame, as on a real line, so the receive dedup lets them through.
+  static std::vector<BenchFrame> make_frames(BenchMix mix, const std::vector<KnxGroupAddress> &addresses,
+                                             int hit_percent, std::mt19937 &random) {
+    static const char *const texts[] = {"Living room", "OK", "Window open", "Alarm 14 chars"};
+    std::vector<BenchFrame> frames(BENCH_FRAMES);
+    for (int i = 0; i < BENCH_FRAMES; i++) {
+      int roll = random() % 100;
+      int dpt = mix == MIX_DPT1 ? 1 : mix == MIX_DPT9 ? 9 : mix == MIX_DPT16 ? 16 : roll < 60 ? 1 : roll < 90 ? 9 : 16;
+      KnxGroupAddress target = (int) (random() % 100) < hit_percent ? addresses[random() % addresses.size()]
+                                                                    : KnxGroupAddress(31, 7, random() % 256);
+      KnxTelegram &telegram = frames[i].telegram;
+      frames[i].dpt = dpt;
+      telegram.set_source_address(TEST_SOURCE_AREA, TEST_SOURCE_LINE, 1 + i % 250);
+      telegram.set_target_group_address(target);
+      telegram.set_command(KNX_COMMAND_WRITE);
+      if (dpt == 1) {
+        telegram.set<Dpt<1>>(i & 1);
+      }
+      else if (dpt == 9) {
+        telegram.set<Dpt<9>>(15.0f + (random() % 1000) / 100.0f);
+      }
+      else {
+        telegram.set<Dpt<16>>(texts[i % 4]);
+      }
+      telegram.create_checksum();
+    }
+    return frames;
+  }
+
+  // Listen addresses spread over the whole address space
+  static std::vector<KnxGroupAddress> make_addresses(int count) {
+    std::vector<KnxGroupAddress> addresses;
+    for (int i = 0; i < count; i++) {
+      addresses.push_back(KnxGroupAddress((i * 7919) % 0x7FFF));
+    }
+    return addresses;
+  }
+
+  struct BenchResult {
+    double ns_per_frame;
+    double allocations_per_frame;
+  };
+
+  // Runs body(frame) over all frames, rounds times
+  static BenchResult measure(const std::vector<BenchFrame> &frames, int rounds,
+                             const std::function<void(const BenchFrame &)> &body) {
+    for (auto &frame : frames) {
+      body(frame);
+    }
+    uint64_t allocations = get_allocation_count();
+    auto start = std::chrono::steady_clock::now();
+    for (int round = 0; round < rounds; round++) {
+      for (auto &frame : frames) {
+        body(frame);
+      }
+    }
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    double count = (double) rounds * frames.size();
+    return {ns / count, (get_allocation_count() - allocations) / count};
+  }
+
+  static void print(const char *name, const char *mix, int listen, BenchResult result) {
+    char label[64];
+    if (listen > 0) {
+      snprintf(label, sizeof(label), "%s %s, listen %d", name, mix, listen);
+    }
+    else {
+      snprintf(label, sizeof(label), "%s %s", name, mix);
+    }
+    printf("%-48s %10.1f %14.2f\n", label, result.ns_per_frame, result.allocations_per_frame);
+  }
+
+  static volatile int sink;
+
+  static void bench_telegram(BenchMix mix, int rounds, std::mt19937 &random) {
+    auto frames = make_frames(mix, make_addresses(100), 50, random);
+    KnxStandardTelegram scratch;
+
+    print("encode", MIX_NAMES[mix], 0, measure(frames, rounds, [&](const BenchFrame &frame) {
+      KnxTelegram &source = const_cast<KnxStandardTelegram &>(frame.telegram);
+      scratch.clear();
+      scratch.set_source_address(TEST_SOURCE_AREA, TEST_SOURCE_LINE, source.get_source_member());
+      scratch.set_target_group_address(source.get_target_group_address());
+      scratch.set_command(KNX_COMMAND_WRITE);
+      if (frame.dpt == 1) {
+        scratch.set<Dpt<1>>(true);
+      }
+      else if (frame.dpt == 9) {
+        scratch.set<Dpt<9>>(21.5f);
+      }
+      else {
+        scratch.set<Dpt<16>>("Living room");
+      }
+      scratch.create_checksum();
+      sink = scratch.data()[scratch.get_total_length() - 1];
+    }));
+
+    print("decode", MIX_NAMES[mix], 0, measure(frames, rounds, [&](const BenchFrame &frame) {
+      memcpy(scratch.data(), frame.telegram.data(), const_cast<KnxStandardTelegram &>(frame.telegram).get_total_length());
+      int value = scratch.verify_checksum() + scratch.get_target_group_address().raw() + scratch.get_command() +
+                  scratch.get_source_member();
+      if (frame.dpt == 1) {
+        value += scratch.get<Dpt<1>>().value_or(false);
+      }
+      else if (frame.dpt == 9) {
+        value += (int) scratch.get<Dpt<9>>().value_or(0.0f);
+      }
+      else {
+        value += scratch.get<Dpt<16>>().has_value();
+      }
+      sink = value;
+    }));
+
+    print("create_checksum", MIX_NAMES[mix], 0, measure(frames, rounds, [&](const BenchFrame &frame) {
+      memcpy(scratch.data(), frame.telegram.data(), const_cast<KnxStandardTelegram &>(frame.telegram).get_total_length());
+      scratch.create_checksum();
+      sink = scratch.get_checksum();
+    }));
+
+    print("get_target_group (std::string)", MIX_NAMES[mix], 0, measure(frames, rounds, [&](const BenchFrame &frame) {
+      sink = const_cast<KnxStandardTelegram &>(frame.telegram).get_target_group().size();
+    }));
+  }
+
+  static void bench_listen_table(int listen, int rounds, std::mt19937 &random) {
+    auto addresses = make_addresses(listen);
+    auto frames = make_frames(MIX_ALL, addresses, 50, random);
+    KnxComponent knx;
+    for (auto address : addresses) {
+      knx.add_listen_group_address(address);
+    }
+    print("is_listening_to_group_address", MIX_NAMES[MIX_ALL], listen, measure(frames, rounds, [&](const BenchFrame &frame) {
+      sink = knx.is_listening_to_group_address(const_cast<KnxStandardTelegram &>(frame.telegram).get_target_group_address());
+    }));
+  }
+
+  // Frames through KnxTpuartTransport and KnxComponent::loop(), a trigger for every listened address
+  static void bench_receive(BenchMix mix, int listen, int rounds, std::mt19937 &random) {
+    auto addresses = make_addresses(listen);
+    auto frames = make_frames(mix, addresses, 50, random);
+    std::vector<uint8_t> stream;
+    for (auto &frame : frames) {
+      const uint8_t *data = frame.telegram.data();
+      stream.insert(stream.end(), data, data + const_cast<KnxStandardTelegram &>(frame.telegram).get_total_length());
+    }
+
+    BenchUart uart;
+    KnxTpuartTransport transport(&uart);
+    KnxComponent knx;
+    knx.set_transport(&transport);
+    knx.set_individual_address(1, 1, 10);
+    knx.set_serial_timeout(1000);
+    std::vector<std::unique_ptr<KnxGroupTrigger>> triggers;
+    uint32_t dispatched = 0;
+    for (auto address : addresses) {
+      triggers.emplace_back(new KnxGroupTrigger(&knx, address, KNX_COMMAND_WRITE));
+      triggers.back()->set_callback([&dispatched](KnxTelegram *telegram) { dispatched++; });
+    }
+    knx.setup();
+
+    // One loop() takes the whole stream, the clock moves on so no frame counts as a repetition of the last round
+    std::vector<BenchFrame> replay(1);
+    BenchResult result = measure(replay, rounds, [&](const BenchFrame &) {
+      host::advance_us(2000000);
+      uart.load(stream);
+      knx.loop();
+    });
+    result.ns_per_frame /= frames.size();
+    result.allocations_per_frame /= frames.size();
+    print("receive path", MIX_NAMES[mix], listen, result);
+    if (dispatched == 0 || knx.get_metrics().rx_frames != (rounds + 1) * frames.size()) {
+      printf("  unexpected: %u dispatched, %u frames received\n", dispatched, knx.get_metrics().rx_frames);
+    }
+  }
+
+}  // namespace knx
+}  // namespace esphome
+
+int main(int argc, char **argv) {
+  using namespace esphome::knx;
+  bool quick = argc > 1 && strcmp(argv[1], "--quick") == 0;
+  int rounds = quick ? 2 : 200;
+  std::mt19937 random(1);
+  esphome::host::reset_clock();
+
+  // The counter has to see this one, or every allocs/frame below would read 0
+  uint64_t allocations = get_allocation_count();
+  delete new std::vector<int>(1);
+  if (get_allocation_count() == allocations) {
+    printf("operator new is not counted\n");
+    return 1;
+  }
+
+  printf("%-48s %10s %14s\n", "", "ns/frame", "allocs/frame");
+  for (BenchMix mix : {MIX_DPT1, MIX_DPT9, MIX_DPT16, MIX_ALL}) {
+    bench_telegram(mix, rounds, random);
+  }
+  for (int listen : {1, 10, 100, 1000}) {
+    bench_listen_table(listen, rounds, random);
+  }
+  for (BenchMix mix : {MIX_DPT1, MIX_DPT9, MIX_DPT16, MIX_ALL}) {
+    bench_receive(mix, 100, rounds / 2 + 1, random);
+  }
+  for (int listen : {1, 10, 100, 1000}) {
+    bench_receive(MIX_ALL, listen, rounds / 2 + 1, random);
+  }
+  return 0;
+}
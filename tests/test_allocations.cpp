@@ -0,0 +1,111 @@
+// Author: Dulgheru Mihaita (Since 2022)
+
+// Once running, receiving, filtering, acknowledging, dispatching, sending and confirming telegrams must not
+// touch the heap. Allocations of the simulated TPUART are not counted.
+
+#include "alloc_counter.h"
+#include "tpuart_fixture.h"
+
+namespace esphome {
+namespace knx {
+
+  static const KnxGroupAddress LIGHT(1, 2, 3);
+  static const KnxGroupAddress TEMPERATURE(1, 2, 4);
+  static const KnxGroupAddress TEXT(1, 2, 5);
+  static const KnxGroupAddress OTHER(3, 0, 1);
+
+  class AllocationTest : public TpuartFixture {
+    protected:
+      void SetUp() override {
+        TpuartFixture::SetUp();
+        // Triggers that read the value like a lambda would, without keeping copies
+        for (KnxGroupAddress address : {LIGHT, TEMPERATURE, TEXT}) {
+          this->triggers_.emplace_back(new KnxGroupTrigger(&this->knx, address, KNX_COMMAND_WRITE));
+          this->triggers_.back()->set_callback([this](KnxTelegram *telegram) {
+            this->dispatched_++;
+            this->value_ += telegram->get<Dpt<9>>().value_or(0.0f);
+          });
+        }
+        this->start();
+      }
+
+      // Group writes of all three kinds, one to an address nobody listens to and a group read
+      void inject_traffic(int round) {
+        int source = 1 + round % 200;
+        this->sim.inject_frame(group_frame<Dpt<1>>(LIGHT, KNX_COMMAND_WRITE, round & 1, source));
+        this->sim.inject_frame(group_frame<Dpt<9>>(TEMPERATURE, KNX_COMMAND_WRITE, 20.0f + round / 10.0f, source));
+        this->sim.inject_frame(group_frame<Dpt<16>>(TEXT, KNX_COMMAND_WRITE, round & 1 ? "Open" : "Closed", source));
+        this->sim.inject_frame(group_frame<Dpt<1>>(OTHER, KNX_COMMAND_WRITE, true, source));
+        this->sim.inject_frame(group_read_frame(LIGHT, source));
+      }
+
+      void send_traffic(int round) {
+        this->knx.group_write<Dpt<1>>(LIGHT, round & 1);
+        this->knx.group_write<Dpt<9>>(TEMPERATURE, 20.0f + round / 10.0f);
+        this->knx.group_write<Dpt<16>>(TEXT, round & 1 ? "Open" : "Closed", KNX_PRIORITY_HIGH);
+      }
+
+      uint32_t dispatched_{0};
+      float value_{0};
+  };
+
+  // The counter sees what a handler allocates, so the zeros below are not for lack of counting
+  TEST_F(AllocationTest, CountsAllocationsOfAHandler) {
+    this->watch(LIGHT, KNX_COMMAND_WRITE);
+    this->inject_traffic(0);
+    uint64_t before = get_allocation_count();
+    this->run_until_idle();
+    EXPECT_GT(get_allocation_count(), before);
+  }
+
+  TEST_F(AllocationTest, ReceivesWithoutAllocating) {
+    this->inject_traffic(0);
+    this->run_until_idle();
+
+    uint64_t allocations = 0;
+    for (int round = 1; round <= 100; round++) {
+      this->inject_traffic(round);
+      uint64_t before = get_allocation_count();
+      this->run_until_idle();
+      allocations += get_allocation_count() - before;
+    }
+    EXPECT_EQ(allocations, 0u);
+    EXPECT_EQ(this->knx.get_metrics().rx_frames, 505u);
+    EXPECT_EQ(this->dispatched_, 303u);
+  }
+
+  TEST_F(AllocationTest, SendsAndConfirmsWithoutAllocating) {
+    this->send_traffic(0);
+    this->run_until_idle();
+
+    uint64_t allocations = 0;
+    for (int round = 1; round <= 100; round++) {
+      uint64_t before = get_allocation_count();
+      this->send_traffic(round);
+      this->run_until_idle();
+      allocations += get_allocation_count() - before;
+    }
+    EXPECT_EQ(allocations, 0u);
+    EXPECT_EQ(this->knx.get_metrics().tx_confirmed, 303u);
+    EXPECT_EQ(this->sim.get_tx_frames().size(), 303u);
+  }
+
+  TEST_F(AllocationTest, HandlesMixedTrafficWithoutAllocating) {
+    this->inject_traffic(0);
+    this->send_traffic(0);
+    this->run_until_idle();
+
+    uint64_t allocations = 0;
+    for (int round = 1; round <= 100; round++) {
+      this->inject_traffic(round);
+      uint64_t before = get_allocation_count();
+      this->send_traffic(round);
+      this->run_until_idle();
+      allocations += get_allocation_count() - before;
+    }
+    EXPECT_EQ(allocations, 0u);
+    EXPECT_EQ(this->knx.get_metrics().tx_confirmed, 303u);
+  }
+
+}  // namespace knx
+}  // namespace esphome
@@ -0,0 +1,177 @@
+// Author: Dulgheru Mihaita (Since 2022)
+
+// TP1 to cEMI and back, and the bus capture written as an ETS trace and read back
+
+#include <regex>
+#include <string>
+#include <vector>
+#include <gtest/gtest.h>
+#include "knx_bus_capture.h"
+#include "knx_cemi.h"
+#include "knx_frames.h"
+
+namespace esphome {
+namespace knx {
+
+  static const KnxGroupAddress LIGHT(1, 2, 3);
+
+  // The TP1 frame of a cEMI frame, with its checksum
+  static std::vector<uint8_t> tp_frame(const std::vector<uint8_t> &cemi) {
+    KnxExtendedTelegram telegram;
+    int length = knx_cemi_to_tp(cemi.data(), cemi.size(), telegram.data(), telegram.get_capacity());
+    if (length == 0) {
+      return {};
+    }
+    telegram.create_checksum();
+    return std::vector<uint8_t>(telegram.data(), telegram.data() + length);
+  }
+
+  static std::vector<uint8_t> cemi_frame(uint8_t message_code, const std::vector<uint8_t> &frame) {
+    std::vector<uint8_t> cemi(KNX_CEMI_MAX_SIZE);
+    cemi.resize(knx_tp_to_cemi(message_code, frame.data(), frame.size(), cemi.data()));
+    return cemi;
+  }
+
+  static std::vector<uint8_t> from_hex(const std::string &hex) {
+    std::vector<uint8_t> bytes;
+    for (size_t i = 0; i + 1 < hex.size(); i += 2) {
+      bytes.push_back(std::stoi(hex.substr(i, 2), nullptr, 16));
+    }
+    return bytes;
+  }
+
+  TEST(CemiTest, ConvertsAStandardFrame) {
+    auto frame = group_frame<Dpt<9>>(LIGHT, KNX_COMMAND_WRITE, 21.5f);
+    auto cemi = cemi_frame(KNX_CEMI_L_DATA_IND, frame);
+    // Message code, no additional info, control fields 1 and 2, 1.1.20 to 1/2/3, NPDU length 3
+    ASSERT_EQ(cemi.size(), (size_t) KNX_CEMI_HEADER_SIZE + 4);
+    EXPECT_EQ(cemi[0], KNX_CEMI_L_DATA_IND);
+    EXPECT_EQ(cemi[1], 0);
+    EXPECT_EQ(cemi[2], 0xBC);
+    EXPECT_EQ(cemi[3], 0xE0);
+    EXPECT_EQ(cemi[4], 0x11);
+    EXPECT_EQ(cemi[5], 20);
+    EXPECT_EQ((cemi[6] << 8) | cemi[7], LIGHT.raw());
+    EXPECT_EQ(cemi[8], 3);
+    EXPECT_EQ(tp_frame(cemi), frame);
+  }
+
+  TEST(CemiTest, ConvertsAnExtendedFrame) {
+    for (int length : {16, 100, MAX_KNX_EXTENDED_PAYLOAD_SIZE - 2}) {
+      SCOPED_TRACE(length);
+      auto frame = extended_frame(LIGHT, length);
+      auto cemi = cemi_frame(KNX_CEMI_L_DATA_IND, frame);
+      ASSERT_FALSE(cemi.empty());
+      EXPECT_EQ(cemi[2] & 0b10000000, 0);
+      EXPECT_EQ(cemi[8], length + 1);
+      EXPECT_EQ(tp_frame(cemi), frame);
+    }
+  }
+
+  // Additional info is skipped, a payload too long for a standard frame makes an extended one
+  TEST(CemiTest, ReadsCemiFromOtherDevices) {
+    auto frame = group_frame<Dpt<5>>(LIGHT, KNX_COMMAND_WRITE, 7);
+    auto cemi = cemi_frame(KNX_CEMI_L_DATA_IND, frame);
+    std::vector<uint8_t> with_info = {cemi[0], 4, 0x03, 0x02, 0x12, 0x34};
+    with_info.insert(with_info.end(), cemi.begin() + 2, cemi.end());
+    EXPECT_EQ(tp_frame(with_info), frame);
+
+    auto extended = extended_frame(LIGHT, 20);
+    cemi = cemi_frame(KNX_CEMI_L_DATA_IND, extended);
+    cemi[2] |= 0b10000000;
+    EXPECT_EQ(tp_frame(cemi), extended);
+
+    // Shorter than its NPDU length says
+    cemi.pop_back();
+    EXPECT_TRUE(tp_frame(cemi).empty());
+  }
+
+  class BusCaptureTest : public ::testing::Test {
+    protected:
+      // Telegram elements of the trace: service, frame
+      std::vector<std::pair<std::string, std::vector<uint8_t>>> read_trace() {
+        static const std::regex telegram(
+          "<Telegram Timestamp=\"([0-9T:.Z-]+)\" Service=\"(L_Data\\.ind|L_Data\\.con)\" FrameFormat=\"CommonEmi\" RawData=\"([0-9A-F]+)\" />");
+        std::vector<std::pair<std::string, std::vector<uint8_t>>> telegrams;
+        for (auto &line : this->lines) {
+          std::smatch match;
+          if (std::regex_match(line, match, telegram)) {
+            telegrams.emplace_back(match[2], from_hex(match[3]));
+          }
+        }
+        return telegrams;
+      }
+
+      void write_trace() {
+        this->lines.clear();
+        this->capture.write_ets_trace([this](const char *line) { this->lines.push_back(line); });
+      }
+
+      KnxBusCapture capture{8};
+      std::vector<std::string> lines;
+  };
+
+  TEST_F(BusCaptureTest, WritesAnEtsTraceThatReadsBack) {
+    std::vector<std::vector<uint8_t>> frames = {
+      group_frame<Dpt<1>>(LIGHT, KNX_COMMAND_WRITE, true),
+      group_frame<Dpt<9>>(LIGHT, KNX_COMMAND_ANSWER, -5.0f),
+      group_frame<Dpt<16>>(LIGHT, KNX_COMMAND_WRITE, "Window open"),
+      group_read_frame(LIGHT),
+    };
+    KnxCaptureResult results[] = {KNX_CAPTURE_RX_ACK, KNX_CAPTURE_RX_NOT_ADDRESSED, KNX_CAPTURE_TX_CONFIRMED,
+                                  KNX_CAPTURE_TX_NACKED};
+    for (size_t i = 0; i < frames.size(); i++) {
+      this->capture.record(frames[i].data(), frames[i].size(), 3723000000u + i * 1500, results[i]);
+    }
+    this->write_trace();
+
+    ASSERT_EQ(this->lines.size(), frames.size() + 3);
+    EXPECT_EQ(this->lines[1], "<CommunicationLog xmlns=\"http://knx.org/xml/telegrams/01\">");
+    EXPECT_EQ(this->lines.back(), "</CommunicationLog>");
+    // 1 h 2 min 3 s after boot
+    EXPECT_NE(this->lines[3].find("Timestamp=\"1970-01-01T01:02:03.001500Z\""), std::string::npos);
+
+    auto telegrams = this->read_trace();
+    ASSERT_EQ(telegrams.size(), frames.size());
+    for (size_t i = 0; i < frames.size(); i++) {
+      SCOPED_TRACE(i);
+      EXPECT_EQ(telegrams[i].first, i < 2 ? "L_Data.ind" : "L_Data.con");
+      EXPECT_EQ(tp_frame(telegrams[i].second), frames[i]);
+    }
+    // The confirm bit of control field 1 flags the failed send
+    EXPECT_EQ(telegrams[2].second[2] & 0b00000001, 0);
+    EXPECT_EQ(telegrams[3].second[2] & 0b00000001, 1);
+  }
+
+  TEST_F(BusCaptureTest, FlagsTruncatedFrames) {
+    auto extended = extended_frame(LIGHT, 60);
+    auto standard = group_frame<Dpt<1>>(LIGHT, KNX_COMMAND_WRITE, false);
+    this->capture.record(extended.data(), extended.size(), 1000, KNX_CAPTURE_RX_ACK);
+    this->capture.record(standard.data(), standard.size(), 2000, KNX_CAPTURE_RX_ACK);
+    this->write_trace();
+
+    EXPECT_EQ(this->capture.get_truncated(), 1u);
+    ASSERT_EQ(this->lines.size(), 5u);
+    EXPECT_EQ(this->lines[2], "<!-- 1970-01-01T00:00:00.001000Z received frame of " + std::to_string(extended.size()) +
+                              " bytes, truncated in the capture -->");
+    auto telegrams = this->read_trace();
+    ASSERT_EQ(telegrams.size(), 1u);
+    EXPECT_EQ(tp_frame(telegrams[0].second), standard);
+  }
+
+  // Only the last size frames are kept, oldest first
+  TEST_F(BusCaptureTest, KeepsTheLastFrames) {
+    for (int i = 0; i < 20; i++) {
+      auto frame = group_frame<Dpt<5>>(LIGHT, KNX_COMMAND_WRITE, i);
+      this->capture.record(frame.data(), frame.size(), i, KNX_CAPTURE_RX_ACK);
+    }
+    this->write_trace();
+    auto telegrams = this->read_trace();
+    ASSERT_EQ(telegrams.size(), 8u);
+    EXPECT_EQ(tp_frame(telegrams[0].second)[8], 12);
+    EXPECT_EQ(tp_frame(telegrams[7].second)[8], 19);
+    EXPECT_EQ(this->capture.get_recorded(), 20u);
+  }
+
+}  // namespace knx
+}  // namespace esphome
@@ -0,0 +1,141 @@
+// Author: Dulgheru Mihaita (Since 2022)
+
+// The bus monitor: eviction in the heavy hitter sketch and the frame and bit rates with TP1 timing
+
+#include <cstdlib>
+#include <map>
+#include <tuple>
+#include <vector>
+#include <gtest/gtest.h>
+#include "knx_bus_monitor.h"
+
+namespace esphome {
+namespace knx {
+
+  using Top = std::vector<std::tuple<uint16_t, uint32_t, uint32_t>>;
+
+  template<int N> static Top top(const KnxHeavyHitters<N> &sketch, int n = N) {
+    Top entries;
+    sketch.for_each_top(n, [&entries](uint16_t key, uint32_t count, uint32_t error) {
+      entries.emplace_back(key, count, error);
+    });
+    return entries;
+  }
+
+  static KnxStandardTelegram telegram(int member, const KnxGroupAddress &target, int payload_length) {
+    KnxStandardTelegram telegram;
+    telegram.set_source_address(1, 1, member);
+    telegram.set_target_group_address(target);
+    telegram.set_payload_length(payload_length);
+    return telegram;
+  }
+
+  // The smallest entry, the first of equals, gives way and hands its count on as error bound
+  TEST(HeavyHittersTest, EvictsTheSmallestEntry) {
+    KnxHeavyHitters<4> sketch;
+    for (uint16_t key : {10, 10, 10, 20, 20, 30, 40}) {
+      sketch.add(key);
+    }
+    EXPECT_EQ(top(sketch), (Top{{10, 3, 0}, {20, 2, 0}, {30, 1, 0}, {40, 1, 0}}));
+
+    sketch.add(50);
+    EXPECT_EQ(top(sketch), (Top{{10, 3, 0}, {20, 2, 0}, {50, 2, 1}, {40, 1, 0}}));
+    sketch.add(60);
+    EXPECT_EQ(top(sketch), (Top{{10, 3, 0}, {20, 2, 0}, {50, 2, 1}, {60, 2, 1}}));
+    // A tracked key only counts up, whatever its error
+    sketch.add(50);
+    EXPECT_EQ(top(sketch, 2), (Top{{10, 3, 0}, {50, 3, 1}}));
+
+    sketch.clear();
+    EXPECT_TRUE(top(sketch).empty());
+    sketch.add(70);
+    EXPECT_EQ(top(sketch), (Top{{70, 1, 0}}));
+  }
+
+  // Keys seen more than total / N times stay in the table under a stream of one-off keys,
+  // with count - error <= true count <= count for every entry
+  TEST(HeavyHittersTest, KeepsEveryKeyAboveTheThreshold) {
+    KnxHeavyHitters<8> sketch;
+    std::map<uint16_t, uint32_t> counts;
+    srand(1);
+    uint32_t total = 0;
+    for (int i = 0; i < 4000; i++) {
+      uint16_t key = i % 4 == 0 ? 0x1101 : i % 8 == 1 || i % 16 == 3 ? 0x1102 : 0x2000 + rand() % 3000;
+      sketch.add(key);
+      counts[key]++;
+      total++;
+    }
+    ASSERT_GT(counts[0x1101], total / 8);
+    ASSERT_GT(counts[0x1102], total / 8);
+
+    Top entries = top(sketch);
+    ASSERT_EQ(entries.size(), 8u);
+    EXPECT_EQ(std::get<0>(entries[0]), 0x1101);
+    EXPECT_EQ(std::get<0>(entries[1]), 0x1102);
+    for (size_t i = 0; i < entries.size(); i++) {
+      uint16_t key = std::get<0>(entries[i]);
+      uint32_t count = std::get<1>(entries[i]);
+      uint32_t error = std::get<2>(entries[i]);
+      EXPECT_LE(count - error, counts[key]) << key;
+      EXPECT_GE(count, counts[key]) << key;
+      if (i > 0) {
+        EXPECT_LE(count, std::get<1>(entries[i - 1]));
+      }
+    }
+  }
+
+  // 13 bit times per character plus the idle time and ACK of each frame, over the window since the last call
+  TEST(BusMonitorTest, EstimatesRatesWithTp1Timing) {
+    KnxBusMonitor monitor;
+    KnxStandardTelegram frame = telegram(1, KnxGroupAddress(1, 2, 3), 2);
+    const uint32_t frame_bits = frame.get_total_length() * 13 + 76;
+    ASSERT_EQ(frame.get_total_length(), 9);
+
+    for (int i = 0; i < 10; i++) {
+      monitor.record(&frame, true);
+    }
+    monitor.update_rates(1000);
+    EXPECT_FLOAT_EQ(monitor.get_frames_per_second(), 10.0f);
+    EXPECT_FLOAT_EQ(monitor.get_bits_per_second(), 10.0f * frame_bits);
+    EXPECT_FLOAT_EQ(monitor.get_bus_load(), 10.0f * frame_bits * 100.0f / 9600.0f);
+
+    // The next window only counts what came after, over its own length
+    KnxStandardTelegram longer = telegram(2, KnxGroupAddress(1, 2, 4), 15);
+    ASSERT_EQ(longer.get_total_length(), 22);
+    monitor.record(&frame, true);
+    monitor.record(&longer, true);
+    monitor.update_rates(1500);
+    EXPECT_FLOAT_EQ(monitor.get_frames_per_second(), 4.0f);
+    EXPECT_FLOAT_EQ(monitor.get_bits_per_second(), (frame_bits + 22 * 13 + 76) * 2.0f);
+
+    // No time passed, the rates stay
+    monitor.update_rates(1500);
+    EXPECT_FLOAT_EQ(monitor.get_frames_per_second(), 4.0f);
+    monitor.update_rates(2500);
+    EXPECT_FLOAT_EQ(monitor.get_frames_per_second(), 0.0f);
+    EXPECT_FLOAT_EQ(monitor.get_bus_load(), 0.0f);
+  }
+
+  // A corrupt frame took its time on the line, but its addresses are not to be trusted
+  TEST(BusMonitorTest, CountsInvalidFramesOnlyForTheLoad) {
+    KnxBusMonitor monitor;
+    KnxStandardTelegram good = telegram(5, KnxGroupAddress(3, 1, 7), 2);
+    KnxStandardTelegram bad = telegram(9, KnxGroupAddress(4, 0, 1), 2);
+    monitor.record(&good, true);
+    monitor.record(&good, true);
+    monitor.record(&bad, false);
+    monitor.update_rates(1000);
+    EXPECT_FLOAT_EQ(monitor.get_frames_per_second(), 3.0f);
+
+    EXPECT_EQ(top(monitor.get_sources()), (Top{{0x1105, 2, 0}}));
+    EXPECT_EQ(top(monitor.get_groups()), (Top{{KnxGroupAddress(3, 1, 7).raw(), 2, 0}}));
+
+    // clear() resets the top lists, the rates are left to update_rates()
+    monitor.clear();
+    EXPECT_TRUE(top(monitor.get_sources()).empty());
+    EXPECT_TRUE(top(monitor.get_groups()).empty());
+    EXPECT_FLOAT_EQ(monitor.get_frames_per_second(), 3.0f);
+  }
+
+}  // namespace knx
+}  // namespace esphome
@@ -0,0 +1,127 @@
+// Author: Dulgheru Mihaita (Since 2022)
+
+// The datapoint codecs of knx_dpt.h: round trips, the octets on the bus and the edges of each range
+
+#include <cmath>
+#include <limits>
+#include <type_traits>
+#include <vector>
+#include <gtest/gtest.h>
+#include "knx_dpt.h"
+#include "knx_telegram.h"
+
+namespace esphome {
+namespace knx {
+
+  // APCI octet and up to 14 value octets
+  template<typename D> std::vector<uint8_t> encoded(const typename D::value_type &value) {
+    std::vector<uint8_t> data(1 + D::length, 0);
+    D::encode(value, data.data());
+    return data;
+  }
+
+  // Template arguments with a comma do not pass through the gtest macros
+  using Dpt9_001 = Dpt<9, 1>;
+  using Dpt5_001 = Dpt<5, 1>;
+
+  template<typename D> typename D::value_type round_trip(const typename D::value_type &value) {
+    auto decoded = D::decode(encoded<D>(value).data());
+    EXPECT_TRUE(decoded.has_value());
+    return decoded.value_or(typename D::value_type{});
+  }
+
+  TEST(DptTest, SubTypesUseTheCodecOfTheirMainType) {
+    static_assert(std::is_same<Dpt<9, 1>::value_type, float>::value);
+    static_assert(Dpt<9, 1>::length == Dpt<9>::length);
+    static_assert(std::is_same<Dpt<20, 102>::value_type, uint8_t>::value);
+    static_assert(std::is_same<Dpt<14, 56>::value_type, float>::value);
+    // 5.001 has a specialisation of its own
+    static_assert(std::is_same<Dpt<5, 1>::value_type, float>::value);
+    static_assert(std::is_same<Dpt<5, 10>::value_type, uint8_t>::value);
+    EXPECT_EQ(encoded<Dpt9_001>(21.5f), encoded<Dpt<9>>(21.5f));
+    EXPECT_FLOAT_EQ(round_trip<Dpt9_001>(-5.0f), -5.0f);
+  }
+
+  TEST(DptTest, RoundTripsEveryType) {
+    EXPECT_EQ(round_trip<Dpt<1>>(true), true);
+    EXPECT_EQ((round_trip<Dpt<2>>({true, false}).control), true);
+    EXPECT_EQ((round_trip<Dpt<3>>({true, 5}).steps), 5);
+    EXPECT_EQ(round_trip<Dpt<5>>(200), 200);
+    EXPECT_NEAR(round_trip<Dpt5_001>(75.0f), 75.0f, 100.0f / 255.0f);
+    EXPECT_EQ(round_trip<Dpt<6>>(-128), -128);
+    EXPECT_EQ(round_trip<Dpt<7>>(65535), 65535);
+    EXPECT_EQ(round_trip<Dpt<8>>(-32768), -32768);
+    EXPECT_EQ((round_trip<Dpt<10>>({7, 23, 59, 58}).second), 58);
+    EXPECT_EQ((round_trip<Dpt<11>>({31, 12, 1990}).year), 1990);
+    EXPECT_EQ((round_trip<Dpt<11>>({1, 1, 2089}).year), 2089);
+    EXPECT_EQ(round_trip<Dpt<12>>(0xFFFFFFFF), 0xFFFFFFFF);
+    EXPECT_EQ(round_trip<Dpt<13>>(std::numeric_limits<int32_t>::min()), std::numeric_limits<int32_t>::min());
+    EXPECT_EQ(round_trip<Dpt<14>>(-1.5e-30f), -1.5e-30f);
+    EXPECT_EQ(round_trip<Dpt<16>>("KNX"), "KNX");
+    EXPECT_EQ(round_trip<Dpt<17>>(63), 63);
+    EXPECT_EQ((round_trip<Dpt<18>>({true, 12}).scene), 12);
+    EXPECT_EQ(round_trip<Dpt<20>>(4), 4);
+    EXPECT_EQ((round_trip<Dpt<232>>({1, 2, 3}).blue), 3);
+  }
+
+  // Examples from the KNX specification, the octets after the APCI
+  TEST(DptTest, EncodesDpt9AsSpecified) {
+    EXPECT_EQ(encoded<Dpt<9>>(0.0f), (std::vector<uint8_t>{0, 0x00, 0x00}));
+    EXPECT_EQ(encoded<Dpt<9>>(0.01f), (std::vector<uint8_t>{0, 0x00, 0x01}));
+    EXPECT_EQ(encoded<Dpt<9>>(-0.01f), (std::vector<uint8_t>{0, 0x87, 0xFF}));
+    EXPECT_EQ(encoded<Dpt<9>>(20.48f), (std::vector<uint8_t>{0, 0x0C, 0x00}));
+    // The largest mantissa at exponent 0 is not clamped
+    EXPECT_EQ(encoded<Dpt<9>>(20.47f), (std::vector<uint8_t>{0, 0x07, 0xFF}));
+    EXPECT_FLOAT_EQ(round_trip<Dpt<9>>(20.47f), 20.47f);
+    EXPECT_FLOAT_EQ(round_trip<Dpt<9>>(-671088.64f), -671088.64f);
+  }
+
+  // Out of range values saturate, and never turn into 0x7FFF, which stands for invalid data
+  TEST(DptTest, SaturatesDpt9) {
+    EXPECT_EQ(encoded<Dpt<9>>(1e9f), (std::vector<uint8_t>{0, 0x7F, 0xFE}));
+    EXPECT_FLOAT_EQ(round_trip<Dpt<9>>(1e9f), 670433.28f);
+    EXPECT_FLOAT_EQ(round_trip<Dpt<9>>(670760.96f), 670433.28f);
+    EXPECT_EQ(encoded<Dpt<9>>(-1e9f), (std::vector<uint8_t>{0, 0xF8, 0x00}));
+    EXPECT_FLOAT_EQ(round_trip<Dpt<9>>(-1e9f), -671088.64f);
+
+    uint8_t invalid[3] = {0, 0x7F, 0xFF};
+    EXPECT_FALSE(Dpt<9>::decode(invalid).has_value());
+  }
+
+  TEST(DptTest, CarriesDpt14SpecialValues) {
+    EXPECT_TRUE(std::isnan(round_trip<Dpt<14>>(std::numeric_limits<float>::quiet_NaN())));
+    EXPECT_EQ(round_trip<Dpt<14>>(std::numeric_limits<float>::infinity()), std::numeric_limits<float>::infinity());
+    EXPECT_TRUE(std::signbit(round_trip<Dpt<14>>(-0.0f)));
+    EXPECT_EQ(encoded<Dpt<14>>(1.0f), (std::vector<uint8_t>{0, 0x3F, 0x80, 0x00, 0x00}));
+  }
+
+  TEST(DptTest, TruncatesAndPadsDpt16) {
+    // Longer than 14 characters: cut off, the whole field is used without a terminating NUL
+    auto data = encoded<Dpt<16>>("Living room lights");
+    EXPECT_EQ(data.size(), 15u);
+    EXPECT_EQ(Dpt<16>::decode(data.data()), "Living room li");
+
+    // Shorter: padded with NUL up to 14 characters
+    data = encoded<Dpt<16>>("OK");
+    EXPECT_EQ(data, (std::vector<uint8_t>{0, 'O', 'K', 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0}));
+    EXPECT_EQ(Dpt<16>::decode(data.data()), "OK");
+    EXPECT_EQ(round_trip<Dpt<16>>(""), "");
+    EXPECT_EQ(round_trip<Dpt<16>>("Exactly 14 chr"), "Exactly 14 chr");
+  }
+
+  // Through a telegram: the length octet follows the datapoint, get<> is empty for another type
+  TEST(DptTest, SetsTheTelegramPayloadLength) {
+    KnxStandardTelegram telegram;
+    telegram.set_command(KNX_COMMAND_WRITE);
+    telegram.set<Dpt<16>>("Window open");
+    EXPECT_EQ(telegram.get_payload_length(), 2 + Dpt<16>::length);
+    EXPECT_EQ(telegram.get<Dpt<16>>(), "Window open");
+    EXPECT_FALSE(telegram.get<Dpt<9>>().has_value());
+
+    telegram.set<Dpt<1>>(true);
+    EXPECT_EQ(telegram.get_payload_length(), 2);
+    EXPECT_EQ(telegram.get<Dpt<1>>(), true);
+  }
+
+}  // namespace knx
+}  // namespace esphome
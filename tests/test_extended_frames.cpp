@@ -0,0 +1,117 @@
+// Author: Dulgheru Mihaita (Since 2022)
+
+// Extended frames against the simulated TPUART: through the receive path into rx_extended_ up to the longest
+// valid length byte of 254, and out of tx_extended_ in U_L_DataOffset blocks
+
+#include "tpuart_fixture.h"
+
+namespace esphome {
+namespace knx {
+
+  static const KnxGroupAddress LIGHT(1, 2, 3);
+  // Data octets after the APCI for the length byte 254, the longest a TP-UART takes
+  static const int LONGEST_DATA = MAX_KNX_EXTENDED_PAYLOAD_SIZE - 2;
+
+  // Each telegram carries its own storage and nothing else
+  static_assert(sizeof(KnxStandardTelegram) < MAX_KNX_TELEGRAM_SIZE + 2 * sizeof(void *) + sizeof(int));
+  static_assert(sizeof(KnxExtendedTelegram) < MAX_KNX_EXTENDED_TELEGRAM_SIZE + 2 * sizeof(void *) + sizeof(int));
+
+  class ExtendedFrameTest : public TpuartFixture {
+    protected:
+      void SetUp() override {
+        TpuartFixture::SetUp();
+        this->writes = this->watch(LIGHT, KNX_COMMAND_WRITE);
+      }
+
+      std::vector<std::vector<uint8_t>> *writes;
+  };
+
+  TEST_F(ExtendedFrameTest, ReceivesTheLongestFrame) {
+    this->start();
+    auto frame = extended_frame(LIGHT, LONGEST_DATA);
+    ASSERT_EQ(frame[6], 254);
+    ASSERT_EQ(frame.size(), (size_t) MAX_KNX_EXTENDED_TELEGRAM_SIZE);
+    this->sim.inject_frame(frame);
+    this->run_until_idle();
+
+    ASSERT_EQ(this->writes->size(), 1u);
+    EXPECT_EQ((*this->writes)[0], frame);
+    auto frames = this->sim.get_rx_frames();
+    ASSERT_EQ(frames.size(), 1u);
+    EXPECT_TRUE(frames[0].acknowledged_in_time());
+    EXPECT_EQ(frames[0].ack_information, TPUART_ACK_INFORMATION | TPUART_ACK_ADDRESSED);
+    KnxTelegram *telegram = this->knx.get_received_telegram();
+    EXPECT_TRUE(telegram->is_extended());
+    EXPECT_EQ(telegram->get_capacity(), MAX_KNX_EXTENDED_TELEGRAM_SIZE);
+    EXPECT_EQ(telegram->get_data_length(), LONGEST_DATA);
+    EXPECT_EQ(telegram->get_data()[LONGEST_DATA - 1], (LONGEST_DATA - 1) & 0xFF);
+  }
+
+  // Short extended frames stay in standard storage, the next standard frame after a long one too
+  TEST_F(ExtendedFrameTest, SwitchesBetweenStandardAndExtendedStorage) {
+    this->start();
+    std::vector<std::vector<uint8_t>> frames;
+    for (int length : {1, 14, 15, 100, LONGEST_DATA}) {
+      frames.push_back(extended_frame(LIGHT, length));
+      frames.push_back(group_frame<Dpt<5>>(LIGHT, KNX_COMMAND_WRITE, length));
+    }
+    for (auto &frame : frames) {
+      this->sim.inject_frame(frame);
+      this->run_until_idle();
+      EXPECT_EQ(this->knx.get_received_telegram()->get_capacity(),
+                frame.size() > MAX_KNX_TELEGRAM_SIZE ? MAX_KNX_EXTENDED_TELEGRAM_SIZE : MAX_KNX_TELEGRAM_SIZE);
+    }
+    EXPECT_EQ(*this->writes, frames);
+  }
+
+  // A length byte of 255 does not fit any buffer on the way, the frame is dropped and the next one received
+  TEST_F(ExtendedFrameTest, DropsALengthByteAbove254) {
+    this->start();
+    // Zero data octets, so nothing of the rest is taken for the start of another frame
+    std::vector<uint8_t> frame = extended_frame(LIGHT, 0);
+    frame.resize(KNX_EXTENDED_TELEGRAM_HEADER_SIZE);
+    frame[6] = 255;
+    frame.resize(KNX_EXTENDED_TELEGRAM_HEADER_SIZE + 255 + 2, 0);
+    this->sim.inject_frame(frame);
+    this->run_until_idle();
+    auto valid = extended_frame(LIGHT, 20);
+    this->sim.inject_frame(valid);
+    this->run_until_idle();
+
+    ASSERT_EQ(this->writes->size(), 1u);
+    EXPECT_EQ((*this->writes)[0], valid);
+    EXPECT_EQ(this->knx.get_metrics().rx_checksum_errors, 1u);
+  }
+
+  // Built in tx_extended_, written to the TPUART in blocks and confirmed like any other telegram
+  TEST_F(ExtendedFrameTest, SendsTheLongestFrame) {
+    this->start();
+    std::vector<uint8_t> data(LONGEST_DATA);
+    for (int i = 0; i < LONGEST_DATA; i++) {
+      data[i] = 0xFF - i;
+    }
+    KnxTxHandle handle = this->knx.group_write_data(LIGHT, data.data(), data.size());
+    ASSERT_NE(handle, KNX_TX_INVALID_HANDLE);
+    // tx_extended_ holds one telegram at a time
+    EXPECT_EQ(this->knx.group_write_data(LIGHT, data.data(), data.size()), KNX_TX_INVALID_HANDLE);
+    this->run_until_idle();
+
+    EXPECT_EQ(this->knx.get_tx_state(handle), KNX_TX_CONFIRMED);
+    auto sent = this->sim.get_tx_frames();
+    ASSERT_EQ(sent.size(), 1u);
+    ASSERT_EQ(sent[0].bytes.size(), (size_t) MAX_KNX_EXTENDED_TELEGRAM_SIZE);
+    EXPECT_EQ(sent[0].bytes[0] & 0b10000000, 0);
+    EXPECT_EQ(sent[0].bytes[6], 254);
+    EXPECT_EQ(std::vector<uint8_t>(sent[0].bytes.begin() + KNX_EXTENDED_TELEGRAM_HEADER_SIZE + 2, sent[0].bytes.end() - 1),
+              data);
+
+    // Free again once confirmed
+    EXPECT_NE(this->knx.group_write_data(LIGHT, data.data(), 100), KNX_TX_INVALID_HANDLE);
+    this->run_until_idle();
+    EXPECT_EQ(this->sim.get_tx_frames().size(), 2u);
+    // One octet more than the length byte can describe
+    EXPECT_EQ(this->knx.group_write_data(LIGHT, data.data(), LONGEST_DATA + 1), KNX_TX_INVALID_HANDLE);
+  }
+
+}  // namespace knx
+}  // namespace esphome
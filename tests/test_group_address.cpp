@@ -0,0 +1,46 @@
+// Author: Dulgheru Mihaita (Since 2022)
+
+// Group addresses in the three level notation: parsed, written to a telegram and formatted back
+
+#include <string>
+#include <gtest/gtest.h>
+#include "knx_group_address.h"
+#include "knx_telegram.h"
+
+namespace esphome {
+namespace knx {
+
+  static std::string formatted(const KnxGroupAddress &address) {
+    KnxStandardTelegram telegram;
+    telegram.set_target_group_address(address);
+    return telegram.get_target_group();
+  }
+
+  // The main group takes all 5 bits, 16/x/x and above must not fold onto 0/x/x
+  TEST(GroupAddressTest, RoundTripsUpToTheLastMainGroup) {
+    for (const char *text : {"0/0/1", "1/2/3", "15/7/255", "16/0/0", "23/4/5", "31/7/255"}) {
+      SCOPED_TRACE(text);
+      KnxGroupAddress address;
+      ASSERT_TRUE(KnxGroupAddress::parse(text, &address));
+      EXPECT_EQ(formatted(address), text);
+
+      KnxStandardTelegram telegram;
+      telegram.set_target_group_address(address);
+      EXPECT_EQ(telegram.get_target_main_group(), address.main());
+      EXPECT_EQ(telegram.get_target_middle_group(), address.middle());
+      EXPECT_EQ(telegram.get_target_sub_group(), address.sub());
+      EXPECT_EQ(telegram.get_target_group_address(), address);
+    }
+    EXPECT_EQ(KnxGroupAddress(31, 7, 255).raw(), 0xFFFF);
+  }
+
+  TEST(GroupAddressTest, RejectsAddressesOutOfRange) {
+    KnxGroupAddress address;
+    for (const char *text : {"32/0/0", "0/8/0", "0/0/256", "1/2", "1/2/3/4", "1//3", "a/b/c", ""}) {
+      SCOPED_TRACE(text);
+      EXPECT_FALSE(KnxGroupAddress::parse(text, &address));
+    }
+  }
+
+}  // namespace knx
+}  // namespace esphome
@@ -0,0 +1,74 @@
+// Author: Dulgheru Mihaita (Since 2022)
+
+// KnxGroupFilter: membership at the edges of the 256 address pages and the 32 bit words inside them
+
+#include <vector>
+#include <gtest/gtest.h>
+#include "knx_group_filter.h"
+
+namespace esphome {
+namespace knx {
+
+  TEST(GroupFilterTest, FindsAddressesAtPageBoundaries) {
+    KnxGroupFilter filter;
+    for (uint16_t address : {0x0000, 0x00FF, 0x0100, 0x011F, 0x0120, 0x7FFF, 0x8000, 0xFFFF}) {
+      filter.add(address);
+    }
+    for (uint16_t address : {0x0000, 0x00FF, 0x0100, 0x011F, 0x0120, 0x7FFF, 0x8000, 0xFFFF}) {
+      EXPECT_TRUE(filter.contains(address)) << address;
+    }
+    // Neighbours in the same page, the page before and after
+    for (uint16_t address : {0x0001, 0x00FE, 0x0101, 0x011E, 0x0121, 0x01FF, 0x0200, 0x7FFE, 0x8001, 0xFFFE}) {
+      EXPECT_FALSE(filter.contains(address)) << address;
+    }
+    EXPECT_EQ(filter.size(), 8u);
+  }
+
+  // Every address checked against a plain set, with pages full, sparse and missing
+  TEST(GroupFilterTest, MatchesASetOverTheWholeAddressSpace) {
+    KnxGroupFilter filter;
+    std::vector<bool> expected(0x10000);
+    for (uint32_t address = 0; address < 0x10000; address += 7) {
+      if ((address >> 8) % 3 != 0) {
+        filter.add(address);
+        expected[address] = true;
+      }
+    }
+    for (uint32_t address = 0x2000; address < 0x2100; address++) {
+      filter.add(address);
+      expected[address] = true;
+    }
+    size_t count = 0;
+    for (uint32_t address = 0; address < 0x10000; address++) {
+      ASSERT_EQ(filter.contains(address), expected[address]) << address;
+      count += expected[address];
+    }
+    EXPECT_EQ(filter.size(), count);
+  }
+
+  TEST(GroupFilterTest, AllocatesOnePagePerHighByte) {
+    KnxGroupFilter filter;
+    size_t empty = filter.memory_usage();
+    filter.add(0x0A01);
+    size_t one_page = filter.memory_usage();
+    EXPECT_GT(one_page, empty);
+    filter.add(0x0AFF);
+    filter.add(0x0A01);
+    EXPECT_EQ(filter.memory_usage(), one_page);
+    EXPECT_EQ(filter.size(), 2u);
+    filter.add(0x0B00);
+    EXPECT_EQ(filter.memory_usage() - one_page, one_page - empty);
+  }
+
+  TEST(GroupFilterTest, IteratesInAscendingOrder) {
+    KnxGroupFilter filter;
+    for (uint16_t address : {0xFFFF, 0x0100, 0x00FF, 0x0120, 0x011F, 0x0000}) {
+      filter.add(address);
+    }
+    std::vector<uint16_t> addresses;
+    filter.for_each([&addresses](uint16_t address) { addresses.push_back(address); });
+    EXPECT_EQ(addresses, (std::vector<uint16_t>{0x0000, 0x00FF, 0x0100, 0x011F, 0x0120, 0xFFFF}));
+  }
+
+}  // namespace knx
+}  // namespace esphome
@@ -0,0 +1,154 @@
+// Author: Dulgheru Mihaita (Since 2022)
+
+// Group objects against the simulated TPUART: reads answered from the cached value and still handed on to the
+// triggers, and the send policy for our own writes (coalescing, min_interval, send_on_delta)
+
+#include "tpuart_fixture.h"
+
+namespace esphome {
+namespace knx {
+
+  static const KnxGroupAddress TEMPERATURE(1, 2, 3);
+  static const KnxGroupAddress OTHER(1, 2, 4);
+
+  class GroupObjectTest : public TpuartFixture {
+    protected:
+      void SetUp() override {
+        TpuartFixture::SetUp();
+        this->knx.add_group_object(TEMPERATURE, 9, Dpt<9>::length);
+      }
+
+      // The telegrams put on the line by us
+      std::vector<KnxStandardTelegram> sent() {
+        std::vector<KnxStandardTelegram> telegrams;
+        for (auto &frame : this->sim.get_tx_frames()) {
+          telegrams.emplace_back();
+          memcpy(telegrams.back().data(), frame.bytes.data(), frame.bytes.size());
+        }
+        return telegrams;
+      }
+  };
+
+  TEST_F(GroupObjectTest, AnswersAReadFromTheCache) {
+    auto *reads = this->watch(TEMPERATURE, KNX_COMMAND_READ);
+    this->start();
+    this->sim.inject_frame(group_frame<Dpt<9>>(TEMPERATURE, KNX_COMMAND_WRITE, 21.5f));
+    this->sim.inject_frame(group_read_frame(TEMPERATURE));
+    this->run_until_idle();
+
+    auto telegrams = this->sent();
+    ASSERT_EQ(telegrams.size(), 1u);
+    EXPECT_EQ(telegrams[0].get_target_group_address(), TEMPERATURE);
+    EXPECT_EQ(telegrams[0].get_command(), KNX_COMMAND_ANSWER);
+    EXPECT_EQ(telegrams[0].get<Dpt<9>>(), 21.5f);
+    EXPECT_EQ(this->knx.get_cached<Dpt<9>>(TEMPERATURE), 21.5f);
+    // Answered, and on_group_read still runs
+    EXPECT_EQ(reads->size(), 1u);
+  }
+
+  TEST_F(GroupObjectTest, DispatchesAReadBeforeAValueIsKnown) {
+    auto *reads = this->watch(TEMPERATURE, KNX_COMMAND_READ);
+    this->start();
+    this->sim.inject_frame(group_read_frame(TEMPERATURE));
+    this->run_until_idle();
+
+    EXPECT_TRUE(this->sim.get_tx_frames().empty());
+    EXPECT_EQ(reads->size(), 1u);
+  }
+
+  TEST_F(GroupObjectTest, RunsTheLambdaForAnsweredReads) {
+    int lambda_calls = 0;
+    this->knx.set_lambda_writer([&lambda_calls](KnxComponent &) { lambda_calls++; });
+    this->start();
+    this->knx.group_write<Dpt<9>>(TEMPERATURE, 19.0f);
+    this->run_until_idle();
+    this->sim.inject_frame(group_read_frame(TEMPERATURE));
+    this->run_until_idle();
+
+    auto telegrams = this->sent();
+    ASSERT_EQ(telegrams.size(), 2u);
+    // Our own write filled the cache
+    EXPECT_EQ(telegrams[1].get_command(), KNX_COMMAND_ANSWER);
+    EXPECT_EQ(telegrams[1].get<Dpt<9>>(), 19.0f);
+    EXPECT_EQ(lambda_calls, 1);
+  }
+
+  // Written again while the first write still waits: one frame with the last value, under the first handle
+  TEST_F(GroupObjectTest, CoalescesQueuedWrites) {
+    this->start();
+    KnxTxHandle first = this->knx.group_write<Dpt<9>>(TEMPERATURE, 20.0f);
+    KnxTxHandle second = this->knx.group_write<Dpt<9>>(TEMPERATURE, 21.0f);
+    EXPECT_EQ(second, first);
+    EXPECT_EQ(this->knx.get_tx_queue_depth(), 1);
+    this->run_until_idle();
+
+    auto telegrams = this->sent();
+    ASSERT_EQ(telegrams.size(), 1u);
+    EXPECT_EQ(telegrams[0].get<Dpt<9>>(), 21.0f);
+    EXPECT_EQ(this->knx.get_tx_state(first), KNX_TX_CONFIRMED);
+    EXPECT_EQ(this->knx.get_suppressed_count(), 1u);
+  }
+
+  // A coalesced write with a higher priority goes ahead of the telegrams queued at the old one
+  TEST_F(GroupObjectTest, RequeuesACoalescedWriteOnAPriorityChange) {
+    this->start();
+    this->knx.group_write<Dpt<9>>(OTHER, 5.0f);
+    this->knx.group_write<Dpt<9>>(TEMPERATURE, 20.0f);
+    this->knx.group_write<Dpt<9>>(TEMPERATURE, 21.0f, KNX_PRIORITY_ALARM);
+    EXPECT_EQ(this->knx.get_tx_queue_depth(), 2);
+    this->run_until_idle();
+
+    auto telegrams = this->sent();
+    ASSERT_EQ(telegrams.size(), 2u);
+    EXPECT_EQ(telegrams[0].get_target_group_address(), TEMPERATURE);
+    EXPECT_EQ(telegrams[0].get_priority(), KNX_PRIORITY_ALARM);
+    EXPECT_EQ(telegrams[0].get<Dpt<9>>(), 21.0f);
+    EXPECT_EQ(telegrams[1].get_target_group_address(), OTHER);
+  }
+
+  // Held back until min_interval has passed, then sent once with the latest value and priority
+  TEST_F(GroupObjectTest, SpacesWritesByMinInterval) {
+    this->knx.set_send_policy(TEMPERATURE, 1000, 0);
+    this->start();
+    this->knx.group_write<Dpt<9>>(TEMPERATURE, 20.0f);
+    this->run_until_idle();
+    uint64_t first_us = host::now_us();
+    KnxTxHandle held = this->knx.group_write<Dpt<9>>(TEMPERATURE, 21.0f);
+    EXPECT_EQ(this->knx.group_write<Dpt<9>>(TEMPERATURE, 22.0f, KNX_PRIORITY_HIGH), held);
+    this->loop.run_for_ms(500);
+    EXPECT_EQ(this->knx.get_tx_state(held), KNX_TX_QUEUED);
+    EXPECT_EQ(this->sim.get_tx_frames().size(), 1u);
+
+    this->loop.run_until([this, held] { return this->knx.get_tx_state(held) == KNX_TX_CONFIRMED; }, 2000);
+    EXPECT_EQ(this->knx.get_tx_state(held), KNX_TX_CONFIRMED);
+    auto telegrams = this->sent();
+    ASSERT_EQ(telegrams.size(), 2u);
+    EXPECT_EQ(telegrams[1].get<Dpt<9>>(), 22.0f);
+    EXPECT_EQ(telegrams[1].get_priority(), KNX_PRIORITY_HIGH);
+    EXPECT_GE(this->sim.get_tx_frames()[1].received_us - first_us, 900000u);
+    EXPECT_EQ(this->knx.get_suppressed_count(), 1u);
+  }
+
+  // Changes smaller than send_on_delta from the value last sent are dropped
+  TEST_F(GroupObjectTest, SkipsWritesWithinSendOnDelta) {
+    this->knx.set_send_policy(TEMPERATURE, 0, 0.5f);
+    this->start();
+    EXPECT_NE(this->knx.group_write<Dpt<9>>(TEMPERATURE, 20.0f), KNX_TX_INVALID_HANDLE);
+    this->run_until_idle();
+    EXPECT_EQ(this->knx.group_write<Dpt<9>>(TEMPERATURE, 20.3f), KNX_TX_INVALID_HANDLE);
+    this->run_until_idle();
+    EXPECT_NE(this->knx.group_write<Dpt<9>>(TEMPERATURE, 20.6f), KNX_TX_INVALID_HANDLE);
+    this->run_until_idle();
+    // Answers are not subject to the policy
+    EXPECT_NE(this->knx.group_answer<Dpt<9>>(TEMPERATURE, 20.7f), KNX_TX_INVALID_HANDLE);
+    this->run_until_idle();
+
+    auto telegrams = this->sent();
+    ASSERT_EQ(telegrams.size(), 3u);
+    EXPECT_FLOAT_EQ(*telegrams[1].get<Dpt<9>>(), 20.6f);
+    EXPECT_EQ(telegrams[2].get_command(), KNX_COMMAND_ANSWER);
+    EXPECT_EQ(this->knx.get_suppressed_count(), 1u);
+  }
+
+}  // namespace knx
+}  // namespace esphome
@@ -0,0 +1,202 @@
+// Author: Dulgheru Mihaita (Since 2022)
+
+// KnxIpRouter between the simulated TPUART line and a multicast group on this host, with a peer router
+// played by the test. Skipped where the host cannot join a multicast group.
+
+#include <chrono>
+#include <thread>
+#include <unistd.h>
+#include "tpuart_fixture.h"
+#include "knx_ip_router.h"
+
+namespace esphome {
+namespace knx {
+
+  static const KnxGroupAddress LIGHT(1, 2, 3);
+  static const KnxGroupAddress OTHER(1, 2, 4);
+  // Administratively scoped, so a KNX installation on the network never sees the test
+  static const char *const TEST_GROUP = "239.255.23.12";
+
+  class RoutingTest : public TpuartFixture {
+    protected:
+      void SetUp() override {
+        TpuartFixture::SetUp();
+        // Another port per process, test programs may run in parallel
+        this->port_ = 30000 + getpid() % 20000;
+        if (!this->open_peer()) {
+          GTEST_SKIP() << "cannot join " << TEST_GROUP << " on this host";
+        }
+        this->router.set_multicast_address(TEST_GROUP, this->port_);
+        this->knx.set_router(&this->router);
+        this->knx.add_listen_group_address(LIGHT);
+        // Multicast on the loopback is delivered by the kernel a little later, so every iteration takes some real time
+        this->loop.add_hook([this] {
+          std::this_thread::sleep_for(std::chrono::microseconds(200));
+          this->poll_peer();
+        });
+        this->start();
+      }
+
+      bool open_peer() {
+        this->peer_ = socket::socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+        if (this->peer_ == nullptr) {
+          return false;
+        }
+        int enable = 1;
+        this->peer_->setsockopt(SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+        struct sockaddr_storage local;
+        socklen_t length = socket::set_sockaddr_any((struct sockaddr *) &local, sizeof(local), this->port_);
+        struct ip_mreq membership;
+        membership.imr_multiaddr.s_addr = inet_addr(TEST_GROUP);
+        membership.imr_interface.s_addr = htonl(INADDR_ANY);
+        if (this->peer_->bind((struct sockaddr *) &local, length) != 0 ||
+            this->peer_->setsockopt(IPPROTO_IP, IP_ADD_MEMBERSHIP, &membership, sizeof(membership)) != 0) {
+          return false;
+        }
+        this->peer_->setblocking(false);
+        return true;
+      }
+
+      // Datagrams of the router, the peer's own come back from its port
+      void poll_peer() {
+        uint8_t buffer[KNXNETIP_ROUTING_FRAME_SIZE];
+        struct sockaddr_in source;
+        socklen_t length = sizeof(source);
+        ssize_t received;
+        while ((received = this->peer_->recvfrom(buffer, sizeof(buffer), (struct sockaddr *) &source, &length)) > 0) {
+          if (ntohs(source.sin_port) != this->port_) {
+            this->datagrams.emplace_back(buffer, buffer + received);
+          }
+          length = sizeof(source);
+        }
+      }
+
+      void peer_send(uint16_t service, const std::vector<uint8_t> &body) {
+        std::vector<uint8_t> frame(KNXNETIP_HEADER_SIZE + body.size());
+        knx_netip_header(frame.data(), service, frame.size());
+        std::copy(body.begin(), body.end(), frame.begin() + KNXNETIP_HEADER_SIZE);
+        struct sockaddr_storage group;
+        socklen_t length = socket::set_sockaddr((struct sockaddr *) &group, sizeof(group), TEST_GROUP, this->port_);
+        this->peer_->sendto(frame.data(), frame.size(), 0, (struct sockaddr *) &group, length);
+      }
+
+      void peer_send_indication(const std::vector<uint8_t> &frame) {
+        std::vector<uint8_t> cemi(KNX_CEMI_MAX_SIZE);
+        cemi.resize(knx_tp_to_cemi(KNX_CEMI_L_DATA_IND, frame.data(), frame.size(), cemi.data()));
+        this->peer_send(KNXNETIP_ROUTING_INDICATION, cemi);
+      }
+
+      bool wait_for_datagrams(size_t count, uint32_t timeout_ms = 2000) {
+        return this->loop.run_until([this, count] { return this->datagrams.size() >= count; }, timeout_ms);
+      }
+
+      // The TP1 frame in a ROUTING_INDICATION
+      static std::vector<uint8_t> indication_frame(const std::vector<uint8_t> &datagram) {
+        KnxExtendedTelegram telegram;
+        int length = knx_cemi_to_tp(datagram.data() + KNXNETIP_HEADER_SIZE, datagram.size() - KNXNETIP_HEADER_SIZE,
+                                    telegram.data(), telegram.get_capacity());
+        telegram.create_checksum();
+        return std::vector<uint8_t>(telegram.data(), telegram.data() + length);
+      }
+
+      static uint16_t service(const std::vector<uint8_t> &datagram) { return (datagram[2] << 8) | datagram[3]; }
+
+      KnxIpRouter router;
+      std::vector<std::vector<uint8_t>> datagrams;
+      std::unique_ptr<socket::Socket> peer_;
+      uint16_t port_{0};
+  };
+
+  TEST_F(RoutingTest, RoutesFramesFromTheLineToIp) {
+    this->sim.inject_frame(group_frame<Dpt<1>>(OTHER, KNX_COMMAND_WRITE, true));
+    this->sim.inject_frame(group_frame<Dpt<1>>(LIGHT, KNX_COMMAND_WRITE, true));
+    ASSERT_TRUE(this->wait_for_datagrams(1));
+    this->run_until_idle();
+
+    ASSERT_EQ(this->datagrams.size(), 1u);
+    EXPECT_EQ(service(this->datagrams[0]), KNXNETIP_ROUTING_INDICATION);
+    KnxStandardTelegram telegram;
+    auto frame = indication_frame(this->datagrams[0]);
+    memcpy(telegram.data(), frame.data(), frame.size());
+    EXPECT_EQ(telegram.get_target_group_address(), LIGHT);
+    EXPECT_EQ(telegram.get_routing_counter(), 5);
+    EXPECT_EQ(this->knx.get_metrics().routed_to_ip, 1u);
+  }
+
+  TEST_F(RoutingTest, RoutesIndicationsFromIpToTheLine) {
+    this->peer_send_indication(group_frame<Dpt<5>>(OTHER, KNX_COMMAND_WRITE, 1));
+    this->peer_send_indication(group_frame<Dpt<5>>(LIGHT, KNX_COMMAND_WRITE, 2));
+    ASSERT_TRUE(this->loop.run_until([this] { return this->sim.get_tx_frames().size() == 1; }, 2000));
+    this->run_until_idle();
+
+    auto sent = this->sim.get_tx_frames();
+    ASSERT_EQ(sent.size(), 1u);
+    KnxStandardTelegram telegram;
+    memcpy(telegram.data(), sent[0].bytes.data(), sent[0].bytes.size());
+    EXPECT_EQ(telegram.get_target_group_address(), LIGHT);
+    EXPECT_EQ(telegram.get_routing_counter(), 5);
+    EXPECT_EQ(this->knx.get_metrics().routed_to_tp, 1u);
+    // Confirmed on the line, but it came from IP and is not sent back there
+    EXPECT_TRUE(this->datagrams.empty());
+  }
+
+  // Indications for us are handled here too: the group object cache and the triggers see them
+  TEST_F(RoutingTest, DispatchesIndicationsLocally) {
+    this->knx.add_group_object(LIGHT, 5, Dpt<5>::length);
+    auto *writes = this->watch(LIGHT, KNX_COMMAND_WRITE);
+    this->peer_send_indication(group_frame<Dpt<5>>(LIGHT, KNX_COMMAND_WRITE, 42));
+    ASSERT_TRUE(this->loop.run_until([this] { return this->sim.get_tx_frames().size() == 1; }, 2000));
+    this->run_until_idle();
+
+    ASSERT_EQ(writes->size(), 1u);
+    EXPECT_EQ((*writes)[0][8], 42);
+    EXPECT_EQ(this->knx.get_cached<Dpt<5>>(LIGHT), 42);
+    EXPECT_EQ(this->knx.get_metrics().routed_to_tp, 1u);
+  }
+
+  // Multicast loop is on, the router's own indications reach it again and must not go to the line
+  TEST_F(RoutingTest, IgnoresItsOwnIndications) {
+    KnxTxHandle handle = this->knx.group_write<Dpt<1>>(LIGHT, true);
+    ASSERT_TRUE(this->wait_for_datagrams(1));
+    this->loop.run_for_ms(500);
+
+    EXPECT_EQ(this->knx.get_tx_state(handle), KNX_TX_CONFIRMED);
+    EXPECT_EQ(this->datagrams.size(), 1u);
+    EXPECT_EQ(this->sim.get_tx_frames().size(), 1u);
+    EXPECT_EQ(this->knx.get_metrics().routed_to_tp, 0u);
+  }
+
+  TEST_F(RoutingTest, HoldsBackFramesWhileAPeerIsBusy) {
+    // Device state, wait time 300 ms, control field
+    this->peer_send(KNXNETIP_ROUTING_BUSY, {6, 0, 0x01, 0x2C, 0, 0});
+    this->loop.run_for_ms(20);
+    uint64_t busy_us = host::now_us();
+    this->sim.inject_frame(group_frame<Dpt<1>>(LIGHT, KNX_COMMAND_WRITE, true));
+    this->run_until_idle();
+    EXPECT_TRUE(this->datagrams.empty());
+
+    ASSERT_TRUE(this->wait_for_datagrams(1));
+    EXPECT_GE(host::now_us() - busy_us, 250000u);
+  }
+
+  // An extended frame waits with the standard ones, in order
+  TEST_F(RoutingTest, HoldsBackExtendedFramesWhileAPeerIsBusy) {
+    auto extended = extended_frame(LIGHT, 40);
+    this->peer_send(KNXNETIP_ROUTING_BUSY, {6, 0, 0x01, 0x2C, 0, 0});
+    this->loop.run_for_ms(20);
+    this->sim.inject_frame(extended);
+    this->sim.inject_frame(group_frame<Dpt<1>>(LIGHT, KNX_COMMAND_WRITE, true));
+    this->run_until_idle();
+    EXPECT_TRUE(this->datagrams.empty());
+
+    ASSERT_TRUE(this->wait_for_datagrams(2));
+    auto first = indication_frame(this->datagrams[0]);
+    ASSERT_EQ(first.size(), extended.size());
+    EXPECT_TRUE(std::equal(first.begin() + KNX_EXTENDED_TELEGRAM_HEADER_SIZE, first.end() - 1,
+                           extended.begin() + KNX_EXTENDED_TELEGRAM_HEADER_SIZE));
+    EXPECT_EQ(indication_frame(this->datagrams[1]).size(), 9u);
+    EXPECT_EQ(this->knx.get_metrics().routing_lost, 0u);
+  }
+
+}  // namespace knx
+}  // namespace esphome
@@ -0,0 +1,150 @@
+// Author: Dulgheru Mihaita (Since 2022)
+
+// KnxIpTunnelTransport against a stand-in KNXnet/IP interface on the loopback: connecting, tunnelling requests
+// with their ACKs and L_DATA.con, indications with their sequence counters, the heartbeat and reconnecting
+
+#include <memory>
+#include <gtest/gtest.h>
+#include "automation.h"
+#include "host_loop.h"
+#include "host_platform.h"
+#include "knx_component.h"
+#include "knx_frames.h"
+#include "knx_ip_tunnel_transport.h"
+#include "knxnetip_server.h"
+
+namespace esphome {
+namespace knx {
+
+  static const KnxGroupAddress LIGHT(1, 2, 3);
+
+  class TunnelTest : public ::testing::Test {
+    protected:
+      void SetUp() override {
+        host::reset_clock();
+        host::reset_log_counts();
+        if (!this->server.start()) {
+          GTEST_SKIP() << "no UDP socket on 127.0.0.1";
+        }
+        this->transport.set_gateway("127.0.0.1", this->server.get_port());
+        this->knx.set_transport(&this->transport);
+        this->knx.set_individual_address(1, 1, 10);
+        this->loop.add_hook([this] { this->server.poll(); });
+        this->trigger.set_callback([this](KnxTelegram *telegram) { this->received.push_back(frame_bytes(*telegram)); });
+        this->knx.setup();
+        ASSERT_TRUE(this->loop.run_until([this] { return this->server.is_connected(); }, 1000));
+      }
+
+      KnxTxState send_and_wait(bool value) {
+        KnxTxHandle handle = this->knx.group_write<Dpt<1>>(LIGHT, value);
+        this->loop.run_until([this, handle] { return this->knx.get_tx_state(handle) > KNX_TX_SENT; }, 10000);
+        return this->knx.get_tx_state(handle);
+      }
+
+      // The TP1 frame of a cEMI frame the server received
+      static std::vector<uint8_t> tp_frame(const std::vector<uint8_t> &cemi) {
+        KnxStandardTelegram telegram;
+        int length = knx_cemi_to_tp(cemi.data(), cemi.size(), telegram.data(), telegram.get_capacity());
+        telegram.create_checksum();
+        return std::vector<uint8_t>(telegram.data(), telegram.data() + length);
+      }
+
+      KnxNetIpServer server;
+      KnxIpTunnelTransport transport;
+      KnxComponent knx;
+      HostLoop loop{&knx};
+      KnxGroupTrigger trigger{&knx, LIGHT, KNX_COMMAND_WRITE};
+      std::vector<std::vector<uint8_t>> received;
+  };
+
+  TEST_F(TunnelTest, SendsAndConfirmsGroupWrites) {
+    EXPECT_EQ(this->server.get_connect_requests(), 1u);
+    EXPECT_EQ(this->send_and_wait(true), KNX_TX_CONFIRMED);
+    EXPECT_EQ(this->send_and_wait(false), KNX_TX_CONFIRMED);
+
+    auto &requests = this->server.get_requests();
+    ASSERT_EQ(requests.size(), 2u);
+    EXPECT_EQ(requests[0].sequence, 0);
+    EXPECT_EQ(requests[1].sequence, 1);
+    EXPECT_EQ(requests[0].cemi[0], KNX_CEMI_L_DATA_REQ);
+    KnxStandardTelegram telegram;
+    auto frame = tp_frame(requests[1].cemi);
+    memcpy(telegram.data(), frame.data(), frame.size());
+    EXPECT_EQ(telegram.get_target_group_address(), LIGHT);
+    EXPECT_EQ(telegram.get<Dpt<1>>(), false);
+    EXPECT_EQ(this->knx.get_metrics().tx_confirmed, 2u);
+  }
+
+  TEST_F(TunnelTest, ReportsAFailedConfirmation) {
+    this->server.set_confirm(true, true);
+    EXPECT_EQ(this->send_and_wait(true), KNX_TX_NACKED);
+  }
+
+  TEST_F(TunnelTest, RepeatsARequestWithoutAck) {
+    this->server.drop_acks(1);
+    EXPECT_EQ(this->send_and_wait(true), KNX_TX_CONFIRMED);
+    auto &requests = this->server.get_requests();
+    ASSERT_EQ(requests.size(), 2u);
+    EXPECT_EQ(requests[1].sequence, requests[0].sequence);
+    EXPECT_EQ(requests[1].cemi, requests[0].cemi);
+  }
+
+  TEST_F(TunnelTest, ReconnectsAfterTheRepetitionIsNotAcknowledged) {
+    this->server.drop_acks(2);
+    EXPECT_EQ(this->send_and_wait(true), KNX_TX_NACKED);
+    this->loop.run_until([this] { return this->server.is_connected(); }, KNXNETIP_CONNECT_TIMEOUT_MS + 1000);
+    EXPECT_EQ(this->server.get_disconnect_requests(), 1u);
+    EXPECT_EQ(this->server.get_connect_requests(), 2u);
+    // Sequence counters start over on the new connection
+    EXPECT_EQ(this->send_and_wait(true), KNX_TX_CONFIRMED);
+    EXPECT_EQ(this->server.get_requests().back().sequence, 0);
+  }
+
+  TEST_F(TunnelTest, ReportsAMissingConfirmation) {
+    this->server.set_confirm(false);
+    EXPECT_EQ(this->send_and_wait(true), KNX_TX_TIMED_OUT);
+  }
+
+  TEST_F(TunnelTest, ReceivesIndicationsInSequence) {
+    for (int i = 0; i < 3; i++) {
+      this->server.send_indication(group_frame<Dpt<5>>(LIGHT, KNX_COMMAND_WRITE, i));
+    }
+    this->loop.run_for_ms(100);
+    ASSERT_EQ(this->received.size(), 3u);
+    EXPECT_EQ(this->received[2][8], 2);
+    EXPECT_EQ(this->server.get_acks(), (std::vector<uint8_t>{0, 1, 2}));
+
+    // The interface repeats the last one because our ACK got lost: acknowledged again, not dispatched again
+    this->server.send_indication(group_frame<Dpt<5>>(LIGHT, KNX_COMMAND_WRITE, 2), 2);
+    // Out of order: neither acknowledged nor dispatched
+    this->server.send_indication(group_frame<Dpt<5>>(LIGHT, KNX_COMMAND_WRITE, 9), 7);
+    this->loop.run_for_ms(100);
+    EXPECT_EQ(this->received.size(), 3u);
+    EXPECT_EQ(this->server.get_acks(), (std::vector<uint8_t>{0, 1, 2, 2}));
+  }
+
+  TEST_F(TunnelTest, SendsHeartbeats) {
+    this->loop.run_for_ms(KNXNETIP_HEARTBEAT_INTERVAL_MS * 3 + 1000);
+    EXPECT_EQ(this->server.get_heartbeats(), 3u);
+    EXPECT_EQ(this->server.get_connect_requests(), 1u);
+  }
+
+  TEST_F(TunnelTest, ReconnectsWhenTheHeartbeatIsNotAnswered) {
+    this->server.set_heartbeat_answers(false);
+    this->loop.run_for_ms(KNXNETIP_HEARTBEAT_INTERVAL_MS + KNXNETIP_HEARTBEAT_RETRIES * KNXNETIP_HEARTBEAT_TIMEOUT_MS + 1000);
+    EXPECT_EQ(this->server.get_heartbeats(), (uint32_t) KNXNETIP_HEARTBEAT_RETRIES);
+    EXPECT_EQ(this->server.get_disconnect_requests(), 1u);
+    this->loop.run_until([this] { return this->server.is_connected(); }, KNXNETIP_CONNECT_TIMEOUT_MS + 1000);
+    EXPECT_EQ(this->server.get_connect_requests(), 2u);
+  }
+
+  TEST_F(TunnelTest, ReconnectsAfterTheInterfaceDisconnects) {
+    this->server.send_disconnect_request();
+    this->loop.run_for_ms(100);
+    EXPECT_FALSE(this->server.is_connected());
+    EXPECT_TRUE(this->loop.run_until([this] { return this->server.is_connected(); }, KNXNETIP_CONNECT_TIMEOUT_MS + 1000));
+    EXPECT_EQ(this->send_and_wait(true), KNX_TX_CONFIRMED);
+  }
+
+}  // namespace knx
+}  // namespace esphome
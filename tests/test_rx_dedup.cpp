@@ -0,0 +1,112 @@
+// Author: Dulgheru Mihaita (Since 2022)
+
+// Receive dedup against the simulated TPUART: a repeated frame is acknowledged again, so the sender stops, but
+// handed on only once; the same value sent again later is a new telegram
+
+#include "tpuart_fixture.h"
+
+namespace esphome {
+namespace knx {
+
+  static const KnxGroupAddress LIGHT(1, 2, 3);
+
+  class RxDedupTest : public TpuartFixture {
+    protected:
+      void SetUp() override {
+        TpuartFixture::SetUp();
+        this->writes = this->watch(LIGHT, KNX_COMMAND_WRITE);
+        this->start();
+      }
+
+      // The copy a sender puts on the line when it saw no ACK, repeat flag cleared
+      static std::vector<uint8_t> repeated(const std::vector<uint8_t> &frame) {
+        KnxStandardTelegram telegram;
+        memcpy(telegram.data(), frame.data(), frame.size());
+        telegram.set_repeated(true);
+        telegram.create_checksum();
+        return frame_bytes(telegram);
+      }
+
+      void receive(const std::vector<uint8_t> &frame) {
+        this->sim.inject_frame(frame);
+        this->run_until_idle();
+      }
+
+      // Every frame received so far was acknowledged as addressed to us
+      void expect_all_acknowledged() {
+        for (auto &frame : this->sim.get_rx_frames()) {
+          EXPECT_TRUE(frame.acknowledged_in_time());
+          EXPECT_EQ(frame.ack_information, TPUART_ACK_INFORMATION | TPUART_ACK_ADDRESSED);
+        }
+      }
+
+      std::vector<std::vector<uint8_t>> *writes;
+  };
+
+  TEST_F(RxDedupTest, AcknowledgesARepeatWithoutDispatchingIt) {
+    auto frame = group_frame<Dpt<5>>(LIGHT, KNX_COMMAND_WRITE, 42);
+    this->receive(frame);
+    this->receive(repeated(frame));
+    this->receive(repeated(frame));
+
+    EXPECT_EQ(this->writes->size(), 1u);
+    EXPECT_EQ(this->sim.get_rx_frames().size(), 3u);
+    this->expect_all_acknowledged();
+    const KnxMetrics &metrics = this->knx.get_metrics();
+    EXPECT_EQ(metrics.rx_duplicates, 2u);
+    EXPECT_EQ(metrics.rx_accepted, 1u);
+  }
+
+  // Only the telegram content counts, the routing counter is lowered by every line coupler on the way
+  TEST_F(RxDedupTest, MatchesARepeatRoutedOverAnotherPath) {
+    auto frame = group_frame<Dpt<5>>(LIGHT, KNX_COMMAND_WRITE, 42);
+    KnxStandardTelegram routed;
+    memcpy(routed.data(), frame.data(), frame.size());
+    routed.set_repeated(true);
+    routed.data()[5] = (routed.data()[5] & 0b10001111) | (3 << 4);
+    routed.create_checksum();
+    this->receive(frame);
+    this->receive(frame_bytes(routed));
+
+    EXPECT_EQ(this->writes->size(), 1u);
+    EXPECT_EQ(this->knx.get_duplicate_count(), 1u);
+  }
+
+  // A repeat is expected within KNX_RX_REPEAT_WINDOW_MS, later it is a telegram of its own
+  TEST_F(RxDedupTest, DeliversARepeatAfterTheRepeatWindow) {
+    auto frame = group_frame<Dpt<5>>(LIGHT, KNX_COMMAND_WRITE, 42);
+    this->receive(frame);
+    this->loop.run_for_ms(KNX_RX_REPEAT_WINDOW_MS);
+    this->receive(repeated(frame));
+
+    EXPECT_EQ(this->writes->size(), 2u);
+    EXPECT_EQ(this->knx.get_duplicate_count(), 0u);
+  }
+
+  // The same value without the repeat flag: dropped right after the first, e.g. received over two couplers,
+  // delivered once KNX_RX_DUPLICATE_WINDOW_MS has passed, e.g. a switch pressed twice
+  TEST_F(RxDedupTest, DeliversAnIdenticalWriteAfterTheDuplicateWindow) {
+    auto frame = group_frame<Dpt<5>>(LIGHT, KNX_COMMAND_WRITE, 42);
+    this->receive(frame);
+    this->receive(frame);
+    EXPECT_EQ(this->writes->size(), 1u);
+
+    this->loop.run_for_ms(KNX_RX_DUPLICATE_WINDOW_MS);
+    this->receive(frame);
+    EXPECT_EQ(this->writes->size(), 2u);
+    EXPECT_EQ(this->knx.get_duplicate_count(), 1u);
+    this->expect_all_acknowledged();
+  }
+
+  // Dedup compares contents: another value or another sender is never dropped
+  TEST_F(RxDedupTest, DeliversOtherTelegramsRightAway) {
+    this->receive(group_frame<Dpt<5>>(LIGHT, KNX_COMMAND_WRITE, 1));
+    this->receive(repeated(group_frame<Dpt<5>>(LIGHT, KNX_COMMAND_WRITE, 2)));
+    this->receive(group_frame<Dpt<5>>(LIGHT, KNX_COMMAND_WRITE, 1, TEST_SOURCE_MEMBER + 1));
+
+    EXPECT_EQ(this->writes->size(), 3u);
+    EXPECT_EQ(this->knx.get_duplicate_count(), 0u);
+  }
+
+}  // namespace knx
+}  // namespace esphome
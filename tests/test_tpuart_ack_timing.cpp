@@ -0,0 +1,94 @@
+// Author: Dulgheru Mihaita (Since 2022)
+
+// The U_AckInformation has to reach the TPUART over the 19200 baud UART before the frame ends on the bus.
+// The shortest frame, 8 bytes, leaves 2 bus characters after the addresses minus the request itself, about 2.1 ms.
+
+#include <random>
+#include "tpuart_fixture.h"
+
+namespace esphome {
+namespace knx {
+
+  static const KnxGroupAddress LIGHT(1, 2, 3);
+  static const KnxGroupAddress OTHER(1, 2, 4);
+  static const int ACK_TIMING_FRAMES = 200;
+
+  class AckTimingTest : public TpuartFixture, public ::testing::WithParamInterface<uint32_t> {
+    protected:
+      void SetUp() override {
+        TpuartFixture::SetUp();
+        this->knx.add_listen_group_address(LIGHT);
+      }
+
+      // Frames one after the other, each starting at a random phase of period_us
+      std::vector<SimRxFrame> inject(uint32_t period_us) {
+        std::mt19937 random(period_us);
+        for (int i = 0; i < ACK_TIMING_FRAMES; i++) {
+          host::advance_us(random() % period_us);
+          this->sim.inject_frame(shortest_frame(i));
+          this->run_until_idle();
+        }
+        return this->sim.get_rx_frames();
+      }
+
+      // T_Connect to us or to another device, and group reads, the shortest group frame
+      static std::vector<uint8_t> shortest_frame(int i) {
+        int member = 1 + i % 250;
+        switch (i % 4) {
+          case 0: return connect_frame(1, 1, 10, member);
+          case 1: return connect_frame(1, 1, 11, member);
+          case 2: return group_read_frame(LIGHT, member);
+          default: return group_read_frame(OTHER, member);
+        }
+      }
+
+      static uint8_t expected_ack(int i) {
+        return TPUART_ACK_INFORMATION | (i % 4 == 0 || i % 4 == 2 ? TPUART_ACK_ADDRESSED : 0);
+      }
+
+      // Written in the first poll that finds both addresses, not after the payload or the checksum
+      void expect_in_time(const std::vector<SimRxFrame> &frames, uint32_t poll_us) {
+        ASSERT_EQ(frames.size(), (size_t) ACK_TIMING_FRAMES);
+        EXPECT_EQ(frames[0].bytes.size(), (size_t) KNX_TELEGRAM_HEADER_SIZE + 2);
+        for (int i = 0; i < ACK_TIMING_FRAMES; i++) {
+          SCOPED_TRACE(i);
+          EXPECT_TRUE(frames[i].acknowledged_in_time());
+          EXPECT_LE(frames[i].ack_us, frames[i].addressed_us + poll_us + TPUART_UART_CHAR_US);
+          EXPECT_EQ(frames[i].ack_information, expected_ack(i));
+        }
+        EXPECT_EQ(this->knx.get_metrics().rx_frames, (uint32_t) ACK_TIMING_FRAMES);
+      }
+  };
+
+  // The loop as ESPHome runs it: every 16 ms, back to back while a component asks for the high frequency loop
+  TEST_F(AckTimingTest, AcknowledgesTheShortestFrameFromTheDefaultLoop) {
+    this->start();
+    this->loop.run_for_ms(1000);
+    // Also between frames, the next one may start at any time
+    EXPECT_TRUE(HighFrequencyLoopRequester::is_high_frequency());
+    this->expect_in_time(this->inject(HOST_LOOP_INTERVAL_US), HOST_LOOP_HIGH_FREQUENCY_US);
+  }
+
+  // loop() held up by other components, or the receive task sleeping a 1 ms tick
+  TEST_P(AckTimingTest, AcknowledgesTheShortestFramePolledEvery) {
+    uint32_t period_us = GetParam();
+    this->loop.set_interval_us(period_us, period_us);
+    this->start();
+    this->expect_in_time(this->inject(period_us), period_us);
+  }
+
+  INSTANTIATE_TEST_SUITE_P(PollPeriods, AckTimingTest, ::testing::Values(100, 500, 1000, 1500));
+
+  // The checks above would catch a late request: polled every 8 ms most short frames are over first
+  TEST_F(AckTimingTest, MissesTheShortestFrameWhenPolledTooRarely) {
+    this->loop.set_interval_us(8000, 8000);
+    this->start();
+    int late = 0;
+    for (auto &frame : this->inject(8000)) {
+      late += !frame.acknowledged_in_time();
+    }
+    EXPECT_GT(late, ACK_TIMING_FRAMES / 2);
+  }
+
+}  // namespace knx
+}  // namespace esphome
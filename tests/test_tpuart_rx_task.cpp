@@ -0,0 +1,72 @@
+// Author: Dulgheru Mihaita (Since 2022)
+
+// The receive task on a std::thread against the simulated TPUART, on the virtual clock: the task runs at every
+// 1 ms tick and receives and acknowledges frames while loop() is held up by a slow component
+
+#include "tpuart_fixture.h"
+
+namespace esphome {
+namespace knx {
+
+  static const KnxGroupAddress LIGHT(1, 2, 3);
+  static const KnxGroupAddress OTHER(1, 2, 4);
+  static const int RX_TASK_FRAMES = 40;
+  // A component that takes this long in its loop(), about 3 frames arrive meanwhile
+  static const uint32_t STALL_MS = 50;
+
+  class RxTaskTest : public TpuartFixture {
+    protected:
+      void SetUp() override {
+        TpuartFixture::SetUp();
+        this->loop.add_hook([] { host::advance_us(STALL_MS * 1000); });
+      }
+
+      // Every other frame is for us, all of them back to back on the line
+      void inject_frames() {
+        for (int i = 0; i < RX_TASK_FRAMES; i++) {
+          this->sim.inject_frame(group_frame<Dpt<5>>(i & 1 ? OTHER : LIGHT, KNX_COMMAND_WRITE, i, 1 + i));
+        }
+      }
+
+      // Within the tick in which both addresses arrived
+      int acknowledged_in_time(uint32_t poll_us) {
+        int count = 0;
+        for (auto &frame : this->sim.get_rx_frames()) {
+          count += frame.acknowledged_in_time() && frame.ack_us <= frame.addressed_us + poll_us + TPUART_UART_CHAR_US;
+        }
+        return count;
+      }
+  };
+
+  TEST_F(RxTaskTest, ReceivesAndAcknowledgesWhileLoopStalls) {
+    this->transport.set_rx_task(0, 5);
+    auto *writes = this->watch(LIGHT, KNX_COMMAND_WRITE);
+    this->start();
+    this->inject_frames();
+    this->loop.run_until([writes] { return writes->size() == RX_TASK_FRAMES / 2; }, 5000);
+
+    ASSERT_EQ(writes->size(), (size_t) RX_TASK_FRAMES / 2);
+    for (int i = 0; i < RX_TASK_FRAMES / 2; i++) {
+      EXPECT_EQ((*writes)[i][8], 2 * i);
+    }
+    EXPECT_EQ(this->acknowledged_in_time(1000), RX_TASK_FRAMES);
+    const KnxMetrics &metrics = this->knx.get_metrics();
+    EXPECT_EQ(metrics.rx_frames, (uint32_t) RX_TASK_FRAMES);
+    EXPECT_EQ(metrics.rx_overflows, 0u);
+    EXPECT_EQ(this->sim.get_uart_overflows(), 0u);
+  }
+
+  // The same stalls without the task: the frames are still received from the UART buffer, but too late to ACK
+  TEST_F(RxTaskTest, MissesAcknowledgesWithoutTheTask) {
+    auto *writes = this->watch(LIGHT, KNX_COMMAND_WRITE);
+    this->start();
+    this->inject_frames();
+    this->loop.run_until([writes] { return writes->size() == RX_TASK_FRAMES / 2; }, 5000);
+
+    EXPECT_EQ(writes->size(), (size_t) RX_TASK_FRAMES / 2);
+    // Only the frames that happen to be arriving when a stall ends
+    EXPECT_LT(this->acknowledged_in_time(STALL_MS * 1000), RX_TASK_FRAMES / 2);
+  }
+
+}  // namespace knx
+}  // namespace esphome
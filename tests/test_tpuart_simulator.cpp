@@ -0,0 +1,296 @@
+// Author: Dulgheru Mihaita (Since 2022)
+
+// KnxComponent and KnxTpuartTransport against the simulated TPUART: receiving, faults on the UART,
+// confirmations, resets and transceiver detection
+
+#include <chrono>
+#include "tpuart_fixture.h"
+
+namespace esphome {
+namespace knx {
+
+  static const KnxGroupAddress LIGHT(1, 2, 3);
+  static const KnxGroupAddress OTHER(1, 2, 4);
+
+  class SimulatorTest : public TpuartFixture {};
+
+  TEST_F(SimulatorTest, DetectsTheTransceiverAfterTheReset) {
+    this->start();
+    EXPECT_EQ(this->sim.get_reset_requests(), 1u);
+    EXPECT_EQ(this->transport.get_transceiver(), KNX_TRANSCEIVER_TPUART);
+    EXPECT_EQ(this->knx.get_metrics().tpuart_resets, 1u);
+    // Nothing else to configure on the original TPUART
+    EXPECT_EQ(this->sim.get_individual_address(), 0);
+  }
+
+  TEST_F(SimulatorTest, GivesTpuart2ItsAddressAndCrcMode) {
+    this->sim.set_chip(SimChip::TPUART2);
+    this->transport.set_uart_crc(true);
+    this->start();
+    EXPECT_EQ(this->transport.get_transceiver(), KNX_TRANSCEIVER_TPUART2);
+    EXPECT_EQ(this->sim.get_individual_address(), this->knx.get_individual_address());
+    EXPECT_TRUE(this->sim.is_crc_mode());
+
+    // Frames now carry a CRC, a corrupted byte is caught by it before the bus checksum
+    auto *writes = this->watch(LIGHT, KNX_COMMAND_WRITE);
+    this->sim.inject_frame(group_frame<Dpt<1>>(LIGHT, KNX_COMMAND_WRITE, true));
+    SimFaults faults;
+    faults.corrupt_byte = 7;
+    this->sim.inject_frame(group_frame<Dpt<1>>(LIGHT, KNX_COMMAND_WRITE, false), faults);
+    this->run_until_idle();
+    EXPECT_EQ(writes->size(), 1u);
+    EXPECT_EQ(this->knx.get_metrics().rx_checksum_errors, 1u);
+  }
+
+  TEST_F(SimulatorTest, GivesNcn5120ItsAddress) {
+    this->sim.set_chip(SimChip::NCN5120);
+    this->start();
+    EXPECT_EQ(this->transport.get_transceiver(), KNX_TRANSCEIVER_NCN5120);
+    EXPECT_EQ(this->sim.get_individual_address(), this->knx.get_individual_address());
+
+    this->transport.set_busy_mode(true);
+    EXPECT_TRUE(this->sim.is_busy_mode());
+  }
+
+  // Bytes on the UART while the U_ProductID request waits for its response: ACK frames of other devices,
+  // a stray confirmation, noise. None of them is a ProductID response.
+  static const std::vector<uint8_t> PROBE_NOISE = {KNX_ACK_FRAME, 0x13, TPUART_DATA_CONFIRM_FAILED, 0xA5, KNX_BUSY_FRAME};
+
+  class NoisyProbeTest : public SimulatorTest, public ::testing::WithParamInterface<SimChip> {
+    protected:
+      // The noise right after the U_ProductID request, ahead of a response
+      void start_with_noise() {
+        this->knx.setup();
+        this->loop.run_until([this] { return host::now_us() >= SIM_RESET_DELAY_US; }, 100);
+        this->sim.inject_bytes(PROBE_NOISE);
+        this->loop.run_until([this] { return this->transport.get_transceiver() != KNX_TRANSCEIVER_AUTO; }, 1000);
+      }
+  };
+
+  TEST_P(NoisyProbeTest, DetectsTheTransceiverDespiteNoise) {
+    this->sim.set_chip(GetParam());
+    this->start_with_noise();
+    KnxTransceiverType expected = GetParam() == SimChip::TPUART2 ? KNX_TRANSCEIVER_TPUART2
+                                  : GetParam() == SimChip::NCN5120 ? KNX_TRANSCEIVER_NCN5120 : KNX_TRANSCEIVER_TPUART;
+    EXPECT_EQ(this->transport.get_transceiver(), expected);
+    // Only given an address when it is a chip that understands the request
+    EXPECT_EQ(this->sim.get_individual_address(), GetParam() == SimChip::TPUART ? 0 : this->knx.get_individual_address());
+  }
+
+  INSTANTIATE_TEST_SUITE_P(Chips, NoisyProbeTest, ::testing::Values(SimChip::TPUART, SimChip::TPUART2, SimChip::NCN5120));
+
+  // Without an address of its own the original TPUART leaves the ACK for our address to the component
+  TEST_F(NoisyProbeTest, KeepsSoftwareAcksOnTheOriginalTpuart) {
+    this->start_with_noise();
+    this->sim.inject_frame(connect_frame(1, 1, 10));
+    this->run_until_idle();
+    auto frames = this->sim.get_rx_frames();
+    ASSERT_EQ(frames.size(), 1u);
+    EXPECT_EQ(frames[0].ack_information, TPUART_ACK_INFORMATION | TPUART_ACK_ADDRESSED);
+  }
+
+  TEST_F(SimulatorTest, DispatchesAndAcknowledgesFramesForUs) {
+    auto *writes = this->watch(LIGHT, KNX_COMMAND_WRITE);
+    this->start();
+    size_t ours = this->sim.inject_frame(group_frame<Dpt<1>>(LIGHT, KNX_COMMAND_WRITE, true));
+    size_t other = this->sim.inject_frame(group_frame<Dpt<1>>(OTHER, KNX_COMMAND_WRITE, true));
+    this->run_until_idle();
+
+    ASSERT_EQ(writes->size(), 1u);
+    EXPECT_EQ((*writes)[0], this->sim.get_rx_frames()[ours].bytes);
+    auto frames = this->sim.get_rx_frames();
+    EXPECT_EQ(frames[ours].ack_information, TPUART_ACK_INFORMATION | TPUART_ACK_ADDRESSED);
+    EXPECT_EQ(frames[other].ack_information, TPUART_ACK_INFORMATION);
+    const KnxMetrics &metrics = this->knx.get_metrics();
+    EXPECT_EQ(metrics.rx_frames, 2u);
+    EXPECT_EQ(metrics.rx_accepted, 1u);
+    EXPECT_EQ(metrics.rx_filtered, 1u);
+  }
+
+  TEST_F(SimulatorTest, DiscardsAFrameWithADroppedByte) {
+    auto *writes = this->watch(LIGHT, KNX_COMMAND_WRITE);
+    this->start();
+    SimFaults faults;
+    faults.drop_byte = 7;
+    this->sim.inject_frame(group_frame<Dpt<5>>(LIGHT, KNX_COMMAND_WRITE, 10), faults);
+    this->run_until_idle();
+    // Waits for the missing byte until the gap on the bus, the next frame is received again
+    this->sim.inject_frame(group_frame<Dpt<5>>(LIGHT, KNX_COMMAND_WRITE, 11));
+    this->run_until_idle();
+
+    EXPECT_EQ(this->knx.get_metrics().rx_timeouts, 1u);
+    ASSERT_EQ(writes->size(), 1u);
+    EXPECT_EQ(writes->back()[8], 11);
+  }
+
+  TEST_F(SimulatorTest, DiscardsAFrameWithACorruptByte) {
+    auto *writes = this->watch(LIGHT, KNX_COMMAND_WRITE);
+    this->start();
+    SimFaults faults;
+    faults.corrupt_byte = 8;
+    faults.corrupt_mask = 0x01;
+    this->sim.inject_frame(group_frame<Dpt<5>>(LIGHT, KNX_COMMAND_WRITE, 10), faults);
+    this->run_until_idle();
+
+    EXPECT_TRUE(writes->empty());
+    EXPECT_EQ(this->knx.get_metrics().rx_checksum_errors, 1u);
+  }
+
+  TEST_F(SimulatorTest, DiscardsAnAbortedFrame) {
+    this->watch(LIGHT, KNX_COMMAND_WRITE);
+    this->start();
+    SimFaults faults;
+    faults.truncate = 4;
+    this->sim.inject_frame(group_frame<Dpt<1>>(LIGHT, KNX_COMMAND_WRITE, true), faults);
+    this->run_until_idle();
+    EXPECT_EQ(this->knx.get_metrics().rx_timeouts, 1u);
+    EXPECT_EQ(this->knx.get_metrics().rx_frames, 0u);
+  }
+
+  TEST_F(SimulatorTest, ResynchronisesAfterNoise) {
+    auto *writes = this->watch(LIGHT, KNX_COMMAND_WRITE);
+    this->start();
+    this->sim.inject_bytes({0x55, 0x00, 0xFF});
+    this->loop.run_for_ms(20);
+    this->sim.inject_frame(group_frame<Dpt<1>>(LIGHT, KNX_COMMAND_WRITE, true));
+    this->run_until_idle();
+    EXPECT_EQ(writes->size(), 1u);
+  }
+
+  // Acknowledge frames of other devices are passed on by the TPUART between frames, counted and skipped
+  TEST_F(SimulatorTest, CountsAcknowledgeFramesOfOtherDevices) {
+    auto *writes = this->watch(LIGHT, KNX_COMMAND_WRITE);
+    this->start();
+    this->sim.inject_bytes({KNX_ACK_FRAME, KNX_ACK_FRAME, KNX_NACK_FRAME, KNX_BUSY_FRAME, KNX_ACK_FRAME});
+    this->loop.run_for_ms(20);
+    this->sim.inject_frame(group_frame<Dpt<1>>(LIGHT, KNX_COMMAND_WRITE, true));
+    this->run_until_idle();
+
+    EXPECT_EQ(writes->size(), 1u);
+    const KnxMetrics &metrics = this->knx.get_metrics();
+    EXPECT_EQ(metrics.bus_acks, 3u);
+    EXPECT_EQ(metrics.bus_nacks, 1u);
+    EXPECT_EQ(metrics.bus_busy, 1u);
+    EXPECT_EQ(metrics.rx_timeouts, 0u);
+  }
+
+  TEST_F(SimulatorTest, ConfirmsSentFrames) {
+    this->start();
+    KnxTxHandle handle = this->knx.group_write<Dpt<9>>(LIGHT, 21.5f);
+    EXPECT_EQ(this->knx.get_tx_state(handle), KNX_TX_QUEUED);
+    this->run_until_idle();
+
+    EXPECT_EQ(this->knx.get_tx_state(handle), KNX_TX_CONFIRMED);
+    auto sent = this->sim.get_tx_frames();
+    ASSERT_EQ(sent.size(), 1u);
+    KnxStandardTelegram telegram;
+    memcpy(telegram.data(), sent[0].bytes.data(), sent[0].bytes.size());
+    EXPECT_TRUE(telegram.verify_checksum());
+    EXPECT_EQ(telegram.get_target_group_address(), LIGHT);
+    EXPECT_FLOAT_EQ(*telegram.get<Dpt<9>>(), 21.5f);
+    EXPECT_EQ(this->knx.get_metrics().tx_confirmed, 1u);
+  }
+
+  TEST_F(SimulatorTest, ReportsANegativeConfirmation) {
+    this->sim.set_confirm(SimConfirm::NEGATIVE);
+    this->start();
+    KnxTxHandle handle = this->knx.group_write<Dpt<1>>(LIGHT, true);
+    this->run_until_idle();
+    EXPECT_EQ(this->knx.get_tx_state(handle), KNX_TX_NACKED);
+    EXPECT_EQ(this->knx.get_metrics().tx_failed, 1u);
+  }
+
+  TEST_F(SimulatorTest, WaitsForADelayedConfirmation) {
+    this->sim.set_confirm(SimConfirm::POSITIVE, 600000);
+    this->start();
+    KnxTxHandle handle = this->knx.group_write<Dpt<1>>(LIGHT, true);
+    KnxTxHandle next = this->knx.group_write<Dpt<1>>(OTHER, true);
+    this->loop.run_for_ms(300);
+    EXPECT_EQ(this->knx.get_tx_state(handle), KNX_TX_SENT);
+    EXPECT_EQ(this->knx.get_tx_state(next), KNX_TX_QUEUED);
+    this->loop.run_for_ms(400);
+    EXPECT_EQ(this->knx.get_tx_state(handle), KNX_TX_CONFIRMED);
+    EXPECT_EQ(this->knx.get_tx_state(next), KNX_TX_SENT);
+  }
+
+  TEST_F(SimulatorTest, TimesOutWithoutConfirmation) {
+    this->sim.set_confirm(SimConfirm::NONE);
+    this->start();
+    KnxTxHandle handle = this->knx.group_write<Dpt<1>>(LIGHT, true);
+    this->loop.run_for_ms(900);
+    EXPECT_EQ(this->knx.get_tx_state(handle), KNX_TX_SENT);
+    this->loop.run_for_ms(200);
+    EXPECT_EQ(this->knx.get_tx_state(handle), KNX_TX_TIMED_OUT);
+    EXPECT_EQ(this->knx.get_metrics().tx_timed_out, 1u);
+  }
+
+  TEST_F(SimulatorTest, ReconfiguresAfterAnUnrequestedReset) {
+    this->sim.set_chip(SimChip::TPUART2);
+    this->start();
+    this->sim.inject_reset();
+    EXPECT_EQ(this->sim.get_individual_address(), 0);
+    this->loop.run_for_ms(50);
+    EXPECT_EQ(this->knx.get_metrics().tpuart_resets, 2u);
+    EXPECT_EQ(this->sim.get_individual_address(), this->knx.get_individual_address());
+  }
+
+  TEST_F(SimulatorTest, CountsAFullReceiveBuffer) {
+    auto *writes = this->watch(LIGHT, KNX_COMMAND_WRITE);
+    this->sim.set_rx_buffer_size(16);
+    this->start();
+    for (int i = 0; i < 4; i++) {
+      this->sim.inject_frame(group_frame<Dpt<5>>(LIGHT, KNX_COMMAND_WRITE, i));
+    }
+    // loop() stalls while all four frames arrive
+    host::advance_us(this->sim.get_bus_free_us() - host::now_us());
+    this->run_until_idle();
+
+    EXPECT_GT(this->sim.get_uart_overflows(), 0u);
+    EXPECT_EQ(this->knx.get_metrics().rx_overflows, 1u);
+    EXPECT_LT(writes->size(), 4u);
+    EXPECT_GE(host::get_log_count(ESPHOME_LOG_LEVEL_WARN), 1u);
+  }
+
+  // Each write takes 1.5 ms to handle, so a 2 ms budget ends a loop() after the second frame
+  TEST_F(SimulatorTest, CountsASpentReceiveBudgetOnlyWithInputLeft) {
+    KnxGroupTrigger slow(&this->knx, LIGHT, KNX_COMMAND_WRITE);
+    int writes = 0;
+    slow.set_callback([&writes](KnxTelegram *) {
+      writes++;
+      host::advance_us(1500);
+    });
+    this->knx.set_receive_budget(2000);
+    this->start();
+    for (int i = 0; i < 4; i++) {
+      this->sim.inject_frame(group_frame<Dpt<5>>(LIGHT, KNX_COMMAND_WRITE, i));
+    }
+    host::advance_us(this->sim.get_bus_free_us() - host::now_us());
+
+    // Two frames are left in the UART buffer
+    this->knx.loop();
+    EXPECT_EQ(writes, 2);
+    EXPECT_EQ(this->knx.get_metrics().rx_budget_exhausted, 1u);
+    // The budget is spent again on the last frame, with nothing left to receive
+    this->knx.loop();
+    EXPECT_EQ(writes, 4);
+    EXPECT_EQ(this->knx.get_metrics().rx_budget_exhausted, 1u);
+    this->run_until_idle();
+    EXPECT_EQ(this->knx.get_metrics().rx_budget_exhausted, 1u);
+  }
+
+  TEST_F(SimulatorTest, RunsFasterThanRealTime) {
+    this->watch(LIGHT, KNX_COMMAND_WRITE);
+    this->start();
+    auto started = std::chrono::steady_clock::now();
+    for (int i = 0; i < 500; i++) {
+      this->sim.inject_frame(group_frame<Dpt<5>>(LIGHT, KNX_COMMAND_WRITE, i & 0xFF));
+    }
+    uint64_t bus_us = this->sim.get_bus_free_us() - host::now_us();
+    this->run_until_idle();
+    auto real_us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - started).count();
+    EXPECT_EQ(this->knx.get_metrics().rx_frames, 500u);
+    EXPECT_LT((uint64_t) real_us * 10, bus_us);
+  }
+
+}  // namespace knx
+}  // namespace esphome
@@ -0,0 +1,122 @@
+// Author: Dulgheru Mihaita (Since 2022)
+
+// The transmit queue against the simulated TPUART: one FIFO per priority, the starvation limit for the lower
+// levels and what happens when all KNX_TX_QUEUE_SIZE slots are taken
+
+#include "tpuart_fixture.h"
+
+namespace esphome {
+namespace knx {
+
+  class TxQueueTest : public TpuartFixture {
+    protected:
+      // Each telegram to its own address, so no group object coalesces them
+      KnxTxHandle write(int sub, KnxPriorityType priority = KNX_PRIORITY_NORMAL) {
+        return this->knx.group_write<Dpt<5>>(KnxGroupAddress(2, 0, sub), sub, priority);
+      }
+
+      // Sub group of each frame put on the line by us, in order
+      std::vector<int> sent() {
+        std::vector<int> subs;
+        for (auto &frame : this->sim.get_tx_frames()) {
+          subs.push_back(frame.bytes[4]);
+        }
+        return subs;
+      }
+
+      std::vector<KnxPriorityType> sent_priorities() {
+        std::vector<KnxPriorityType> priorities;
+        for (auto &frame : this->sim.get_tx_frames()) {
+          KnxStandardTelegram telegram;
+          memcpy(telegram.data(), frame.bytes.data(), frame.bytes.size());
+          priorities.push_back(telegram.get_priority());
+        }
+        return priorities;
+      }
+  };
+
+  // Higher priorities first, first in first out within a priority
+  TEST_F(TxQueueTest, SendsByPriority) {
+    this->start();
+    this->write(1);
+    this->write(2, KNX_PRIORITY_HIGH);
+    this->write(3);
+    this->write(4, KNX_PRIORITY_ALARM);
+    this->write(5, KNX_PRIORITY_SYSTEM);
+    this->write(6, KNX_PRIORITY_HIGH);
+    this->write(7, KNX_PRIORITY_ALARM);
+    EXPECT_EQ(this->knx.get_tx_queue_depth(), 7);
+    this->run_until_idle();
+
+    EXPECT_EQ(this->sent(), (std::vector<int>{5, 4, 7, 2, 6, 1, 3}));
+    EXPECT_EQ(this->sent_priorities(),
+              (std::vector<KnxPriorityType>{KNX_PRIORITY_SYSTEM, KNX_PRIORITY_ALARM, KNX_PRIORITY_ALARM,
+                                            KNX_PRIORITY_HIGH, KNX_PRIORITY_HIGH, KNX_PRIORITY_NORMAL,
+                                            KNX_PRIORITY_NORMAL}));
+    EXPECT_EQ(this->knx.get_metrics().tx_confirmed, 7u);
+  }
+
+  // Passed over KNX_TX_STARVATION_LIMIT times, a waiting level goes next once
+  TEST_F(TxQueueTest, ServesAStarvedLevel) {
+    this->start();
+    this->write(0);
+    for (int i = 1; i <= 12; i++) {
+      this->write(i, KNX_PRIORITY_HIGH);
+    }
+    this->run_until_idle();
+
+    std::vector<int> expected;
+    for (int i = 1; i <= KNX_TX_STARVATION_LIMIT; i++) {
+      expected.push_back(i);
+    }
+    expected.push_back(0);
+    for (int i = KNX_TX_STARVATION_LIMIT + 1; i <= 12; i++) {
+      expected.push_back(i);
+    }
+    EXPECT_EQ(this->sent(), expected);
+  }
+
+  // Each level counts on its own: normal waits for the starvation limit again after high was served
+  TEST_F(TxQueueTest, CountsStarvationPerLevel) {
+    this->start();
+    this->write(0);
+    this->write(100, KNX_PRIORITY_HIGH);
+    for (int i = 1; i <= 12; i++) {
+      this->write(i, KNX_PRIORITY_ALARM);
+    }
+    this->run_until_idle();
+
+    auto sent = this->sent();
+    ASSERT_EQ(sent.size(), 14u);
+    // High and normal were both passed over 8 times, high is served first, normal right after
+    EXPECT_EQ(sent[KNX_TX_STARVATION_LIMIT], 100);
+    EXPECT_EQ(sent[KNX_TX_STARVATION_LIMIT + 1], 0);
+  }
+
+  // A full queue refuses the telegram with an invalid handle and a warning, the queued ones are all sent
+  TEST_F(TxQueueTest, RefusesTelegramsWhenFull) {
+    this->start();
+    std::vector<KnxTxHandle> handles;
+    for (int i = 0; i < KNX_TX_QUEUE_SIZE; i++) {
+      handles.push_back(this->write(i));
+      EXPECT_NE(handles.back(), KNX_TX_INVALID_HANDLE);
+    }
+    EXPECT_EQ(this->knx.get_tx_queue_depth(), KNX_TX_QUEUE_SIZE);
+    uint32_t warnings = host::get_log_count(ESPHOME_LOG_LEVEL_WARN);
+    EXPECT_EQ(this->write(KNX_TX_QUEUE_SIZE, KNX_PRIORITY_SYSTEM), KNX_TX_INVALID_HANDLE);
+    EXPECT_EQ(host::get_log_count(ESPHOME_LOG_LEVEL_WARN), warnings + 1);
+
+    // The telegram on the line still takes its slot until it is confirmed
+    this->loop.run_once();
+    EXPECT_EQ(this->write(KNX_TX_QUEUE_SIZE), KNX_TX_INVALID_HANDLE);
+
+    this->run_until_idle();
+    for (auto handle : handles) {
+      EXPECT_EQ(this->knx.get_tx_state(handle), KNX_TX_CONFIRMED);
+    }
+    EXPECT_EQ(this->sent().size(), (size_t) KNX_TX_QUEUE_SIZE);
+    EXPECT_NE(this->write(KNX_TX_QUEUE_SIZE), KNX_TX_INVALID_HANDLE);
+  }
+
+}  // namespace knx
+}  // namespace esphome